@@ -80,6 +80,9 @@ int load_config(void)
 		pbx_log(LOG_ERROR, "Error parsing configfile !\n");
 		return FALSE;
 	}
+	if (GLOB(debug_async)) {
+		sccp_log_async_start();
+	}
 	sccp_config_readDevicesLines(SCCP_CONFIG_READINITIAL);
 
 	/* ok the config parse is done */
@@ -172,12 +175,23 @@ boolean_t sccp_prePBXLoad(void)
 	pbx_mutex_init(&GLOB(monitor_lock));
 #endif
 
+	/* init asynchronous logging (drain thread is started once debug_async has been read from the config) */
+	sccp_log_async_init();
+
 	/* init refcount */
 	sccp_refcount_init();
 
+	/* init packet buffer pool */
+	sccp_packet_pool_init();
+
 	SCCP_RWLIST_HEAD_INIT(&GLOB(sessions));
 	SCCP_RWLIST_HEAD_INIT(&GLOB(devices));
 	SCCP_RWLIST_HEAD_INIT(&GLOB(lines));
+	GLOB(session_index) = sccp_hashtable_create("sessions", SCCP_HASH_PRIME, SCCP_HASHTABLE_KEY_SOCKADDR);
+	GLOB(device_index) = sccp_hashtable_create("devices", SCCP_HASH_PRIME, SCCP_HASHTABLE_KEY_STRCASE);
+	GLOB(line_index) = sccp_hashtable_create("lines", SCCP_HASH_PRIME, SCCP_HASHTABLE_KEY_STRCASE);
+	GLOB(channel_index) = sccp_hashtable_create("channels", SCCP_HASH_PRIME, SCCP_HASHTABLE_KEY_UINT32);
+	GLOB(passthrupartyid_index) = sccp_hashtable_create("passthrupartyids", SCCP_HASH_PRIME, SCCP_HASHTABLE_KEY_UINT32);
 
 	GLOB(general_threadpool) = sccp_threadpool_init(THREADPOOL_MIN_SIZE);
 
@@ -190,6 +204,9 @@ boolean_t sccp_prePBXLoad(void)
 	sccp_manager_module_start();
 #ifdef CS_SCCP_CONFERENCE
 	sccp_conference_module_start();
+#endif
+#ifdef CS_SCCP_REALTIME
+	sccp_config_realtimecache_start();
 #endif
 	sccp_event_subscribe(SCCP_EVENT_FEATURE_CHANGED, sccp_device_featureChangedDisplay, TRUE);
 	sccp_event_subscribe(SCCP_EVENT_FEATURE_CHANGED, sccp_util_featureStorageBackend, TRUE);
@@ -360,11 +377,21 @@ int sccp_preUnload(void)
 #endif
 #ifdef CS_SCCP_CONFERENCE
 	sccp_conference_module_stop();
+#endif
+#ifdef CS_SCCP_REALTIME
+	sccp_config_realtimecache_stop();
 #endif
 	sccp_softkey_clear();
 	sccp_hint_module_stop();
 	sccp_event_module_stop();
 	sccp_threadpool_destroy(GLOB(general_threadpool));
+	sccp_packet_pool_destroy();										/* after the threadpool, session cleanup jobs still release packets */
+	sccp_log_async_destroy();
+	sccp_hashtable_destroy(&GLOB(session_index));
+	sccp_hashtable_destroy(&GLOB(device_index));
+	sccp_hashtable_destroy(&GLOB(line_index));
+	sccp_hashtable_destroy(&GLOB(channel_index));
+	sccp_hashtable_destroy(&GLOB(passthrupartyid_index));
 	sccp_refcount_destroy();
 
 	/* free resources */
@@ -423,6 +450,11 @@ int sccp_reload(void)
 				returnval = 2;
 				break;
 			}
+			if (GLOB(debug_async)) {
+				sccp_log_async_start();
+			} else {
+				sccp_log_async_stop();
+			}
 			sccp_config_readDevicesLines(readingtype);
 			returnval = 3;
 			break;
@@ -62,6 +62,7 @@ typedef struct sccp_hint sccp_hint_t;										/*!< SCCP Hint Structure */
 typedef struct sccp_hostname sccp_hostname_t;									/*!< SCCP HostName Structure */
 typedef struct sccp_header sccp_header_t;
 typedef struct sccp_msg sccp_msg_t;
+typedef struct sccp_hashtable sccp_hashtable_t;									/*!< SCCP Hashtable Structure */
 
 #define sessionPtr sccp_session_t *const
 #define devicePtr sccp_device_t *const
@@ -129,6 +130,7 @@ __END_C_EXTERN__
 
 #include "sccp_enum.h"
 #include "sccp_dllists.h"
+#include "sccp_hashtable.h"
 #include "sccp_threadpool.h"
 #include "sccp_debug.h"
 #include "sccp_globals.h"
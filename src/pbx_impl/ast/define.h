@@ -214,6 +214,7 @@ typedef struct ast_event pbx_event_t;
 #define pbx_io_wait ast_io_wait
 #define pbx_jb_read_conf ast_jb_read_conf
 #define pbx_load_realtime ast_load_realtime
+#define pbx_load_realtime_multientry ast_load_realtime_multientry
 #define pbx_log ast_log
 #define pbx_malloc ast_malloc
 #define pbx_manager_register_xml ast_manager_register_xml
@@ -342,6 +343,7 @@ typedef struct ast_event pbx_event_t;
 #define pbx_variable_new ast_variable_new
 #define pbx_variable_retrieve ast_variable_retrieve
 #define pbx_variables_destroy ast_variables_destroy
+#define pbx_variables_dup ast_variables_dup
 #define pbx_strlen_zero ast_strlen_zero
 #if defined( CS_AST_HAS_STASIS )
 #define pbx_event_sub stasis_subscription
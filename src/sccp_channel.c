@@ -191,6 +191,10 @@ channelPtr sccp_channel_allocate(constLinePtr l, constDevicePtr device)
 		sccp_line_addChannel(l, channel);
 		channel->setDevice(channel, device);
 
+		/* add to the global callid / passthrupartyid indexes (removed again by sccp_channel_removeFromIndexes when the channel leaves its line) */
+		sccp_hashtable_insert(GLOB(channel_index), &channel->callid, channel);
+		sccp_hashtable_insert(GLOB(passthrupartyid_index), &channel->passthrupartyid, channel);
+
 		/* return new channel */
 		sccp_log((DEBUGCAT_CHANNEL)) (VERBOSE_PREFIX_3 "%s: New channel number: %d on line %s\n", l->id, channel->callid, l->name);
 		return channel;
@@ -1830,6 +1834,19 @@ void sccp_channel_clean(sccp_channel_t * channel)
 	}
 }
 
+/*!
+ * \brief Remove Channel from the global callid / passthrupartyid indexes
+ * \note called when the channel leaves its line, so that a channel that is still referenced elsewhere no longer shadows a newer channel reusing the same id; safe to call more than once
+ */
+void sccp_channel_removeFromIndexes(constChannelPtr channel)
+{
+	if (!channel) {
+		return;
+	}
+	sccp_hashtable_remove(GLOB(channel_index), &channel->callid, channel);
+	sccp_hashtable_remove(GLOB(passthrupartyid_index), &channel->passthrupartyid, channel);
+}
+
 /*!
  * \brief Destroy Channel
  * \param channel SCCP Channel
@@ -1848,6 +1865,7 @@ void __sccp_channel_destroy(sccp_channel_t * channel)
 	}
 
 	sccp_log((DEBUGCAT_CHANNEL)) (VERBOSE_PREFIX_3 "Destroying channel %s\n", channel->designator);
+	sccp_channel_removeFromIndexes(channel);							/* normally already done by sccp_line_removeChannel */
 
 	if (channel->rtp.audio.instance || channel->rtp.video.instance) {
 		sccp_rtp_stop(channel);
@@ -2612,6 +2630,20 @@ sccp_channel_t *sccp_find_channel_by_lineInstance_and_callid(const sccp_device_t
 	return c;
 }
 
+/*!
+ * \brief Hashtable callback retaining the first channel stored under a key that is not DOWN
+ * \note a key can be shared by more than one channel (callid/passthrupartyid wrap around), so keep looking past DOWN entries
+ */
+static void sccp_channel_findActive_cb(void *value, void *data)
+{
+	sccp_channel_t *channel = (sccp_channel_t *) value;
+	sccp_channel_t **found = (sccp_channel_t **) data;
+
+	if (!*found && channel->state != SCCP_CHANNELSTATE_DOWN) {
+		*found = sccp_channel_retain(channel);					/* can return NULL when the channel is already being destroyed */
+	}
+}
+
 /*!
  * \brief Find Line by ID
  *
@@ -2626,18 +2658,10 @@ sccp_channel_t *sccp_find_channel_by_lineInstance_and_callid(const sccp_device_t
 sccp_channel_t *sccp_channel_find_byid(uint32_t callid)
 {
 	sccp_channel_t *channel = NULL;
-	sccp_line_t *l = NULL;
 
 	sccp_log((DEBUGCAT_CHANNEL)) (VERBOSE_PREFIX_3 "SCCP: Looking for channel by id %u\n", callid);
 
-	SCCP_RWLIST_RDLOCK(&GLOB(lines));
-	SCCP_RWLIST_TRAVERSE(&GLOB(lines), l, list) {
-		channel = sccp_find_channel_on_line_byid(l, callid);
-		if (channel) {
-			break;
-		}
-	}
-	SCCP_RWLIST_UNLOCK(&GLOB(lines));
+	sccp_hashtable_foreach_key(GLOB(channel_index), &callid, sccp_channel_findActive_cb, &channel);
 	if (!channel) {
 		sccp_log((DEBUGCAT_CHANNEL)) (VERBOSE_PREFIX_3 "SCCP: Could not find channel for callid:%d on device\n", callid);
 	}
@@ -2659,20 +2683,10 @@ sccp_channel_t *sccp_channel_find_byid(uint32_t callid)
 sccp_channel_t *sccp_channel_find_bypassthrupartyid(uint32_t passthrupartyid)
 {
 	sccp_channel_t *c = NULL;
-	sccp_line_t *l = NULL;
 
 	sccp_log((DEBUGCAT_CHANNEL)) (VERBOSE_PREFIX_3 "SCCP: Looking for channel by PassThruId %u\n", passthrupartyid);
 
-	SCCP_RWLIST_RDLOCK(&GLOB(lines));
-	SCCP_RWLIST_TRAVERSE(&GLOB(lines), l, list) {
-		SCCP_LIST_LOCK(&l->channels);
-		c = SCCP_LIST_FIND(&l->channels, sccp_channel_t, tmpc, list, (tmpc->passthrupartyid == passthrupartyid && tmpc->state != SCCP_CHANNELSTATE_DOWN), TRUE, __FILE__, __LINE__, __PRETTY_FUNCTION__);
-		SCCP_LIST_UNLOCK(&l->channels);
-		if (c) {
-			break;
-		}
-	}
-	SCCP_RWLIST_UNLOCK(&GLOB(lines));
+	sccp_hashtable_foreach_key(GLOB(passthrupartyid_index), &passthrupartyid, sccp_channel_findActive_cb, &c);
 
 	if (!c) {
 		sccp_log((DEBUGCAT_CHANNEL)) (VERBOSE_PREFIX_3 "SCCP: Could not find active channel with Passthrupartyid %u\n", passthrupartyid);
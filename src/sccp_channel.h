@@ -176,6 +176,7 @@ SCCP_API void SCCP_CALL sccp_channel_StatisticsRequest(sccp_channel_t * channel)
 SCCP_API void SCCP_CALL sccp_channel_answer(const sccp_device_t * device, sccp_channel_t * channel);
 SCCP_API void SCCP_CALL sccp_channel_stop_and_deny_scheduled_tasks(sccp_channel_t * channel);
 SCCP_API void SCCP_CALL sccp_channel_clean(sccp_channel_t * channel);
+SCCP_API void SCCP_CALL sccp_channel_removeFromIndexes(constChannelPtr channel);
 SCCP_API void SCCP_CALL sccp_channel_transfer(channelPtr channel, constDevicePtr device);
 SCCP_API void SCCP_CALL sccp_channel_transfer_release(devicePtr d, channelPtr c);
 SCCP_API void SCCP_CALL sccp_channel_transfer_cancel(devicePtr d, channelPtr c);
@@ -60,6 +60,9 @@ SCCP_FILE_VERSION(__FILE__, "");
 #include "sccp_features.h"
 #include "sccp_mwi.h"
 #include "sccp_hint.h"
+#ifdef CS_DEVSTATE_FEATURE
+#include "sccp_devstate.h"
+#endif
 #include "sys/stat.h"
 #include <asterisk/cli.h>
 #include <asterisk/paths.h>
@@ -511,6 +514,8 @@ static int sccp_show_globals(int fd, sccp_cli_totals_t *totals, struct mansessio
 	CLI_AMI_OUTPUT_PARAM("Nat", CLI_AMI_LIST_WIDTH, "%s", sccp_nat2str(GLOB(nat)));
 	CLI_AMI_OUTPUT_PARAM("Keepalive", CLI_AMI_LIST_WIDTH, "%d", GLOB(keepalive));
 	CLI_AMI_OUTPUT_PARAM("Debug", CLI_AMI_LIST_WIDTH, "(%d) %s", GLOB(debug), debugcategories);
+	CLI_AMI_OUTPUT_BOOL("Debug Async", CLI_AMI_LIST_WIDTH, GLOB(debug_async));
+	CLI_AMI_OUTPUT_PARAM("Debug Async Dropped", CLI_AMI_LIST_WIDTH, "%u", sccp_log_async_dropped());
 	CLI_AMI_OUTPUT_PARAM("Date format", CLI_AMI_LIST_WIDTH, "%s", GLOB(dateformat));
 	CLI_AMI_OUTPUT_PARAM("First digit timeout", CLI_AMI_LIST_WIDTH, "%d", GLOB(firstdigittimeout));
 	CLI_AMI_OUTPUT_PARAM("Digit timeout", CLI_AMI_LIST_WIDTH, "%d", GLOB(digittimeout));
@@ -576,6 +581,21 @@ static int sccp_show_globals(int fd, sccp_cli_totals_t *totals, struct mansessio
 	CLI_AMI_OUTPUT_PARAM("Hotline_Context", CLI_AMI_LIST_WIDTH, "%s", GLOB(hotline)->line->context ? GLOB(hotline)->line->context : "<not set>");
 	CLI_AMI_OUTPUT_PARAM("Hotline_Exten", CLI_AMI_LIST_WIDTH, "%s", GLOB(hotline->exten));
 	CLI_AMI_OUTPUT_PARAM("Threadpool Size", CLI_AMI_LIST_WIDTH, "%d/%d", sccp_threadpool_jobqueue_count(GLOB(general_threadpool)), sccp_threadpool_thread_count(GLOB(general_threadpool)));
+	CLI_AMI_OUTPUT_BOOL("Session EventLoop", CLI_AMI_LIST_WIDTH, GLOB(session_eventloop));
+	CLI_AMI_OUTPUT_PARAM("Session Workers", CLI_AMI_LIST_WIDTH, "%d", GLOB(session_workers));
+	CLI_AMI_OUTPUT_PARAM("Session OutQueue High", CLI_AMI_LIST_WIDTH, "%d", GLOB(session_outqueue_high));
+	CLI_AMI_OUTPUT_PARAM("Session OutQueue Low", CLI_AMI_LIST_WIDTH, "%d", GLOB(session_outqueue_low));
+	CLI_AMI_OUTPUT_PARAM("Session OutQueue Timeout", CLI_AMI_LIST_WIDTH, "%d", GLOB(session_outqueue_timeout));
+	CLI_AMI_OUTPUT_PARAM("Hint Coalesce Window", CLI_AMI_LIST_WIDTH, "%d", GLOB(hint_coalesce_window));
+#ifdef CS_SCCP_REALTIME
+	uint32_t realtimecache_hits = 0, realtimecache_misses = 0, realtimecache_entries = 0;
+
+	sccp_config_realtimecache_stats(&realtimecache_hits, &realtimecache_misses, &realtimecache_entries);
+	CLI_AMI_OUTPUT_PARAM("Realtime Cache TTL", CLI_AMI_LIST_WIDTH, "%d", GLOB(realtime_cache_ttl));
+	CLI_AMI_OUTPUT_PARAM("Realtime Cache Hits", CLI_AMI_LIST_WIDTH, "%u", realtimecache_hits);
+	CLI_AMI_OUTPUT_PARAM("Realtime Cache Misses", CLI_AMI_LIST_WIDTH, "%u", realtimecache_misses);
+	CLI_AMI_OUTPUT_PARAM("Realtime Cache Entries", CLI_AMI_LIST_WIDTH, "%u", realtimecache_entries);
+#endif
 
 	if (sccp_netsock_is_any_addr(&GLOB(externip)) && GLOB(externhost)) {
 		struct sockaddr_storage externip;
@@ -1561,6 +1581,23 @@ CLI_AMI_ENTRY(show_hint_lineStates, sccp_show_hint_lineStates, "Show all SCCP Hi
 #undef AMI_COMMAND
 #undef CLI_COMMAND
 #endif														/* DOXYGEN_SHOULD_SKIP_THIS */
+#ifdef CS_DEVSTATE_FEATURE
+    /* ---------------------------------------------------------------------------------------------------SHOW_DEVSTATES - */
+static char cli_show_devstates_usage[] = "Usage: sccp show devstates\n" "	Show All SCCP Custom Devstate Handlers, with their lookup and notify times.\n";
+static char ami_show_devstates_usage[] = "Usage: SCCPShowDevstates\n" "Show All SCCP Custom Devstate Handlers, with their lookup and notify times.\n\n" "PARAMS: None\n";
+
+#ifndef DOXYGEN_SHOULD_SKIP_THIS
+#define CLI_COMMAND "sccp", "show", "devstates"
+#define AMI_COMMAND "SCCPShowDevstates"
+#define CLI_COMPLETE SCCP_CLI_NULL_COMPLETER
+#define CLI_AMI_PARAMS ""
+CLI_AMI_ENTRY(show_devstates, sccp_devstate_showDeviceStates, "Show all SCCP Custom Devstate Handlers", cli_show_devstates_usage, FALSE, TRUE)
+#undef CLI_AMI_PARAMS
+#undef CLI_COMPLETE
+#undef AMI_COMMAND
+#undef CLI_COMMAND
+#endif														/* DOXYGEN_SHOULD_SKIP_THIS */
+#endif														/* CS_DEVSTATE_FEATURE */
     /* ---------------------------------------------------------------------------------------------SHOW_HINT LINESTATES - */
 static char cli_show_hint_subscriptions_usage[] = "Usage: sccp show hint linestates\n" "	Show All SCCP HINT LineStates.\n";
 static char ami_show_hint_subscriptions_usage[] = "Usage: SCCPShowHintLineStates\n" "Show All SCCP Hint Line States.\n\n" "PARAMS: None\n";
@@ -1907,6 +1944,22 @@ CLI_AMI_ENTRY(show_refcount, sccp_show_refcount, "Show all Refcount Entries", cl
 #undef CLI_COMPLETE
 #undef AMI_COMMAND
 #undef CLI_COMMAND
+#endif														/* DOXYGEN_SHOULD_SKIP_THIS */
+
+    /* -------------------------------------------------------------------------------------------SHOW_THREADPOOL - */
+static char cli_show_threadpool_usage[] = "Usage: sccp show threadpool\n" "	Show the queue depth, stealing and wait time statistics of the general threadpool.\n";
+static char ami_show_threadpool_usage[] = "Usage: SCCPShowThreadpool\n" "Show the queue depth, stealing and wait time statistics of the general threadpool.\n\n" "PARAMS: None\n";
+
+#ifndef DOXYGEN_SHOULD_SKIP_THIS
+#define CLI_COMMAND "sccp", "show", "threadpool"
+#define AMI_COMMAND "SCCPShowThreadpool"
+#define CLI_COMPLETE SCCP_CLI_NULL_COMPLETER
+#define CLI_AMI_PARAMS ""
+CLI_AMI_ENTRY(show_threadpool, sccp_show_threadpool, "Show threadpool statistics", cli_show_threadpool_usage, FALSE, TRUE)
+#undef CLI_AMI_PARAMS
+#undef CLI_COMPLETE
+#undef AMI_COMMAND
+#undef CLI_COMMAND
 #endif														/* DOXYGEN_SHOULD_SKIP_THIS */
 
     /* --------------------------------------------------------------------------------------------------SHOW_SOKFTKEYSETS- */
@@ -3420,6 +3473,7 @@ static struct pbx_cli_entry cli_entries[] = {
 	AST_CLI_DEFINE(cli_test, "Test message."),
 #endif
 	AST_CLI_DEFINE(cli_show_refcount, "Test message."),
+	AST_CLI_DEFINE(cli_show_threadpool, "Show threadpool statistics."),
 	AST_CLI_DEFINE(cli_tokenack, "Send Token Acknowledgement."),
 #ifdef CS_SCCP_CONFERENCE
 	AST_CLI_DEFINE(cli_show_conferences, "Show running SCCP Conferences."),
@@ -3427,6 +3481,9 @@ static struct pbx_cli_entry cli_entries[] = {
 	AST_CLI_DEFINE(cli_conference_command, "SCCP Conference Commands."),
 #endif
 	AST_CLI_DEFINE(cli_show_hint_lineStates, "Show all hint lineStates"),
+#ifdef CS_DEVSTATE_FEATURE
+	AST_CLI_DEFINE(cli_show_devstates, "Show all custom devstate handlers"),
+#endif
 	AST_CLI_DEFINE(cli_show_hint_subscriptions, "Show all hint subscriptions")
 };
 
@@ -3471,7 +3528,11 @@ void sccp_register_cli(void)
 #endif
 	pbx_manager_register("SCCPShowHintLineStates", _MAN_REP_FLAGS, manager_show_hint_lineStates, "show hint lineStates", ami_show_hint_lineStates_usage);
 	pbx_manager_register("SCCPShowHintSubscriptions", _MAN_REP_FLAGS, manager_show_hint_subscriptions, "show hint subscriptions", ami_show_hint_subscriptions_usage);
+#ifdef CS_DEVSTATE_FEATURE
+	pbx_manager_register("SCCPShowDevstates", _MAN_REP_FLAGS, manager_show_devstates, "show devstates", ami_show_devstates_usage);
+#endif
 	pbx_manager_register("SCCPShowRefcount", _MAN_REP_FLAGS, manager_show_refcount, "show refcount", ami_show_refcount_usage);
+	pbx_manager_register("SCCPShowThreadpool", _MAN_REP_FLAGS, manager_show_threadpool, "show threadpool", ami_show_threadpool_usage);
 }
 
 /*!
@@ -3508,7 +3569,11 @@ void sccp_unregister_cli(void)
 #endif
 	pbx_manager_unregister("SCCPShowHintLineStates");
 	pbx_manager_unregister("SCCPShowHintSubscriptions");
+#ifdef CS_DEVSTATE_FEATURE
+	pbx_manager_unregister("SCCPShowDevstates");
+#endif
 	pbx_manager_unregister("SCCPShowRefcount");
+	pbx_manager_unregister("SCCPShowThreadpool");
 }
 
 // kate: indent-width 8; replace-tabs off; indent-mode cstyle; auto-insert-doxygen on; line-numbers on; tab-indents on; keep-extra-spaces off; auto-brackets off;
@@ -92,6 +92,7 @@
 #include "sccp_session.h"
 #include "sccp_utils.h"
 #include "sccp_devstate.h"
+#include "sccp_vector.h"
 
 SCCP_FILE_VERSION(__FILE__, "");
 
@@ -241,27 +242,28 @@ static const SCCPConfigSegment *sccp_find_segment(const sccp_config_segment_t se
 }
 
 /*!
- * \brief Find of SCCP Config Options
+ * \brief Find of SCCP Config Options, by scanning the whole segment
+ * \note only used when the option index could not be built
  */
-static const SCCPConfigOption *sccp_find_config(const sccp_config_segment_t segment, const char *name)
+static const SCCPConfigOption *sccp_find_config_linear(const SCCPConfigSegment *sccpConfigSegment, const char *name)
 {
 	long unsigned int i = 0;
-	const SCCPConfigSegment *sccpConfigSegment = sccp_find_segment(segment);
 	const SCCPConfigOption *config = sccpConfigSegment->config;
 
 	char delims[] = "|";
 	char *token = NULL;
 	char *config_name = NULL;
+	char *saveptr = NULL;
 
 	for (i = 0; i < sccpConfigSegment->config_size; i++) {
 		if (strstr(config[i].name, delims) != NULL) {
 			config_name = pbx_strdupa(config[i].name);
-			token = strtok(config_name, delims);
+			token = strtok_r(config_name, delims, &saveptr);
 			while (token != NULL) {
 				if (!strcasecmp(token, name)) {
 					return &config[i];
 				}
-				token = strtok(NULL, delims);
+				token = strtok_r(NULL, delims, &saveptr);
 			}
 		}
 		if (!strcasecmp(config[i].name, name)) {
@@ -272,6 +274,121 @@ static const SCCPConfigOption *sccp_find_config(const sccp_config_segment_t segm
 	return NULL;
 }
 
+/*!
+ * \brief SCCP Config Option Index
+ *
+ * Per segment, every option name (aliases like "disallow|allow" split into separate entries) sorted case-insensitively,
+ * so that sccp_find_config can use a binary search instead of scanning and tokenizing all option names for every
+ * variable in sccp.conf. The names point into the (constant) option table, the index is built once when the module is
+ * loaded and never changes afterwards, so it can be read without locking.
+ */
+#define SCCP_CONFIG_MAX_OPTIONNAMES 128
+struct sccp_config_optionName {
+	const char *name;											/*!< Start of the (alias) name inside SCCPConfigOption->name */
+	size_t len;												/*!< Length of the (alias) name */
+	uint16_t position;											/*!< Position of the option in the segment, first one wins on duplicates */
+};
+static struct sccp_config_optionIndex {
+	struct sccp_config_optionName names[SCCP_CONFIG_MAX_OPTIONNAMES];
+	uint16_t size;
+	boolean_t valid;
+} sccpConfigOptionIndex[ARRAY_LEN(sccpConfigSegments)];
+
+/*!
+ * \brief strcasecmp for a (not terminated) option name
+ */
+static int sccp_config_optionName_cmp(const char *a, size_t alen, const char *b, size_t blen)
+{
+	size_t i = 0;
+	int res = 0;
+
+	for (i = 0; i < alen && i < blen; i++) {
+		if ((res = tolower((unsigned char) a[i]) - tolower((unsigned char) b[i]))) {
+			return res;
+		}
+	}
+	return (alen > blen) - (alen < blen);
+}
+
+static int sccp_config_optionName_sort(const void *a, const void *b)
+{
+	const struct sccp_config_optionName *na = a;
+	const struct sccp_config_optionName *nb = b;
+	int res = sccp_config_optionName_cmp(na->name, na->len, nb->name, nb->len);
+
+	return res ? res : na->position - nb->position;
+}
+
+static void __attribute__((constructor)) sccp_config_buildOptionIndex(void)
+{
+	long unsigned int segment = 0;
+	long unsigned int i = 0;
+	const char *name = NULL;
+	const char *delim = NULL;
+
+	for (segment = 0; segment < ARRAY_LEN(sccpConfigSegments); segment++) {
+		struct sccp_config_optionIndex *index = &sccpConfigOptionIndex[segment];
+
+		index->valid = TRUE;
+		index->size = 0;
+		for (i = 0; i < sccpConfigSegments[segment].config_size && index->valid; i++) {
+			name = sccpConfigSegments[segment].config[i].name;
+			do {
+				if (index->size == SCCP_CONFIG_MAX_OPTIONNAMES) {				/* sccp_find_config falls back to scanning the options */
+					index->valid = FALSE;
+					break;
+				}
+				delim = strchr(name, '|');
+				index->names[index->size].name = name;
+				index->names[index->size].len = delim ? (size_t) (delim - name) : strlen(name);
+				index->names[index->size].position = i;
+				index->size++;
+				name = delim + 1;
+			} while (delim);
+		}
+		if (index->valid) {
+			qsort(index->names, index->size, sizeof(struct sccp_config_optionName), sccp_config_optionName_sort);
+		}
+	}
+}
+
+/*!
+ * \brief Find of SCCP Config Options
+ */
+static const SCCPConfigOption *sccp_find_config(const sccp_config_segment_t segment, const char *name)
+{
+	const SCCPConfigSegment *sccpConfigSegment = sccp_find_segment(segment);
+	const struct sccp_config_optionIndex *index = NULL;
+	size_t namelen = 0;
+	uint16_t low = 0;
+	uint16_t high = 0;
+	uint16_t mid = 0;
+
+	if (!sccpConfigSegment || !name) {
+		return NULL;
+	}
+	index = &sccpConfigOptionIndex[sccpConfigSegment - sccpConfigSegments];
+	if (!index->valid) {
+		return sccp_find_config_linear(sccpConfigSegment, name);
+	}
+
+	/* lower bound, so that the option defined first wins when a name is used twice */
+	namelen = strlen(name);
+	high = index->size;
+	while (low < high) {
+		mid = low + (high - low) / 2;
+		if (sccp_config_optionName_cmp(index->names[mid].name, index->names[mid].len, name, namelen) < 0) {
+			low = mid + 1;
+		} else {
+			high = mid;
+		}
+	}
+	if (low < index->size && !sccp_config_optionName_cmp(index->names[low].name, index->names[low].len, name, namelen)) {
+		return &sccpConfigSegment->config[index->names[low].position];
+	}
+	return NULL;
+}
+
 /* Create new variable structure for Multi Entry Parameters */
 static PBX_VARIABLE_TYPE *createVariableSetForMultiEntryParameters(PBX_VARIABLE_TYPE * cat_root, const char *configOptionName, PBX_VARIABLE_TYPE * out)
 {
@@ -280,9 +397,10 @@ static PBX_VARIABLE_TYPE *createVariableSetForMultiEntryParameters(PBX_VARIABLE_
 	char delims[] = "|";
 	char option_name[strlen(configOptionName) + 2];
 	char *token = NULL;
+	char *saveptr = NULL;
 	
 	snprintf(option_name, sizeof(option_name), "%s%s", configOptionName, delims);
-	token = strtok(option_name, delims);
+	token = strtok_r(option_name, delims, &saveptr);
 	while (token != NULL) {
 		sccp_log_and((DEBUGCAT_CONFIG + DEBUGCAT_HIGH)) (VERBOSE_PREFIX_4 "Token %s/%s\n", option_name, token);
 		for (v = cat_root; v; v = v->next) {
@@ -305,7 +423,7 @@ static PBX_VARIABLE_TYPE *createVariableSetForMultiEntryParameters(PBX_VARIABLE_
 				}
 			}
 		}
-		token = strtok(NULL, delims);
+		token = strtok_r(NULL, delims, &saveptr);
 	}
 EXIT:
 	return out;
@@ -2304,9 +2422,482 @@ void cleanup_stale_contexts(char *new, char *old)
 	}
 }
 
+/*!
+ * \brief Hash of the [general] section the current devices and lines were built against
+ */
+static uint32_t sccp_config_generalHash = 0;
+
+/*!
+ * \brief Hash the variable set of a config category (FNV-1a over name and value, in order)
+ * \param v Asterisk Variable
+ * \return Hash of the category, never 0 (0 is reserved for "not built from sccp.conf")
+ *
+ * \note Template variables are already merged into the category by the config parser, so a change in a template changes the hash of every category using it.
+ * \note Also used to hash realtime rows, see sccp_config_realtimerows_get.
+ */
+uint32_t sccp_config_hashCategory(PBX_VARIABLE_TYPE * v)
+{
+	uint32_t hash = 2166136261U;
+	const unsigned char *p = NULL;
+
+	for (; v; v = v->next) {
+		for (p = (const unsigned char *) v->name; *p; p++) {
+			hash ^= *p;
+			hash *= 16777619U;
+		}
+		hash ^= '=';
+		hash *= 16777619U;
+		for (p = (const unsigned char *) v->value; *p; p++) {
+			hash ^= *p;
+			hash *= 16777619U;
+		}
+		hash ^= '\n';
+		hash *= 16777619U;
+	}
+	return hash ? hash : 1;
+}
+
+/*!
+ * \brief Keep an unchanged device during reload, without rebuilding or resetting it
+ * \param d SCCP Device
+ *
+ * \note Only reverts what pre_reload marked; softkeyset is re-attached by sccp_softkey_post_reload.
+ */
+static void sccp_config_keepUnchangedDevice(sccp_device_t * d)
+{
+	sccp_buttonconfig_t *config = NULL;
+
+	SCCP_LIST_LOCK(&d->buttonconfig);
+	SCCP_LIST_TRAVERSE(&d->buttonconfig, config, list) {
+		config->pendingDelete = 0;
+	}
+	SCCP_LIST_UNLOCK(&d->buttonconfig);
+	d->pendingDelete = 0;
+}
+
+/*!
+ * \brief Minimum number of devices/lines to be built, before the threadpool is used to build them in parallel
+ */
+#define SCCP_CONFIG_PARALLEL_BUILD_MIN 32
+
+/*!
+ * \brief Device or Line to be built from a config category
+ */
+typedef struct sccp_config_buildjob {
+	sccp_device_t *device;											/*!< Retained Device to be built (or NULL) */
+	sccp_line_t *line;											/*!< Retained Line to be built (or NULL) */
+	const char *cat;											/*!< Category Name */
+	PBX_VARIABLE_TYPE *v;											/*!< Category Variables (owned by GLOB(cfg)) */
+	uint32_t hash;												/*!< Hash of the Category Variables */
+	sccp_nat_t nat;												/*!< Nat Status to be restored after the build */
+	boolean_t isNew;											/*!< Needs to be added to the global list after the build */
+	size_t repeat;												/*!< Index+1 of the next definition of the same section (0 = none) */
+} sccp_config_buildjob_t;
+
+SCCP_VECTOR(sccp_config_buildjobs, sccp_config_buildjob_t);
+
+/*!
+ * \brief Build jobs shared between the reload thread and the threadpool helpers
+ * \note Refcounted, so that a helper only getting to run after all jobs have been completed, can still safely find out there is nothing left to do.
+ */
+typedef struct sccp_config_buildqueue {
+	sccp_mutex_t lock;
+	pbx_cond_t finished;											/*!< Signalled when the last job has been built */
+	sccp_config_buildjob_t *jobs;										/*!< Jobs (owned by the reload thread) */
+	size_t size;												/*!< Number of Jobs */
+	size_t next;												/*!< Next Job to be picked up */
+	size_t done;												/*!< Number of Jobs Built */
+	int refcount;
+} sccp_config_buildqueue_t;
+
+/*!
+ * \brief Build a single device or line (does not touch the global lists)
+ * \note A section which is defined more than once is applied once per definition, in config file order, by the thread building its first definition.
+ *       The jobs for the later definitions do not hold an object and are skipped.
+ */
+static void sccp_config_buildJob(sccp_config_buildjob_t * jobs, sccp_config_buildjob_t * job)
+{
+	sccp_device_t *d = job->device;
+	sccp_line_t *l = job->line;
+
+	for (; job && (d || l); job = job->repeat ? &jobs[job->repeat - 1] : NULL) {
+		if (d) {
+			sccp_config_buildDevice(d, job->v, job->cat, FALSE);
+			d->configHash = job->hash;
+		} else {
+			sccp_config_buildLine(l, job->v, job->cat, FALSE);
+			l->configHash = job->hash;
+		}
+	}
+}
+
+/*!
+ * \brief Pick up and build jobs until there are none left
+ */
+static void sccp_config_buildqueue_run(sccp_config_buildqueue_t * queue)
+{
+	sccp_config_buildjob_t *job = NULL;
+
+	do {
+		sccp_mutex_lock(&queue->lock);
+		job = (queue->next < queue->size) ? &queue->jobs[queue->next++] : NULL;
+		sccp_mutex_unlock(&queue->lock);
+		if (job) {
+			sccp_config_buildJob(queue->jobs, job);
+			sccp_mutex_lock(&queue->lock);
+			if (++queue->done == queue->size) {
+				pbx_cond_signal(&queue->finished);
+			}
+			sccp_mutex_unlock(&queue->lock);
+		}
+	} while (job);
+}
+
+static void sccp_config_buildqueue_release(sccp_config_buildqueue_t * queue)
+{
+	int refcount = 0;
+
+	sccp_mutex_lock(&queue->lock);
+	refcount = --queue->refcount;
+	sccp_mutex_unlock(&queue->lock);
+	if (!refcount) {
+		pbx_cond_destroy(&queue->finished);
+		sccp_mutex_destroy(&queue->lock);
+		sccp_free(queue);
+	}
+}
+
+static void *sccp_config_buildqueue_worker(void *data)
+{
+	sccp_config_buildqueue_t *queue = (sccp_config_buildqueue_t *) data;
+
+	sccp_config_buildqueue_run(queue);
+	sccp_config_buildqueue_release(queue);
+	return NULL;
+}
+
+/*!
+ * \brief Queue another definition of an already queued section, to be applied after the previous ones
+ * \param jobs Build Jobs
+ * \param first Index+1 of the job for the first definition of the section
+ */
+static void sccp_config_queueRepeat(struct sccp_config_buildjobs *jobs, size_t first, const char *cat, PBX_VARIABLE_TYPE * v, uint32_t hash)
+{
+	sccp_config_buildjob_t job = { .cat = cat, .v = v, .hash = hash };
+	size_t last = first;
+
+	while (SCCP_VECTOR_GET_ADDR(jobs, last - 1)->repeat) {
+		last = SCCP_VECTOR_GET_ADDR(jobs, last - 1)->repeat;
+	}
+	if (SCCP_VECTOR_APPEND(jobs, job) != 0) {
+		pbx_log(LOG_ERROR, SS_Memory_Allocation_Error, "SCCP");
+		return;
+	}
+	SCCP_VECTOR_GET_ADDR(jobs, last - 1)->repeat = SCCP_VECTOR_SIZE(jobs);
+}
+
+/*!
+ * \brief Build all collected devices and lines, spreading the work over the general threadpool when there is enough of it
+ * \note The reload thread builds jobs itself as well, so this always completes, even when all threadpool workers are busy.
+ * \note At least one threadpool worker is left free for session offloads and event lanes, and no more helpers are queued
+ *       than there are jobs for (one per SCCP_CONFIG_PARALLEL_BUILD_MIN).
+ */
+static void sccp_config_buildJobs(sccp_config_buildjob_t * jobs, size_t size)
+{
+	sccp_config_buildqueue_t *queue = NULL;
+	int helpers = 0;
+	size_t idx = 0;
+
+	if (size < SCCP_CONFIG_PARALLEL_BUILD_MIN || !GLOB(general_threadpool) || !(queue = sccp_calloc(1, sizeof *queue))) {
+		for (idx = 0; idx < size; idx++) {
+			sccp_config_buildJob(jobs, &jobs[idx]);
+		}
+		return;
+	}
+	helpers = sccp_threadpool_thread_count(GLOB(general_threadpool)) - 1;
+	if (helpers > (int) (size / SCCP_CONFIG_PARALLEL_BUILD_MIN)) {
+		helpers = size / SCCP_CONFIG_PARALLEL_BUILD_MIN;
+	}
+	if (helpers < 1) {
+		helpers = 1;
+	}
+	sccp_mutex_init(&queue->lock);
+	pbx_cond_init(&queue->finished, NULL);
+	queue->jobs = jobs;
+	queue->size = size;
+	queue->refcount = 1 + helpers;
+	sccp_log((DEBUGCAT_CONFIG)) (VERBOSE_PREFIX_2 "Building %d devices/lines using %d threadpool helpers\n", (int) size, helpers);
+
+	for (; helpers > 0; helpers--) {
+		if (!sccp_threadpool_add_work(GLOB(general_threadpool), sccp_config_buildqueue_worker, queue)) {
+			break;
+		}
+	}
+	if (helpers) {												/* drop the references of the helpers which could not be queued */
+		sccp_mutex_lock(&queue->lock);
+		queue->refcount -= helpers;
+		sccp_mutex_unlock(&queue->lock);
+	}
+
+	sccp_config_buildqueue_run(queue);
+	sccp_mutex_lock(&queue->lock);
+	while (queue->done < queue->size) {
+		pbx_cond_wait(&queue->finished, &queue->lock);
+	}
+	sccp_mutex_unlock(&queue->lock);
+	sccp_config_buildqueue_release(queue);
+}
+
+static boolean_t sccp_config_getMessageFromDatabase(char *message, size_t len, int *timeout);
+static void __sccp_config_restoreDeviceFeatureStatus(sccp_device_t * device, const char *message, int timeout);
+
+#ifdef CS_SCCP_REALTIME
+/*!
+ * \brief Minimum number of realtime devices/lines in memory, before they are fetched with a single query on reload
+ */
+#define SCCP_CONFIG_REALTIME_BULK_MIN 16
+
+/*!
+ * \brief Realtime table fetched in bulk
+ */
+typedef struct sccp_config_realtimerows {
+	struct ast_config *cfg;											/*!< All Rows */
+	sccp_hashtable_t *index;										/*!< Row Category by name */
+} sccp_config_realtimerows_t;
+
+/*!
+ * \brief Fetch all rows of a realtime table with a single query
+ * \return FALSE if the realtime driver did not return anything, caller should fall back to fetching one row at a time
+ */
+static boolean_t sccp_config_realtimerows_load(sccp_config_realtimerows_t * rows, const char *table)
+{
+	char *cat = NULL;
+	const char *name = NULL;
+
+	memset(rows, 0, sizeof(*rows));
+	if (sccp_strlen_zero(table) || !(rows->cfg = pbx_load_realtime_multientry(table, "name LIKE", "%", NULL))) {
+		return FALSE;
+	}
+	if (!(rows->index = sccp_hashtable_create(table, SCCP_HASH_PRIME, SCCP_HASHTABLE_KEY_STRCASE))) {
+		pbx_config_destroy(rows->cfg);
+		rows->cfg = NULL;
+		return FALSE;
+	}
+	while ((cat = pbx_category_browse(rows->cfg, cat))) {
+		if ((name = pbx_variable_retrieve(rows->cfg, cat, "name"))) {
+			sccp_hashtable_insert(rows->index, name, cat);
+		}
+	}
+	sccp_log((DEBUGCAT_CONFIG + DEBUGCAT_REALTIME)) (VERBOSE_PREFIX_3 "SCCP: Fetched %d rows from realtime table '%s'\n", sccp_hashtable_count(rows->index), table);
+	return TRUE;
+}
+
+/*!
+ * \brief Get a row from a bulk fetched realtime table
+ * \return Copy of the row, without the empty columns (like pbx_load_realtime would return it), NULL if the row does not exist. Needs to be destroyed by the caller.
+ */
+static PBX_VARIABLE_TYPE *sccp_config_realtimerows_get(sccp_config_realtimerows_t * rows, const char *name)
+{
+	const char *cat = NULL;
+	PBX_VARIABLE_TYPE *v = NULL, *root = NULL, *tail = NULL, *new_var = NULL;
+
+	if (!(cat = sccp_hashtable_find(rows->index, name))) {
+		return NULL;
+	}
+	for (v = ast_variable_browse(rows->cfg, cat); v; v = v->next) {
+		if (sccp_strlen_zero(v->value)) {
+			continue;
+		}
+		if (!(new_var = pbx_variable_new(v->name, v->value, ""))) {
+			pbx_log(LOG_ERROR, SS_Memory_Allocation_Error, "SCCP");
+			break;
+		}
+		if (tail) {
+			tail->next = new_var;
+		} else {
+			root = new_var;
+		}
+		tail = new_var;
+	}
+	return root;
+}
+
+static void sccp_config_realtimerows_destroy(sccp_config_realtimerows_t * rows)
+{
+	if (rows->index) {
+		sccp_hashtable_destroy(&rows->index);
+	}
+	if (rows->cfg) {
+		pbx_config_destroy(rows->cfg);
+		rows->cfg = NULL;
+	}
+}
+
+/*!
+ * \brief Maximum number of realtime lookups kept in the cache, the oldest entry is dropped when full
+ */
+#define SCCP_CONFIG_REALTIMECACHE_MAX 1024
+
+/*!
+ * \brief Cached realtime lookup
+ */
+typedef struct sccp_config_realtimecache_entry sccp_config_realtimecache_entry_t;
+struct sccp_config_realtimecache_entry {
+	SCCP_LIST_ENTRY (sccp_config_realtimecache_entry_t) list;						/*!< Linked List Entry, oldest first */
+	PBX_VARIABLE_TYPE *row;											/*!< Copy of the Row (NULL = not found) */
+	struct timeval stamp;											/*!< Time of the Lookup */
+	char key[0];												/*!< table/name */
+};
+
+/*!
+ * \brief Cache of realtime lookups done by sccp_device_find_realtime / sccp_line_find_realtime_byname
+ */
+static struct {
+	SCCP_LIST_HEAD (, sccp_config_realtimecache_entry_t) entries;						/*!< Entries (list lock protects the whole cache) */
+	sccp_hashtable_t *index;										/*!< Entries by key */
+	uint32_t hits;
+	uint32_t misses;
+} sccp_config_realtimecache;
+
+void sccp_config_realtimecache_start(void)
+{
+	SCCP_LIST_HEAD_INIT(&sccp_config_realtimecache.entries);
+	sccp_config_realtimecache.index = sccp_hashtable_create("realtimecache", SCCP_HASH_PRIME, SCCP_HASHTABLE_KEY_STRCASE);
+	sccp_config_realtimecache.hits = 0;
+	sccp_config_realtimecache.misses = 0;
+}
+
+void sccp_config_realtimecache_stop(void)
+{
+	sccp_config_realtimecache_flush();
+	SCCP_LIST_LOCK(&sccp_config_realtimecache.entries);
+	sccp_hashtable_destroy(&sccp_config_realtimecache.index);
+	SCCP_LIST_UNLOCK(&sccp_config_realtimecache.entries);
+	SCCP_LIST_HEAD_DESTROY(&sccp_config_realtimecache.entries);
+}
+
+/* needs to be called with the entries list locked */
+static void sccp_config_realtimecache_remove(sccp_config_realtimecache_entry_t * entry)
+{
+	SCCP_LIST_REMOVE(&sccp_config_realtimecache.entries, entry, list);
+	sccp_hashtable_remove(sccp_config_realtimecache.index, entry->key, entry);
+	if (entry->row) {
+		pbx_variables_destroy(entry->row);
+	}
+	sccp_free(entry);
+}
+
+/*!
+ * \brief Load a row from a realtime table, serving it from the cache if it was looked up less than realtime_cache_ttl seconds ago
+ * \return Row to be destroyed by the caller, NULL if it was not found (now or at the time it was cached)
+ */
+PBX_VARIABLE_TYPE *sccp_config_realtimecache_load(const char *table, const char *name)
+{
+	sccp_config_realtimecache_entry_t *entry = NULL;
+	PBX_VARIABLE_TYPE *row = NULL;
+	boolean_t hit = FALSE;
+	int ttl = GLOB(realtime_cache_ttl);
+	char key[256];
+
+	if (!ttl) {
+		return pbx_load_realtime(table, "name", name, NULL);
+	}
+	snprintf(key, sizeof(key), "%s/%s", table, name);
+
+	SCCP_LIST_LOCK(&sccp_config_realtimecache.entries);
+	if (!sccp_config_realtimecache.index) {									/* cache stopped (module unload) */
+		SCCP_LIST_UNLOCK(&sccp_config_realtimecache.entries);
+		return pbx_load_realtime(table, "name", name, NULL);
+	}
+	if ((entry = sccp_hashtable_find(sccp_config_realtimecache.index, key))) {
+		if (ast_tvdiff_ms(pbx_tvnow(), entry->stamp) >= ttl * 1000) {
+			sccp_config_realtimecache_remove(entry);
+		} else if (!entry->row || (row = pbx_variables_dup(entry->row))) {
+			hit = TRUE;
+		}
+	}
+	if (hit) {
+		sccp_config_realtimecache.hits++;
+	} else {
+		sccp_config_realtimecache.misses++;
+	}
+	SCCP_LIST_UNLOCK(&sccp_config_realtimecache.entries);
+	if (hit) {
+		sccp_log((DEBUGCAT_REALTIME)) (VERBOSE_PREFIX_3 "SCCP: Realtime lookup '%s' served from cache (%s)\n", key, row ? "found" : "not found");
+		return row;
+	}
+
+	/* not cached (anymore), do the lookup without holding the lock */
+	row = pbx_load_realtime(table, "name", name, NULL);
+
+	if (!(entry = sccp_calloc(1, sizeof(*entry) + strlen(key) + 1))) {
+		pbx_log(LOG_ERROR, SS_Memory_Allocation_Error, "SCCP");
+		return row;
+	}
+	strcpy(entry->key, key);
+	entry->stamp = pbx_tvnow();
+	if (row && !(entry->row = pbx_variables_dup(row))) {
+		sccp_free(entry);
+		return row;
+	}
+	SCCP_LIST_LOCK(&sccp_config_realtimecache.entries);
+	if (sccp_config_realtimecache.index) {
+		sccp_config_realtimecache_entry_t *previous = sccp_hashtable_find(sccp_config_realtimecache.index, key);
+
+		if (previous) {											/* looked up by another thread in the meantime */
+			sccp_config_realtimecache_remove(previous);
+		}
+		while (SCCP_LIST_GETSIZE(&sccp_config_realtimecache.entries) >= SCCP_CONFIG_REALTIMECACHE_MAX) {
+			sccp_config_realtimecache_remove(SCCP_LIST_FIRST(&sccp_config_realtimecache.entries));
+		}
+		SCCP_LIST_INSERT_TAIL(&sccp_config_realtimecache.entries, entry, list);
+		sccp_hashtable_insert(sccp_config_realtimecache.index, entry->key, entry);
+		entry = NULL;
+	}
+	SCCP_LIST_UNLOCK(&sccp_config_realtimecache.entries);
+	if (entry) {
+		if (entry->row) {
+			pbx_variables_destroy(entry->row);
+		}
+		sccp_free(entry);
+	}
+	return row;
+}
+
+/*!
+ * \brief Forget all cached realtime lookups (on reload, or when requested via the manager)
+ */
+void sccp_config_realtimecache_flush(void)
+{
+	sccp_config_realtimecache_entry_t *entry = NULL;
+	uint32_t count = 0;
+
+	SCCP_LIST_LOCK(&sccp_config_realtimecache.entries);
+	while ((entry = SCCP_LIST_FIRST(&sccp_config_realtimecache.entries))) {
+		sccp_config_realtimecache_remove(entry);
+		count++;
+	}
+	SCCP_LIST_UNLOCK(&sccp_config_realtimecache.entries);
+	sccp_log((DEBUGCAT_REALTIME)) (VERBOSE_PREFIX_3 "SCCP: Flushed %d cached realtime lookups\n", count);
+}
+
+void sccp_config_realtimecache_stats(uint32_t * hits, uint32_t * misses, uint32_t * entries)
+{
+	SCCP_LIST_LOCK(&sccp_config_realtimecache.entries);
+	*hits = sccp_config_realtimecache.hits;
+	*misses = sccp_config_realtimecache.misses;
+	*entries = SCCP_LIST_GETSIZE(&sccp_config_realtimecache.entries);
+	SCCP_LIST_UNLOCK(&sccp_config_realtimecache.entries);
+}
+#endif
+
 /*!
  * \brief Read Lines from the Config File
  *
+ * On reload, sections whose variable set hashes to the same value as the last time the device/line was built are skipped,
+ * so that only changed sections are re-applied (and only their devices reset). A change in the [general] section
+ * disables this, because devices and lines inherit their defaults from it.
+ *
  * \param readingtype as SCCP Reading Type
  * \since 10.01.2008 - branche V3
  * \author Marcello Ceschia
@@ -2321,8 +2912,21 @@ void sccp_config_readDevicesLines(sccp_readingtype_t readingtype)
 
 	char *cat = NULL;
 	PBX_VARIABLE_TYPE *v = NULL;
-	uint8_t device_count = 0;
-	uint8_t line_count = 0;
+	uint32_t device_count = 0;
+	uint32_t line_count = 0;
+	uint32_t new_line_count = 0;
+	uint32_t unchanged_count = 0;
+	uint32_t hash = 0;
+	boolean_t incremental = FALSE;
+	struct sccp_config_buildjobs jobs;
+	sccp_config_buildjob_t job;
+	sccp_config_buildjob_t *queued = NULL;
+	sccp_hashtable_t *queued_index = NULL;
+	sccp_hashtable_t *seen_index = NULL;
+	sccp_hashtable_t *repeated_index = NULL;
+	size_t idx = 0;
+	char message[256] = "";
+	int message_timeout = 0;
 
 	sccp_log((DEBUGCAT_CONFIG)) (VERBOSE_PREFIX_1 "Loading Devices and Lines from config\n");
 
@@ -2341,6 +2945,32 @@ void sccp_config_readDevicesLines(sccp_readingtype_t readingtype)
 		return;
 	}
 
+	/* only skip unchanged sections if the defaults they inherit from [general] are unchanged as well */
+	hash = sccp_config_hashCategory(ast_variable_browse(GLOB(cfg), "general"));
+	incremental = (readingtype == SCCP_CONFIG_READRELOAD && hash == sccp_config_generalHash);
+	sccp_config_generalHash = hash;
+	sccp_log((DEBUGCAT_CONFIG)) (VERBOSE_PREFIX_2 "%s Reload\n", incremental ? "Incremental" : "Full");
+
+	/* devices and lines are collected first, built in parallel and only then added to the global lists (in config file order) */
+	if (SCCP_VECTOR_INIT(&jobs, 64) != 0) {
+		pbx_log(LOG_ERROR, SS_Memory_Allocation_Error, "SCCP");
+		return;
+	}
+	queued_index = sccp_hashtable_create("configbuild", SCCP_HASH_PRIME, SCCP_HASHTABLE_KEY_STRCASE);
+
+	/* sections which are defined more than once are applied once per definition and never skipped as unchanged */
+	seen_index = sccp_hashtable_create("configseen", SCCP_HASH_PRIME, SCCP_HASHTABLE_KEY_STRCASE);
+	repeated_index = sccp_hashtable_create("configrepeated", SCCP_HASH_PRIME, SCCP_HASHTABLE_KEY_STRCASE);
+	while (seen_index && repeated_index && (cat = pbx_category_browse(GLOB(cfg), cat))) {
+		if (!sccp_hashtable_find(seen_index, cat)) {
+			sccp_hashtable_insert(seen_index, cat, (void *) (uintptr_t) 1);
+		} else if (!sccp_hashtable_find(repeated_index, cat)) {
+			sccp_hashtable_insert(repeated_index, cat, (void *) (uintptr_t) 1);
+		}
+	}
+	sccp_hashtable_destroy(&seen_index);
+	cat = NULL;
+
 	while ((cat = pbx_category_browse(GLOB(cfg), cat))) {
 
 		const char *utype;
@@ -2361,36 +2991,52 @@ void sccp_config_readDevicesLines(sccp_readingtype_t readingtype)
 				continue;
 			} else {
 				v = ast_variable_browse(GLOB(cfg), cat);
+				hash = sccp_config_hashCategory(v);
+
+				/* section seen before, apply this definition after the previous one (on the same thread, so that it is never built by two threads at once) */
+				if (queued_index && (idx = (uintptr_t) sccp_hashtable_find(queued_index, cat)) && SCCP_VECTOR_GET_ADDR(&jobs, idx - 1)->device) {
+					sccp_config_queueRepeat(&jobs, idx, cat, v, hash);
+					continue;
+				}
 
 				// Try to find out if we have the device already on file.
 				// However, do not look into realtime, since
 				// we might have been asked to create a device for realtime addition,
 				// thus causing an infinite loop / recursion.
-				AUTO_RELEASE sccp_device_t *d = sccp_device_find_byid(cat, FALSE);
-				sccp_nat_t nat = SCCP_NAT_AUTO;
+				memset(&job, 0, sizeof(job));
+				job.device = sccp_device_find_byid(cat, FALSE);
+				job.nat = SCCP_NAT_AUTO;
 
 				/* create new device with default values */
-				if (!d) {
-					d = sccp_device_create(cat);
+				if (!job.device) {
+					if (!(job.device = sccp_device_create(cat))) {
+						continue;
+					}
 					// sccp_copy_string(d->id, cat, sizeof(d->id));         /* set device name */
-					sccp_device_addToGlobals(d);
+					job.isNew = TRUE;
 					device_count++;
+				} else if (incremental && !job.device->realtime && job.device->configHash == hash && !sccp_hashtable_find(repeated_index, cat)) {
+					sccp_log((DEBUGCAT_CONFIG)) (VERBOSE_PREFIX_3 "device %s unchanged, skipping\n", cat);
+					sccp_config_keepUnchangedDevice(job.device);
+					sccp_device_release(&job.device);				/* explicit release of found device */
+					unchanged_count++;
+					continue;
 				} else {
-					if (d->pendingDelete) {
-						nat = d->nat;
-						d->pendingDelete = 0;
+					if (job.device->pendingDelete) {
+						job.nat = job.device->nat;
+						job.device->pendingDelete = 0;
 					}
 				}
-				sccp_config_buildDevice(d, v, cat, FALSE);
-				sccp_log((DEBUGCAT_CONFIG)) (VERBOSE_PREFIX_3 "found device %d: %s\n", device_count, cat);
-				/* load saved settings from ast db */
-				sccp_config_restoreDeviceFeatureStatus(d);
-				
-				/* restore current nat status, if device does not get restarted */
-				if (0 == d->pendingDelete && sccp_device_getRegistrationState(d) != SKINNY_DEVICE_RS_NONE) {
-					if (SCCP_NAT_AUTO == d->nat && (SCCP_NAT_AUTO == nat || SCCP_NAT_AUTO_OFF == nat || SCCP_NAT_AUTO_ON == nat)) {
-						d->nat = nat;
-					}
+				job.cat = cat;
+				job.v = v;
+				job.hash = hash;
+				if (SCCP_VECTOR_APPEND(&jobs, job) != 0) {
+					pbx_log(LOG_ERROR, SS_Memory_Allocation_Error, "SCCP");
+					sccp_device_release(&job.device);				/* explicit release of found/created device */
+					continue;
+				}
+				if (queued_index) {
+					sccp_hashtable_insert(queued_index, cat, (void *) (uintptr_t) SCCP_VECTOR_SIZE(&jobs));
 				}
 			}
 		} else if (!strcasecmp(utype, "line")) {
@@ -2402,18 +3048,43 @@ void sccp_config_readDevicesLines(sccp_readingtype_t readingtype)
 			line_count++;
 
 			v = ast_variable_browse(GLOB(cfg), cat);
-			AUTO_RELEASE sccp_line_t *l = sccp_line_find_byname(cat, FALSE);
+			hash = sccp_config_hashCategory(v);
+
+			/* section seen before, apply this definition after the previous one */
+			if (queued_index && (idx = (uintptr_t) sccp_hashtable_find(queued_index, cat)) && SCCP_VECTOR_GET_ADDR(&jobs, idx - 1)->line) {
+				sccp_config_queueRepeat(&jobs, idx, cat, v, hash);
+				continue;
+			}
+			memset(&job, 0, sizeof(job));
+			job.line = sccp_line_find_byname(cat, FALSE);
 
 			/* check if we have this line already */
-			//    SCCP_RWLIST_WRLOCK(&GLOB(lines));
-			if (l) {
+			if (job.line && incremental && !job.line->realtime && job.line->configHash == hash && !sccp_hashtable_find(repeated_index, cat)) {
+				sccp_log((DEBUGCAT_CONFIG)) (VERBOSE_PREFIX_3 "line %s unchanged, skipping\n", cat);
+				job.line->pendingDelete = 0;
+				sccp_line_release(&job.line);						/* explicit release of found line */
+				unchanged_count++;
+				continue;
+			} else if (job.line) {
 				sccp_log((DEBUGCAT_CONFIG)) (VERBOSE_PREFIX_3 "found line %d: %s, do update\n", line_count, cat);
-				sccp_config_buildLine(l, v, cat, FALSE);
-			} else if ((l = sccp_line_create(cat))) {
-				sccp_config_buildLine(l, v, cat, FALSE);
-				sccp_line_addToGlobals(l);						/* may find another line instance create by another thread, in that case the newly created line is going to be dropped when l is released */
+			} else if ((job.line = sccp_line_create(cat))) {
+				/* assign the id up front, the line is only added to the global list (which the default id is derived from) after the build */
+				snprintf(job.line->id, sizeof(job.line->id), "%04d", SCCP_LIST_GETSIZE(&GLOB(lines)) + new_line_count++);
+				job.isNew = TRUE;
+			} else {
+				continue;
+			}
+			job.cat = cat;
+			job.v = v;
+			job.hash = hash;
+			if (SCCP_VECTOR_APPEND(&jobs, job) != 0) {
+				pbx_log(LOG_ERROR, SS_Memory_Allocation_Error, "SCCP");
+				sccp_line_release(&job.line);							/* explicit release of found/created line */
+				continue;
+			}
+			if (queued_index) {
+				sccp_hashtable_insert(queued_index, cat, (void *) (uintptr_t) SCCP_VECTOR_SIZE(&jobs));
 			}
-			//    SCCP_RWLIST_UNLOCK(&GLOB(lines));
 
 		} else if (!strcasecmp(utype, "softkeyset")) {
 			sccp_log((DEBUGCAT_CONFIG)) (VERBOSE_PREFIX_3 "read set %s\n", cat);
@@ -2427,14 +3098,71 @@ void sccp_config_readDevicesLines(sccp_readingtype_t readingtype)
 			pbx_log(LOG_WARNING, "SCCP: (sccp_config_readDevicesLines) UNKNOWN SECTION / UTYPE, type: %s\n", utype);
 		}
 	}
+	sccp_hashtable_destroy(&queued_index);
+	sccp_hashtable_destroy(&repeated_index);
+
+	/* build all devices and lines, then add the new ones to the global lists and restore their state, one by one */
+	sccp_config_buildJobs(jobs.elems, SCCP_VECTOR_SIZE(&jobs));
+	sccp_config_getMessageFromDatabase(message, sizeof(message), &message_timeout);				/* same for every device, only read it once */
+	for (idx = 0; idx < SCCP_VECTOR_SIZE(&jobs); idx++) {
+		queued = SCCP_VECTOR_GET_ADDR(&jobs, idx);
+		if (queued->device) {
+			sccp_device_t *d = queued->device;
+
+			if (queued->isNew) {
+				sccp_device_addToGlobals(d);
+			}
+			sccp_log((DEBUGCAT_CONFIG)) (VERBOSE_PREFIX_3 "found device: %s\n", queued->cat);
+			/* load saved settings from ast db */
+			__sccp_config_restoreDeviceFeatureStatus(d, message, message_timeout);
+
+			/* restore current nat status, if device does not get restarted */
+			if (0 == d->pendingDelete && sccp_device_getRegistrationState(d) != SKINNY_DEVICE_RS_NONE) {
+				if (SCCP_NAT_AUTO == d->nat && (SCCP_NAT_AUTO == queued->nat || SCCP_NAT_AUTO_OFF == queued->nat || SCCP_NAT_AUTO_ON == queued->nat)) {
+					d->nat = queued->nat;
+				}
+			}
+			sccp_device_release(&queued->device);							/* explicit release of found/created device */
+		} else if (queued->line) {
+			if (queued->isNew) {
+				sccp_line_addToGlobals(queued->line);						/* may find another line instance create by another thread, in that case the newly created line is going to be dropped when l is released */
+			}
+			sccp_line_release(&queued->line);							/* explicit release of found/created line */
+		}
+	}
+	sccp_log((DEBUGCAT_CONFIG)) (VERBOSE_PREFIX_2 "Built %d devices/lines (%d new devices, %d new lines)\n", (int) SCCP_VECTOR_SIZE(&jobs), device_count, new_line_count);
+	SCCP_VECTOR_FREE(&jobs);
+
 	sccp_config_add_default_softkeyset();
+	if (incremental) {
+		sccp_log((DEBUGCAT_CONFIG)) (VERBOSE_PREFIX_2 "Skipped %d unchanged device/line sections\n", unchanged_count);
+	}
 
 #ifdef CS_SCCP_REALTIME
+	/* cached realtime lookups may be outdated by now */
+	if (readingtype == SCCP_CONFIG_READRELOAD) {
+		sccp_config_realtimecache_flush();
+	}
+
 	/* reload realtime lines */
 	sccp_configurationchange_t res = SCCP_CONFIG_NOUPDATENEEDED;
 	PBX_VARIABLE_TYPE *rv = NULL;
+	sccp_config_realtimerows_t rows;
+	boolean_t bulk = FALSE;
+	uint32_t realtime_count = 0;
 	
 	sccp_line_t *l = NULL;
+	SCCP_RWLIST_RDLOCK(&GLOB(lines));
+	SCCP_RWLIST_TRAVERSE(&GLOB(lines), l, list) {
+		if (l->realtime == TRUE && l != GLOB(hotline)->line) {
+			realtime_count++;
+		}
+	}
+	SCCP_RWLIST_UNLOCK(&GLOB(lines));
+	/* fetch all rows at once, instead of one round trip per line */
+	bulk = (realtime_count >= SCCP_CONFIG_REALTIME_BULK_MIN && sccp_config_realtimerows_load(&rows, GLOB(realtimelinetable)));
+	realtime_count = 0;
+
 	SCCP_RWLIST_RDLOCK(&GLOB(lines));
 	SCCP_RWLIST_TRAVERSE(&GLOB(lines), l, list) {
 		AUTO_RELEASE sccp_line_t *line = sccp_line_retain(l);
@@ -2442,7 +3170,7 @@ void sccp_config_readDevicesLines(sccp_readingtype_t readingtype)
 			do {
 				if (line->realtime == TRUE && line != GLOB(hotline)->line) {
 					sccp_log((DEBUGCAT_CONFIG)) (VERBOSE_PREFIX_3 "%s: reload realtime line\n", line->name);
-					rv = pbx_load_realtime(GLOB(realtimelinetable), "name", line->name, NULL);
+					rv = bulk ? sccp_config_realtimerows_get(&rows, line->name) : pbx_load_realtime(GLOB(realtimelinetable), "name", line->name, NULL);
 					/* we did not find this line, mark it for deletion */
 					if (!rv) {
 						sccp_log((DEBUGCAT_CONFIG)) (VERBOSE_PREFIX_3 "%s: realtime line not found - set pendingDelete=1\n", line->name);
@@ -2451,7 +3179,16 @@ void sccp_config_readDevicesLines(sccp_readingtype_t readingtype)
 					}
 					line->pendingDelete = 0;
 
+					/* skip unchanged rows */
+					hash = sccp_config_hashCategory(rv);
+					if (incremental && line->configHash == hash) {
+						line->pendingUpdate = 0;
+						pbx_variables_destroy(rv);
+						realtime_count++;
+						break;
+					}
 					res = sccp_config_applyLineConfiguration(line, rv);
+					line->configHash = hash;
 					/* check if we did some changes that needs a device update */
 					if (GLOB(reload_in_progress) && res & SCCP_CONFIG_NEEDDEVICERESET) {
 						line->pendingUpdate = 1;
@@ -2464,9 +3201,24 @@ void sccp_config_readDevicesLines(sccp_readingtype_t readingtype)
 		}
 	}
 	SCCP_RWLIST_UNLOCK(&GLOB(lines));
+	if (bulk) {
+		sccp_config_realtimerows_destroy(&rows);
+	}
+	sccp_log((DEBUGCAT_CONFIG)) (VERBOSE_PREFIX_2 "Skipped %d unchanged realtime lines (%s)\n", realtime_count, bulk ? "bulk" : "per line");
 	/* finished realtime line reload */
 
 	sccp_device_t *d = NULL;
+	realtime_count = 0;
+	SCCP_RWLIST_RDLOCK(&GLOB(devices));
+	SCCP_RWLIST_TRAVERSE(&GLOB(devices), d, list) {
+		if (d->realtime == TRUE) {
+			realtime_count++;
+		}
+	}
+	SCCP_RWLIST_UNLOCK(&GLOB(devices));
+	bulk = (realtime_count >= SCCP_CONFIG_REALTIME_BULK_MIN && sccp_config_realtimerows_load(&rows, GLOB(realtimedevicetable)));
+	realtime_count = 0;
+
 	SCCP_RWLIST_RDLOCK(&GLOB(devices));
 	SCCP_RWLIST_TRAVERSE(&GLOB(devices), d, list) {
 		AUTO_RELEASE sccp_device_t *device = sccp_device_retain(d);
@@ -2474,7 +3226,7 @@ void sccp_config_readDevicesLines(sccp_readingtype_t readingtype)
 			do {
 				if (device->realtime == TRUE) {
 					sccp_log((DEBUGCAT_CONFIG)) (VERBOSE_PREFIX_3 "%s: reload realtime line\n", device->id);
-					rv = pbx_load_realtime(GLOB(realtimedevicetable), "name", device->id, NULL);
+					rv = bulk ? sccp_config_realtimerows_get(&rows, device->id) : pbx_load_realtime(GLOB(realtimedevicetable), "name", device->id, NULL);
 					/* we did not find this line, mark it for deletion */
 					if (!rv) {
 						sccp_log((DEBUGCAT_CONFIG)) (VERBOSE_PREFIX_3 "%s: realtime device not found - set pendingDelete=1\n", device->id);
@@ -2483,7 +3235,16 @@ void sccp_config_readDevicesLines(sccp_readingtype_t readingtype)
 					}
 					device->pendingDelete = 0;
 
+					/* skip unchanged rows */
+					hash = sccp_config_hashCategory(rv);
+					if (incremental && device->configHash == hash) {
+						device->pendingUpdate = 0;
+						pbx_variables_destroy(rv);
+						realtime_count++;
+						break;
+					}
 					res = sccp_config_applyDeviceConfiguration(device, rv);
+					device->configHash = hash;
 					/* check if we did some changes that needs a device update */
 					if (GLOB(reload_in_progress) && res & SCCP_CONFIG_NEEDDEVICERESET) {
 						device->pendingUpdate = 1;
@@ -2496,6 +3257,10 @@ void sccp_config_readDevicesLines(sccp_readingtype_t readingtype)
 		}
 	}
 	SCCP_RWLIST_UNLOCK(&GLOB(devices));
+	if (bulk) {
+		sccp_config_realtimerows_destroy(&rows);
+	}
+	sccp_log((DEBUGCAT_CONFIG)) (VERBOSE_PREFIX_2 "Skipped %d unchanged realtime devices (%s)\n", realtime_count, bulk ? "bulk" : "per device");
 #endif
 
 	if (GLOB(reload_in_progress) && GLOB(pendingUpdate)) {
@@ -2904,6 +3669,37 @@ void sccp_config_softKeySet(PBX_VARIABLE_TYPE * variable, const char *name)
 }
 
 
+#ifndef ASTDB_FAMILY_KEY_LEN
+#define ASTDB_FAMILY_KEY_LEN 256
+#endif
+
+#ifndef ASTDB_RESULT_LEN
+#define ASTDB_RESULT_LEN 256
+#endif
+
+/*!
+ * \brief Read the system message (shown on all devices) from ast-db
+ * \param message Buffer receiving the message text
+ * \param len Size of the message buffer
+ * \param timeout Receives the message timeout (0 = no timeout)
+ * \return TRUE if a message was found
+ */
+static boolean_t sccp_config_getMessageFromDatabase(char *message, size_t len, int *timeout)
+{
+	char timebuffer[ASTDB_RESULT_LEN];
+
+	message[0] = '\0';
+	*timeout = 0;
+	if (iPbx.feature_getFromDatabase("SCCP/message", "text", message, len) && !sccp_strlen_zero(message)) {
+		if (iPbx.feature_getFromDatabase && iPbx.feature_getFromDatabase("SCCP/message", "timeout", timebuffer, sizeof(timebuffer))) {
+			sscanf(timebuffer, "%i", timeout);
+		}
+		return TRUE;
+	}
+	message[0] = '\0';
+	return FALSE;
+}
+
 /*!
  * \brief Restore feature status from ast-db
  * \param device device to be restored
@@ -2915,36 +3711,33 @@ void sccp_config_softKeySet(PBX_VARIABLE_TYPE * variable, const char *name)
  */
 void sccp_config_restoreDeviceFeatureStatus(sccp_device_t * device)
 {
+	char buffer[ASTDB_RESULT_LEN];
+	int timeout = 0;
+
 	if (!device) {
 		return;
 	}
+	sccp_config_getMessageFromDatabase(buffer, sizeof(buffer), &timeout);
+	__sccp_config_restoreDeviceFeatureStatus(device, buffer, timeout);
+}
+
+/*!
+ * \brief Restore feature status from ast-db, using a system message which has already been read
+ * \note Used by sccp_config_readDevicesLines, to read the system message only once for all devices
+ */
+static void __sccp_config_restoreDeviceFeatureStatus(sccp_device_t * device, const char *message, int timeout)
+{
 #ifdef CS_DEVSTATE_FEATURE
 	char buf[256] = "";
 	sccp_devstate_specifier_t *specifier;
 #endif
 
-#ifndef ASTDB_FAMILY_KEY_LEN
-#define ASTDB_FAMILY_KEY_LEN 256
-#endif
-
-#ifndef ASTDB_RESULT_LEN
-#define ASTDB_RESULT_LEN 256
-#endif
-	char buffer[ASTDB_RESULT_LEN];
-	char timebuffer[ASTDB_RESULT_LEN];
-	int timeout = 0;
-
 	/* Message */
-	if (iPbx.feature_getFromDatabase("SCCP/message", "text", buffer, sizeof(buffer))) {
-		if (!sccp_strlen_zero(buffer)) {
-			if (iPbx.feature_getFromDatabase && iPbx.feature_getFromDatabase("SCCP/message", "timeout", timebuffer, sizeof(timebuffer))) {
-				sscanf(timebuffer, "%i", &timeout);
-			}
-			if (timeout) {
-				sccp_dev_displayprinotify(device, buffer, SCCP_MESSAGE_PRIORITY_TIMEOUT, timeout);
-			} else {
-				sccp_device_addMessageToStack(device, SCCP_MESSAGE_PRIORITY_IDLE, buffer);
-			}
+	if (!sccp_strlen_zero(message)) {
+		if (timeout) {
+			sccp_dev_displayprinotify(device, message, SCCP_MESSAGE_PRIORITY_TIMEOUT, timeout);
+		} else {
+			sccp_device_addMessageToStack(device, SCCP_MESSAGE_PRIORITY_IDLE, message);
 		}
 	}
 
@@ -3448,6 +4241,144 @@ AST_TEST_DEFINE(sccp_config_multientry)
 	return AST_TEST_PASS;
 }
 
+AST_TEST_DEFINE(sccp_config_category_hash)
+{
+	switch(cmd) {
+		case TEST_INIT:
+			info->name = "CategoryHash";
+			info->category = "/channels/chan_sccp/config/";
+			info->summary = "chan-sccp-b config test";
+			info->description = "chan-sccp-b config category hash used by incremental reload";
+			return AST_TEST_NOT_RUN;
+		case TEST_EXECUTE:
+			break;
+	}
+
+	PBX_VARIABLE_TYPE *a = NULL, *b = NULL;
+	uint32_t hash = 0;
+	a = ast_variable_new("type", "line", "");
+	a->next = ast_variable_new("cid_num", "98011", "");
+	b = ast_variable_new("type", "line", "");
+	b->next = ast_variable_new("cid_num", "98011", "");
+
+	pbx_test_status_update(test, "Empty category hash is not 0\n");
+	pbx_test_validate(test, sccp_config_hashCategory(NULL) != 0);
+
+	pbx_test_status_update(test, "Identical categories hash the same\n");
+	hash = sccp_config_hashCategory(a);
+	pbx_test_validate(test, hash == sccp_config_hashCategory(b));
+
+	pbx_test_status_update(test, "Changed value changes the hash\n");
+	pbx_variables_destroy(b);
+	b = ast_variable_new("type", "line", "");
+	b->next = ast_variable_new("cid_num", "98012", "");
+	pbx_test_validate(test, hash != sccp_config_hashCategory(b));
+
+	pbx_test_status_update(test, "Moving a character between name and value changes the hash\n");
+	pbx_variables_destroy(b);
+	b = ast_variable_new("type", "line", "");
+	b->next = ast_variable_new("cid_num9", "8011", "");
+	pbx_test_validate(test, hash != sccp_config_hashCategory(b));
+
+	pbx_variables_destroy(a);
+	pbx_variables_destroy(b);
+	return AST_TEST_PASS;
+}
+
+AST_TEST_DEFINE(sccp_config_option_index)
+{
+	switch(cmd) {
+		case TEST_INIT:
+			info->name = "OptionIndex";
+			info->category = "/channels/chan_sccp/config/";
+			info->summary = "chan-sccp-b config option index test and reload benchmark";
+			info->description = "chan-sccp-b config option index test and reload benchmark";
+			return AST_TEST_NOT_RUN;
+		case TEST_EXECUTE:
+			break;
+	}
+
+	long unsigned int segment = 0;
+	long unsigned int i = 0;
+	char *names = NULL;
+	char *token = NULL;
+	char *saveptr = NULL;
+
+	pbx_test_status_update(test, "sccp_find_config index against full scan...\n");
+	for (segment = 0; segment < ARRAY_LEN(sccpConfigSegments); segment++) {
+		const SCCPConfigSegment *sccpConfigSegment = &sccpConfigSegments[segment];
+
+		pbx_test_validate(test, sccpConfigOptionIndex[segment].valid);
+		for (i = 0; i < sccpConfigSegment->config_size; i++) {
+			names = pbx_strdupa(sccpConfigSegment->config[i].name);
+			for (token = strtok_r(names, "|", &saveptr); token; token = strtok_r(NULL, "|", &saveptr)) {
+				pbx_test_validate(test, sccp_find_config(sccpConfigSegment->segment, token) == sccp_find_config_linear(sccpConfigSegment, token));
+				pbx_test_validate(test, sccp_find_config(sccpConfigSegment->segment, token) != NULL);
+			}
+		}
+		pbx_test_validate(test, sccp_find_config(sccpConfigSegment->segment, "no_such_option") == NULL);
+		pbx_test_validate(test, sccp_find_config(sccpConfigSegment->segment, "") == NULL);
+	}
+	pbx_test_validate(test, sccp_find_config(SCCP_CONFIG_GLOBAL_SEGMENT, "ALLOW") == sccp_find_config(SCCP_CONFIG_GLOBAL_SEGMENT, "disallow"));
+	pbx_test_validate(test, sccp_find_config(SCCP_CONFIG_GLOBAL_SEGMENT, "deb") == NULL);
+
+	pbx_test_status_update(test, "Benchmarking option lookups for a synthetic sccp.conf with 5000 devices and 8000 lines...\n");
+	{
+		const struct {
+			sccp_config_segment_t segment;
+			int categories;
+		} synthetic[] = {
+			{SCCP_CONFIG_DEVICE_SEGMENT, 5000},
+			{SCCP_CONFIG_LINE_SEGMENT, 8000},
+		};
+		PBX_VARIABLE_TYPE *root = NULL;
+		PBX_VARIABLE_TYPE *v = NULL;
+		int category = 0;
+		int lookups = 0;
+		int found = 0;
+		int64_t indexed = 0;
+		int64_t linear = 0;
+		struct timeval start;
+
+		for (segment = 0; segment < ARRAY_LEN(synthetic); segment++) {
+			const SCCPConfigSegment *sccpConfigSegment = sccp_find_segment(synthetic[segment].segment);
+
+			/* every option of the segment, using the last alias, as it would appear in a category of sccp.conf */
+			root = NULL;
+			for (i = sccpConfigSegment->config_size; i > 0; i--) {
+				token = strrchr(sccpConfigSegment->config[i - 1].name, '|');
+				v = pbx_variable_new(token ? token + 1 : sccpConfigSegment->config[i - 1].name, "value", "");
+				if (v) {
+					v->next = root;
+					root = v;
+				}
+			}
+
+			start = pbx_tvnow();
+			for (category = 0; category < synthetic[segment].categories; category++) {
+				for (v = root; v; v = v->next) {
+					found += sccp_find_config(synthetic[segment].segment, v->name) ? 1 : 0;
+					lookups++;
+				}
+			}
+			indexed += ast_tvdiff_us(pbx_tvnow(), start);
+
+			start = pbx_tvnow();
+			for (category = 0; category < synthetic[segment].categories; category++) {
+				for (v = root; v; v = v->next) {
+					found -= sccp_find_config_linear(sccpConfigSegment, v->name) ? 1 : 0;
+				}
+			}
+			linear += ast_tvdiff_us(pbx_tvnow(), start);
+			pbx_variables_destroy(root);
+		}
+		pbx_test_status_update(test, "%d lookups: indexed %" PRId64 " usec, full scan %" PRId64 " usec\n", lookups, indexed, linear);
+		pbx_test_validate(test, found == 0);
+	}
+
+	return AST_TEST_PASS;
+}
+
 AST_TEST_DEFINE(sccp_config_tokenized_default)
 {
 	switch(cmd) {
@@ -3523,6 +4454,8 @@ static void __attribute__((constructor)) sccp_register_tests(void)
 	AST_TEST_REGISTER(sccp_config_base_functions);
 	AST_TEST_REGISTER(sccp_config_multientry);
 	AST_TEST_REGISTER(sccp_config_tokenized_default);
+	AST_TEST_REGISTER(sccp_config_option_index);
+	AST_TEST_REGISTER(sccp_config_category_hash);
 	//AST_TEST_REGISTER(sccp_config_setValue);
 	//AST_TEST_REGISTER(sccp_config_setDefault);
 }
@@ -3532,6 +4465,8 @@ static void __attribute__((destructor)) sccp_unregister_tests(void)
 	AST_TEST_UNREGISTER(sccp_config_base_functions);
 	AST_TEST_UNREGISTER(sccp_config_multientry);
 	AST_TEST_UNREGISTER(sccp_config_tokenized_default);
+	AST_TEST_UNREGISTER(sccp_config_option_index);
+	AST_TEST_UNREGISTER(sccp_config_category_hash);
 	//AST_TEST_UNREGISTER(sccp_config_setValue);
 	//AST_TEST_UNREGISTER(sccp_config_setDefault);
 }
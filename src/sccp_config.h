@@ -65,6 +65,14 @@ SCCP_API sccp_configurationchange_t SCCP_CALL sccp_config_applyDeviceDefaults(sc
 
 SCCP_API void SCCP_CALL sccp_config_softKeySet(PBX_VARIABLE_TYPE * variable, const char *name);
 SCCP_API void SCCP_CALL sccp_config_restoreDeviceFeatureStatus(sccp_device_t * device);
+SCCP_API uint32_t SCCP_CALL sccp_config_hashCategory(PBX_VARIABLE_TYPE * v);
+#ifdef CS_SCCP_REALTIME
+SCCP_API void SCCP_CALL sccp_config_realtimecache_start(void);
+SCCP_API void SCCP_CALL sccp_config_realtimecache_stop(void);
+SCCP_API PBX_VARIABLE_TYPE * SCCP_CALL sccp_config_realtimecache_load(const char *table, const char *name);
+SCCP_API void SCCP_CALL sccp_config_realtimecache_flush(void);
+SCCP_API void SCCP_CALL sccp_config_realtimecache_stats(uint32_t * hits, uint32_t * misses, uint32_t * entries);
+#endif
 
 SCCP_API int SCCP_CALL sccp_config_generate(char *filename, int configType);
 __END_C_EXTERN__
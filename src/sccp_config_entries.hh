@@ -114,6 +114,9 @@ static const SCCPConfigOption sccpGlobalConfigOptions[]={
 #ifdef CS_SCCP_REALTIME
 	{"devicetable", 		G_OBJ_REF(realtimedevicetable), 	TYPE_STRINGPTR,									SCCP_CONFIG_FLAG_NONE,						SCCP_CONFIG_NOUPDATENEEDED,		"sccpdevice",			"datebasetable for devices\n"},
 	{"linetable", 			G_OBJ_REF(realtimelinetable), 		TYPE_STRINGPTR,									SCCP_CONFIG_FLAG_NONE,						SCCP_CONFIG_NOUPDATENEEDED,		"sccpline",			"datebasetable for lines\n"},
+	{"realtime_cache_ttl", 		G_OBJ_REF(realtime_cache_ttl),		TYPE_UINT,									SCCP_CONFIG_FLAG_NONE,						SCCP_CONFIG_NOUPDATENEEDED,		"0",				"Number of seconds realtime device/line lookups (including 'not found') are cached, so that unknown devices retrying their registration do not hit the database every time.\n"
+																																					"The cache is flushed on reload and by the SCCPFlushRealtimeCache manager action. 0 disables the cache (default).\n"
+																																					"While enabled, changes made to a device/line in the database can take up to this many seconds to be picked up.\n"},
 #endif
 	{"meetme", 			G_OBJ_REF(meetme), 			TYPE_BOOLEAN,									SCCP_CONFIG_FLAG_NONE,						SCCP_CONFIG_NOUPDATENEEDED,		"yes",				"enable/disable conferencing via meetme (on/off), make sure you have one of the meetme apps mentioned below activated in module.conf\n"
 																																	"when switching meetme=on it will search for the first of these three possible meetme applications and set these defaults\n"
@@ -157,6 +160,19 @@ static const SCCPConfigOption sccpGlobalConfigOptions[]={
 	{"backoff_time", 		G_OBJ_REF(token_backoff_time),		TYPE_INT,									SCCP_CONFIG_FLAG_NONE,						SCCP_CONFIG_NOUPDATENEEDED,		"60",				"Time to wait before re-asking to fallback to primairy server (Token Reject Backoff Time)\n"},
 	{"server_priority", 		G_OBJ_REF(server_priority),		TYPE_INT,									SCCP_CONFIG_FLAG_NONE,						SCCP_CONFIG_NOUPDATENEEDED,		"1",				"Server Priority for fallback: 1=Primairy, 2=Secundary, 3=Tertiary etc\n"
 																																					"For active-active (fallback=odd/even) use 1 for both\n"},
+	{"session_eventloop", 		G_OBJ_REF(session_eventloop),		TYPE_BOOLEAN,									SCCP_CONFIG_FLAG_NONE,						SCCP_CONFIG_NOUPDATENEEDED,		"no",				"Service the device sessions using a small fixed set of epoll based workers, instead of starting one thread per connected device (linux only).\n"
+																																					"Apart from keepalives, statistics and time/date requests, all messages, pending device updates and the session cleanup are handed to the general threadpool.\n"
+																																					"Only applies to newly accepted connections.\n"},
+	{"session_workers", 		G_OBJ_REF(session_workers),		TYPE_UINT,									SCCP_CONFIG_FLAG_NONE,						SCCP_CONFIG_NOUPDATENEEDED,		"0",				"Number of session event-loop workers (used when session_eventloop=yes). 0 = one worker per online cpu.\n"
+																																					"Changes take effect after restarting the module.\n"},
+	{"session_outqueue_high", 	G_OBJ_REF(session_outqueue_high),	TYPE_UINT,									SCCP_CONFIG_FLAG_NONE,						SCCP_CONFIG_NOUPDATENEEDED,		"128",				"Maximum number of messages queued for a device which does not read them fast enough. The high watermark is at 3/4 of it.\n"
+																																					"Once the high watermark is reached, new status (feature/blf) messages to this device are dropped until the queue drains below session_outqueue_low, any other message which does not fit closes the connection. Applies to newly accepted connections.\n"},
+	{"session_outqueue_low", 	G_OBJ_REF(session_outqueue_low),	TYPE_UINT,									SCCP_CONFIG_FLAG_NONE,						SCCP_CONFIG_NOUPDATENEEDED,		"64",				"Number of queued messages below which a congested device accepts new status messages again (low watermark). Values at or above the high watermark use half of session_outqueue_high.\n"},
+	{"session_outqueue_timeout", 	G_OBJ_REF(session_outqueue_timeout),	TYPE_UINT,									SCCP_CONFIG_FLAG_NONE,						SCCP_CONFIG_NOUPDATENEEDED,		"10",				"Number of seconds the message queue of a device may stay congested, before the connection is closed.\n"},
+	{"hint_coalesce_window", 	G_OBJ_REF(hint_coalesce_window),	TYPE_UINT,									SCCP_CONFIG_FLAG_NONE,						SCCP_CONFIG_NOUPDATENEEDED,		"0",				"Number of milliseconds during which hint/blf state changes are coalesced, subscribers only get the latest state at the end of the window.\n"
+																																					"The first RINGING state is always sent immediately. 0 disables coalescing.\n"},
+	{"debug_async", 		G_OBJ_REF(debug_async), 		TYPE_BOOLEAN,									SCCP_CONFIG_FLAG_NONE,						SCCP_CONFIG_NOUPDATENEEDED,		"no",				"Write debug messages from a background thread, so that enabling debug categories does not slow down the device sessions.\n"
+																																					"Messages are dropped (and counted in 'sccp show globals') when a thread logs faster than they can be written.\n"},
 };
 
 /*!
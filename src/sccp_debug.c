@@ -8,6 +8,7 @@
  */
 #include "config.h"
 #include "common.h"
+#include "sccp_atomic.h"
 #include "sccp_debug.h"
 
 SCCP_FILE_VERSION(__FILE__, "");
@@ -67,6 +68,7 @@ int32_t sccp_parse_debugline(char *arguments[], int startat, int argc, int32_t n
 	char *argument = "";
 	char *token = "";
 	const char delimiters[] = " ,\t";
+	char *saveptr = NULL;
 	boolean_t subtract = 0;
 
 	if (sscanf( arguments[startat], "%d", &new_debug_value) != 1) {
@@ -87,7 +89,7 @@ int32_t sccp_parse_debugline(char *arguments[], int startat, int argc, int32_t n
 			} else {
 				// parse comma separated debug_var
 				boolean_t matched = FALSE;
-				token = strtok(argument, delimiters);
+				token = strtok_r(argument, delimiters, &saveptr);
 				while (token != NULL) {
 					// match debug level name to enum
 					for (i = 0; i < ARRAY_LEN(sccp_debug_categories); i++) {
@@ -107,7 +109,7 @@ int32_t sccp_parse_debugline(char *arguments[], int startat, int argc, int32_t n
 					if (!matched) {
 						pbx_log(LOG_NOTICE, "SCCP: unknown debug value '%s'\n", token);
 					}
-					token = strtok(NULL, delimiters);
+					token = strtok_r(NULL, delimiters, &saveptr);
 				}
 			}
 		}
@@ -153,4 +155,324 @@ char *sccp_get_debugcategories(int32_t debugvalue)
 	return res;
 }
 
+/*
+ * Asynchronous Logging
+ *
+ * When debug_async is enabled, sccp_log does not call ast_verbose/ast_log on the calling thread. Instead the formatted
+ * message is stored as a record (timestamp, file/line/function, text) in a ring buffer owned by the calling thread.
+ * Every ring has exactly one producer (its thread) and one consumer (the drain thread), so writing a record never takes
+ * a lock. The drain thread merges the rings in timestamp order and hands the messages to asterisk. When a ring is
+ * full the message is dropped and counted, the logging thread never waits for the drain thread.
+ *
+ * A ring belongs to its thread for as long as that thread lives (thread specific key). Stopping the drain thread does
+ * not free any rings, when a thread exits its ring is marked orphaned, and is either handed to the next thread that
+ * needs a ring or freed by the drain thread once it has been drained. At most SCCP_LOG_MAX_RINGS rings exist, threads
+ * beyond that log synchronously. Only sccp_log_async_destroy (module unload) frees the remaining rings (orphaned or
+ * not), after waiting for the threads that are still writing a record into one of them.
+ */
+#define SCCP_LOG_RING_SIZE 64											/* records per thread, needs to be a power of two */
+#define SCCP_LOG_MAX_RINGS 32											/* a ring takes about 35KB */
+#define SCCP_LOG_RECORD_SIZE 512
+#define SCCP_LOG_DRAIN_INTERVAL 100										/* msec */
+
+struct sccp_log_record {
+	struct timeval tv;
+	const char *file;
+	const char *function;
+	int line;
+	boolean_t notice;											/*!< Send to ast_log(NOTICE) instead of ast_verbose */
+	char text[SCCP_LOG_RECORD_SIZE];
+};
+
+struct sccp_log_ring {
+	volatile CAS32_TYPE head;										/*!< Next record to drain, only advanced by the drain thread */
+	volatile CAS32_TYPE tail;										/*!< Next free record, only advanced by the owning thread */
+	volatile CAS32_TYPE orphaned;										/*!< Owning thread has exited, ring is reused or freed once drained */
+	volatile CAS32_TYPE writing;										/*!< Owning thread is inside __sccp_log_async */
+	sccp_mutex_t lock;											/*!< Only used by the ATOMIC fallback implementation */
+	SCCP_LIST_ENTRY (struct sccp_log_ring) list;
+	struct sccp_log_record records[SCCP_LOG_RING_SIZE];
+};
+
+static struct {
+	SCCP_LIST_HEAD (, struct sccp_log_ring) rings;								/*!< At most SCCP_LOG_MAX_RINGS */
+	pthread_key_t key;
+	pthread_t thread;
+	pbx_cond_t cond;
+	sccp_mutex_t lock;
+	volatile CAS32_TYPE running;
+	volatile CAS32_TYPE dropped;
+	boolean_t initialized;
+} sccp_log_async = {
+	.thread = AST_PTHREADT_NULL,
+};
+
+/*!
+ * \brief Called by pthread when a thread that owns a ring exits
+ */
+static void sccp_log_async_orphanRing(void *data)
+{
+	struct sccp_log_ring *ring = data;
+
+	ATOMIC_INCR(&ring->orphaned, 1, &ring->lock);
+}
+
+static gcc_inline struct sccp_log_ring *sccp_log_async_getRing(void)
+{
+	struct sccp_log_ring *ring = pthread_getspecific(sccp_log_async.key);
+
+	if (dont_expect(!ring)) {										/* first message logged by this thread */
+		SCCP_LIST_LOCK(&sccp_log_async.rings);
+		SCCP_LIST_TRAVERSE(&sccp_log_async.rings, ring, list) {					/* take over the drained ring of an exited thread */
+			if (ring->orphaned && ring->head == ATOMIC_FETCH(&ring->tail, &ring->lock)) {
+				ring->orphaned = 0;
+				break;
+			}
+		}
+		if (!ring && SCCP_LIST_GETSIZE(&sccp_log_async.rings) < SCCP_LOG_MAX_RINGS && (ring = sccp_calloc(1, sizeof *ring))) {
+			sccp_mutex_init(&ring->lock);
+			SCCP_LIST_INSERT_TAIL(&sccp_log_async.rings, ring, list);
+		}
+		if (ring && pthread_setspecific(sccp_log_async.key, ring)) {
+			ring->orphaned = 1;									/* leave it for the next thread */
+			ring = NULL;
+		}
+		SCCP_LIST_UNLOCK(&sccp_log_async.rings);
+	}
+	return ring;
+}
+
+/*!
+ * \brief Queue a debug message to be written by the drain thread
+ * \note called by sccp_log when debug_async is enabled, falls back to synchronous logging when the drain thread is not running
+ */
+void __sccp_log_async(const char *file, int line, const char *function, boolean_t notice, const char *fmt, ...)
+{
+	struct sccp_log_ring *ring = NULL;
+	struct sccp_log_record *record = NULL;
+	CAS32_TYPE tail = 0;
+	CAS32_TYPE used = 0;
+	va_list ap;
+	int len = 0;
+
+	if (ATOMIC_FETCH(&sccp_log_async.running, &sccp_log_async.lock) && (ring = sccp_log_async_getRing())) {
+		ATOMIC_INCR(&ring->writing, 1, &ring->lock);						/* keeps sccp_log_async_destroy from freeing our ring */
+		if (!ATOMIC_FETCH(&sccp_log_async.running, &sccp_log_async.lock)) {			/* stopped in the meantime */
+			ATOMIC_DECR(&ring->writing, 1, &ring->lock);
+			ring = NULL;
+		}
+	}
+	if (!ring) {
+		char text[SCCP_LOG_RECORD_SIZE];
+
+		va_start(ap, fmt);
+		vsnprintf(text, sizeof(text), fmt, ap);
+		va_end(ap);
+		if (notice) {
+			ast_log(__LOG_NOTICE, file, line, function, "%s", text);
+		} else {
+			ast_verbose("%s", text);
+		}
+		return;
+	}
+
+	tail = ring->tail;											/* we are the only writer */
+	used = tail - ATOMIC_FETCH(&ring->head, &ring->lock);
+	if (used >= SCCP_LOG_RING_SIZE) {									/* ring full, drop instead of waiting */
+		ATOMIC_INCR(&sccp_log_async.dropped, 1, &sccp_log_async.lock);
+		ATOMIC_DECR(&ring->writing, 1, &ring->lock);
+		return;
+	}
+	record = &ring->records[tail & (SCCP_LOG_RING_SIZE - 1)];
+	record->tv = pbx_tvnow();
+	record->file = file;
+	record->line = line;
+	record->function = function;
+	record->notice = notice;
+	va_start(ap, fmt);
+	len = vsnprintf(record->text, sizeof(record->text), fmt, ap);
+	va_end(ap);
+	if (len >= (int) sizeof(record->text) && record->text[sizeof(record->text) - 2] != '\n') {	/* keep truncated messages on their own line */
+		record->text[sizeof(record->text) - 2] = '\n';
+	}
+	ATOMIC_INCR(&ring->tail, 1, &ring->lock);								/* publish the record */
+
+	if (used + 1 == SCCP_LOG_RING_SIZE / 2) {								/* half full, do not wait for the drain interval */
+		pbx_cond_signal(&sccp_log_async.cond);
+	}
+	ATOMIC_DECR(&ring->writing, 1, &ring->lock);
+}
+
+/*!
+ * \brief Write all queued records, oldest first, and free the rings of exited threads
+ * \note the rings are collected under the rings lock and written out without it, only the drain thread (and
+ *       sccp_log_async_destroy, after stopping it) frees rings, so they stay valid in between
+ */
+static void sccp_log_async_drain(void)
+{
+	struct sccp_log_ring *rings[SCCP_LOG_MAX_RINGS];
+	struct sccp_log_ring *ring = NULL;
+	struct sccp_log_ring *oldest = NULL;
+	struct sccp_log_record *record = NULL;
+	struct sccp_log_record *candidate = NULL;
+	int numRings = 0;
+	int r = 0;
+
+	SCCP_LIST_LOCK(&sccp_log_async.rings);
+	SCCP_LIST_TRAVERSE(&sccp_log_async.rings, ring, list) {
+		if (numRings < SCCP_LOG_MAX_RINGS) {
+			rings[numRings++] = ring;
+		}
+	}
+	SCCP_LIST_UNLOCK(&sccp_log_async.rings);
+
+	do {
+		oldest = NULL;
+		record = NULL;
+		for (r = 0; r < numRings; r++) {
+			ring = rings[r];
+			if (ring->head != ATOMIC_FETCH(&ring->tail, &ring->lock)) {
+				candidate = &ring->records[ring->head & (SCCP_LOG_RING_SIZE - 1)];
+				if (!record || ast_tvdiff_us(candidate->tv, record->tv) < 0) {
+					oldest = ring;
+					record = candidate;
+				}
+			}
+		}
+		if (oldest) {
+			if (record->notice) {
+				ast_log(__LOG_NOTICE, record->file, record->line, record->function, "%s", record->text);
+			} else {
+				ast_verbose("%s", record->text);
+			}
+			ATOMIC_INCR(&oldest->head, 1, &oldest->lock);						/* hand the record back to the owning thread */
+		}
+	} while (oldest);
+
+	SCCP_LIST_LOCK(&sccp_log_async.rings);
+	SCCP_LIST_TRAVERSE_SAFE_BEGIN(&sccp_log_async.rings, ring, list) {
+		if (ring->orphaned && ring->head == ring->tail) {
+			SCCP_LIST_REMOVE_CURRENT(list);
+			sccp_mutex_destroy(&ring->lock);
+			sccp_free(ring);
+		}
+	}
+	SCCP_LIST_TRAVERSE_SAFE_END;
+	SCCP_LIST_UNLOCK(&sccp_log_async.rings);
+}
+
+static void *sccp_log_async_thread(void *data)
+{
+	struct timespec ts;
+	struct timeval tv;
+
+	sccp_mutex_lock(&sccp_log_async.lock);
+	while (sccp_log_async.running) {
+		sccp_mutex_unlock(&sccp_log_async.lock);
+		sccp_log_async_drain();
+		sccp_mutex_lock(&sccp_log_async.lock);
+		if (!sccp_log_async.running) {
+			break;
+		}
+		gettimeofday(&tv, NULL);
+		tv.tv_usec += SCCP_LOG_DRAIN_INTERVAL * 1000;
+		ts.tv_sec = tv.tv_sec + tv.tv_usec / 1000000;
+		ts.tv_nsec = (tv.tv_usec % 1000000) * 1000;
+		pbx_cond_timedwait(&sccp_log_async.cond, &sccp_log_async.lock, &ts);
+	}
+	sccp_mutex_unlock(&sccp_log_async.lock);
+	sccp_log_async_drain();											/* write whatever is left */
+	return NULL;
+}
+
+/*!
+ * \brief Initialize asynchronous logging, called once at module load
+ * \note the drain thread is only started by sccp_log_async_start, when debug_async is enabled
+ */
+void sccp_log_async_init(void)
+{
+	SCCP_LIST_HEAD_INIT(&sccp_log_async.rings);
+	sccp_mutex_init(&sccp_log_async.lock);
+	pbx_cond_init(&sccp_log_async.cond, NULL);
+	sccp_log_async.dropped = 0;
+	if (pthread_key_create(&sccp_log_async.key, sccp_log_async_orphanRing)) {
+		pbx_log(LOG_ERROR, "SCCP: Failed to create asynchronous logging key, debug_async will log synchronously\n");
+		return;
+	}
+	sccp_log_async.initialized = TRUE;
+}
+
+/*!
+ * \brief Start the asynchronous logging drain thread, if it is not running yet
+ */
+void sccp_log_async_start(void)
+{
+	if (!sccp_log_async.initialized || sccp_log_async.thread != AST_PTHREADT_NULL) {
+		return;
+	}
+	sccp_log_async.running = 1;
+	if (pbx_pthread_create(&sccp_log_async.thread, NULL, sccp_log_async_thread, NULL)) {
+		pbx_log(LOG_ERROR, "SCCP: Failed to start asynchronous logging thread, debug_async will log synchronously\n");
+		ATOMIC_DECR(&sccp_log_async.running, 1, &sccp_log_async.lock);
+		sccp_log_async.thread = AST_PTHREADT_NULL;
+	}
+}
+
+/*!
+ * \brief Stop the asynchronous logging drain thread, after writing all queued messages
+ * \note rings stay with their threads, they are reused when the drain thread is started again
+ */
+void sccp_log_async_stop(void)
+{
+	if (sccp_log_async.thread == AST_PTHREADT_NULL) {
+		return;
+	}
+	sccp_mutex_lock(&sccp_log_async.lock);
+	ATOMIC_DECR(&sccp_log_async.running, 1, &sccp_log_async.lock);				/* from now on sccp_log is synchronous again */
+	pbx_cond_signal(&sccp_log_async.cond);
+	sccp_mutex_unlock(&sccp_log_async.lock);
+	pthread_join(sccp_log_async.thread, NULL);
+	sccp_log_async.thread = AST_PTHREADT_NULL;
+}
+
+/*!
+ * \brief Stop asynchronous logging and free all rings (orphaned or not), called once at module unload
+ */
+void sccp_log_async_destroy(void)
+{
+	struct sccp_log_ring *ring = NULL;
+
+	if (!sccp_log_async.initialized) {
+		return;
+	}
+	sccp_log_async_stop();
+	SCCP_LIST_LOCK(&sccp_log_async.rings);
+	SCCP_LIST_TRAVERSE(&sccp_log_async.rings, ring, list) {						/* wait for threads still writing a record */
+		while (ATOMIC_FETCH(&ring->writing, &ring->lock)) {
+			usleep(1000);
+		}
+	}
+	SCCP_LIST_UNLOCK(&sccp_log_async.rings);
+	pthread_key_delete(sccp_log_async.key);								/* threads no longer own their ring, and will not call sccp_log_async_orphanRing after unload */
+	sccp_log_async.initialized = FALSE;
+
+	SCCP_LIST_LOCK(&sccp_log_async.rings);
+	while ((ring = SCCP_LIST_REMOVE_HEAD(&sccp_log_async.rings, list))) {
+		sccp_mutex_destroy(&ring->lock);
+		sccp_free(ring);
+	}
+	SCCP_LIST_UNLOCK(&sccp_log_async.rings);
+	SCCP_LIST_HEAD_DESTROY(&sccp_log_async.rings);
+	pbx_cond_destroy(&sccp_log_async.cond);
+	sccp_mutex_destroy(&sccp_log_async.lock);
+}
+
+/*!
+ * \brief Number of messages dropped because the ring of the logging thread was full
+ */
+uint32_t sccp_log_async_dropped(void)
+{
+	return (uint32_t) sccp_log_async.dropped;
+}
+
 // kate: indent-width 8; replace-tabs off; indent-mode cstyle; auto-insert-doxygen on; line-numbers on; tab-indents on; keep-extra-spaces off; auto-brackets off;
@@ -10,7 +10,7 @@
 #include "config.h"
 #include "define.h"
 
-#define sccp_log1(...) { if ((sccp_globals->debug & (DEBUGCAT_FILELINEFUNC)) == DEBUGCAT_FILELINEFUNC) { ast_log(AST_LOG_NOTICE, __VA_ARGS__); } else { ast_verbose(__VA_ARGS__); } }
+#define sccp_log1(...) { if (sccp_globals->debug_async) { __sccp_log_async(__FILE__, __LINE__, __PRETTY_FUNCTION__, (sccp_globals->debug & (DEBUGCAT_FILELINEFUNC)) == DEBUGCAT_FILELINEFUNC, __VA_ARGS__); } else if ((sccp_globals->debug & (DEBUGCAT_FILELINEFUNC)) == DEBUGCAT_FILELINEFUNC) { ast_log(AST_LOG_NOTICE, __VA_ARGS__); } else { ast_verbose(__VA_ARGS__); } }
 #define sccp_log(_x) if ((sccp_globals->debug & (_x))) sccp_log1
 #define sccp_log_and(_x) if ((sccp_globals->debug & (_x)) == (_x)) sccp_log1
 
@@ -66,5 +66,12 @@ extern const struct sccp_debug_category sccp_debug_categories[32];
 
 SCCP_API int32_t SCCP_CALL sccp_parse_debugline(char *arguments[], int startat, int argc, int32_t new_debug_value);
 SCCP_API char * SCCP_CALL sccp_get_debugcategories(int32_t debugvalue);
+
+SCCP_API void SCCP_CALL sccp_log_async_init(void);
+SCCP_API void SCCP_CALL sccp_log_async_start(void);
+SCCP_API void SCCP_CALL sccp_log_async_stop(void);
+SCCP_API void SCCP_CALL sccp_log_async_destroy(void);
+SCCP_API uint32_t SCCP_CALL sccp_log_async_dropped(void);
+SCCP_API void SCCP_CALL __sccp_log_async(const char *file, int line, const char *function, boolean_t notice, const char *fmt, ...) __attribute__ ((format (printf, 5, 6)));
 __END_C_EXTERN__
 // kate: indent-width 8; replace-tabs off; indent-mode cstyle; auto-insert-doxygen on; line-numbers on; tab-indents on; keep-extra-spaces off; auto-brackets off;
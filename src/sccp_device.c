@@ -38,6 +38,7 @@ SCCP_FILE_VERSION(__FILE__, "");
 #if defined(CS_AST_HAS_EVENT) && defined(HAVE_PBX_EVENT_H) 	// ast_event_subscribe
 #  include <asterisk/event.h>
 #endif
+#include <asterisk/threadstorage.h>
 
 int __sccp_device_destroy(const void *ptr);
 void sccp_device_removeFromGlobals(devicePtr device);
@@ -200,7 +201,7 @@ static void sccp_device_setRingtone(constDevicePtr device, const char *url)
 	device->protocol->sendUserToDeviceDataVersionMessage(device, APPID_RINGTONE, 0, 0, transactionID, xmlStr, 0);
 }
 
-static void sccp_device_copyStr2Locale_UTF8(constDevicePtr d, char *dst, ICONV_CONST char *src, size_t dst_size)
+static void sccp_device_copyStr2Locale_UTF8(constDevicePtr d, char *dst, const char *src, size_t dst_size)
 {
 	if (!dst || !src) {
 		return;
@@ -208,8 +209,7 @@ static void sccp_device_copyStr2Locale_UTF8(constDevicePtr d, char *dst, ICONV_C
 	sccp_copy_string(dst, src, dst_size);
 }
 
-#if HAVE_ICONV
-static void sccp_device_copyStr2Locale_Convert(constDevicePtr d, char *dst, ICONV_CONST char *src, size_t dst_size)
+static void sccp_device_copyStr2Locale_Convert(constDevicePtr d, char *dst, const char *src, size_t dst_size)
 {
 	if (!dst || !src) {
 		return;
@@ -222,7 +222,6 @@ static void sccp_device_copyStr2Locale_Convert(constDevicePtr d, char *dst, ICON
 		return;
 	}
 }
-#endif
 
 static void sccp_device_setRingtoneNotSupported(constDevicePtr device, const char *url)
 {
@@ -322,7 +321,7 @@ void sccp_device_pre_reload(void)
 	sccp_device_t *d = NULL;
 	sccp_buttonconfig_t *config = NULL;
 
-	SCCP_RWLIST_WRLOCK(&GLOB(devices));
+	SCCP_RWLIST_RDLOCK(&GLOB(devices));									/* only flags are changed, the list itself is not modified */
 	SCCP_RWLIST_TRAVERSE(&GLOB(devices), d, list) {
 		//sccp_log((DEBUGCAT_CONFIG + DEBUGCAT_DEVICE)) (VERBOSE_PREFIX_2 "%s: Setting Device to Pending Delete=1\n", d->id);
 		if (!d->realtime) {										/* don't want to reset hotline devices. */
@@ -724,11 +723,9 @@ void sccp_device_preregistration(devicePtr device)
 			device->indicate = &sccp_device_indication_olderDevices;
 			break;
 	}
-#if HAVE_ICONV
 	if (!(device->device_features & SKINNY_PHONE_FEATURES_UTF8)) {
 		device->copyStr2Locale = sccp_device_copyStr2Locale_Convert;
 	}
-#endif
 }
 
 /*!
@@ -749,6 +746,7 @@ void sccp_device_addToGlobals(constDevicePtr device)
 	if (d) {
 		SCCP_RWLIST_WRLOCK(&GLOB(devices));
 		SCCP_RWLIST_INSERT_SORTALPHA(&GLOB(devices), d, list, id);
+		sccp_hashtable_insert(GLOB(device_index), d->id, d);
 		SCCP_RWLIST_UNLOCK(&GLOB(devices));
 		sccp_log((DEBUGCAT_DEVICE)) (VERBOSE_PREFIX_3 "Added device '%s' to Glob(devices)\n", d->id);
 	}
@@ -773,6 +771,7 @@ void sccp_device_removeFromGlobals(devicePtr device)
 	SCCP_RWLIST_WRLOCK(&GLOB(devices));
 	if ((d = SCCP_RWLIST_REMOVE(&GLOB(devices), device, list))) {
 		sccp_log((DEBUGCAT_CORE + DEBUGCAT_DEVICE)) (VERBOSE_PREFIX_3 "Removed device '%s' from Glob(devices)\n", DEV_ID_LOG(device));
+		sccp_hashtable_remove(GLOB(device_index), d->id, d);
 		sccp_device_release(&d);					/* explicit release of device after removing from list */
 	}
 	SCCP_RWLIST_UNLOCK(&GLOB(devices));
@@ -1141,18 +1140,157 @@ uint8_t sccp_dev_build_buttontemplate(devicePtr d, btnlist * btn)
 	return btn_index;
 }
 
+/*
+ * Packet Buffer Pool
+ *
+ * Packets which have been sent are not freed, but kept on a free list per size class, from which sccp_build_packet takes it's buffers, so
+ * that the outbound path does not have to allocate and free memory for every message. The buffers are plain allocations, so a packet
+ * which is never sent can still be released using sccp_free. Like the refcount object pools, the free lists are split into
+ * SCCP_PACKET_POOL_SHARDS shards and every thread sticks to one of them, so that the session threads do not contend on a single lock.
+ */
+#define SCCP_PACKET_POOL_CLASSES 6										/* 64, 128, 256, 512, 1024, 2048 bytes */
+#define SCCP_PACKET_POOL_MINSIZE 64
+#define SCCP_PACKET_POOL_DEPTH 16										/* max number of free buffers kept per size class and shard */
+#define SCCP_PACKET_POOL_SHARDS 8
+static struct sccp_packet_pool_shard {
+	sccp_mutex_t lock;
+	struct sccp_packet_pool {
+		void *freeList;											/* first bytes of a free buffer point to the next one */
+		uint32_t numFree;
+	} classes[SCCP_PACKET_POOL_CLASSES];
+} packet_pool[SCCP_PACKET_POOL_SHARDS];
+static volatile boolean_t packet_pool_running = FALSE;
+AST_THREADSTORAGE(sccp_packet_pool_shard_buf);
+static volatile CAS32_TYPE nextPacketPoolShard = 0;
+
+static gcc_inline struct sccp_packet_pool_shard *__sccp_packet_pool_getShard(void)
+{
+	int *shard = ast_threadstorage_get(&sccp_packet_pool_shard_buf, sizeof(int));
+
+	if (do_expect(shard != NULL)) {
+		if (dont_expect(!*shard)) {									/* first use by this thread, 0 means unassigned */
+			*shard = (ATOMIC_INCR(&nextPacketPoolShard, 1, &packet_pool[0].lock) % SCCP_PACKET_POOL_SHARDS) + 1;
+		}
+		return &packet_pool[*shard - 1];
+	}
+	return &packet_pool[0];
+}
+
+static gcc_inline int __sccp_packet_pool_class(size_t size)
+{
+	int sizeclass = 0;
+	size_t classSize = SCCP_PACKET_POOL_MINSIZE;
+
+	while (classSize < size && sizeclass < SCCP_PACKET_POOL_CLASSES) {
+		classSize <<= 1;
+		sizeclass++;
+	}
+	return sizeclass;											/* SCCP_PACKET_POOL_CLASSES when size does not fit any class */
+}
+
+/*!
+ * \brief Release a packet created by sccp_build_packet, keeping the buffer for reuse
+ * \param msg SCCP Message (can be NULL)
+ */
+void sccp_free_packet(sccp_msg_t * msg)
+{
+	if (!msg) {
+		return;
+	}
+	int sizeclass = __sccp_packet_pool_class(letohl(msg->header.length) + (SCCP_PACKET_HEADER - 4));	/* same size sccp_build_packet used, length does not include the length and reserved fields */
+
+	if (sizeclass < SCCP_PACKET_POOL_CLASSES && packet_pool_running) {
+		struct sccp_packet_pool_shard *shard = __sccp_packet_pool_getShard();
+		struct sccp_packet_pool *pool = &shard->classes[sizeclass];
+		sccp_mutex_lock(&shard->lock);
+		if (pool->numFree < SCCP_PACKET_POOL_DEPTH) {
+			*(void **) msg = pool->freeList;
+			pool->freeList = msg;
+			pool->numFree++;
+			msg = NULL;
+		}
+		sccp_mutex_unlock(&shard->lock);
+	}
+	if (msg) {
+		sccp_free(msg);
+	}
+}
+
+/*!
+ * \brief Initialize the packet buffer pool (during module load)
+ */
+void sccp_packet_pool_init(void)
+{
+	int shard;
+
+	for (shard = 0; shard < SCCP_PACKET_POOL_SHARDS; shard++) {
+		pbx_mutex_init_notracking(&packet_pool[shard].lock);
+	}
+	packet_pool_running = TRUE;
+}
+
+/*!
+ * \brief Free all pooled packet buffers (during module unload)
+ */
+void sccp_packet_pool_destroy(void)
+{
+	int shard, sizeclass;
+	void *buffer;
+
+	if (!packet_pool_running) {
+		return;
+	}
+	packet_pool_running = FALSE;										/* packets released from now on are freed directly */
+	for (shard = 0; shard < SCCP_PACKET_POOL_SHARDS; shard++) {
+		sccp_mutex_lock(&packet_pool[shard].lock);
+		for (sizeclass = 0; sizeclass < SCCP_PACKET_POOL_CLASSES; sizeclass++) {
+			while ((buffer = packet_pool[shard].classes[sizeclass].freeList)) {
+				packet_pool[shard].classes[sizeclass].freeList = *(void **) buffer;
+				sccp_free(buffer);
+			}
+			packet_pool[shard].classes[sizeclass].numFree = 0;
+		}
+		sccp_mutex_unlock(&packet_pool[shard].lock);
+		pbx_mutex_destroy(&packet_pool[shard].lock);
+	}
+}
+
 /*!
  * \brief Build an SCCP Message Packet
  * \param[in] t SCCP Message Text
  * \param[out] pkt_len Packet Length
  * \return SCCP Message
+ *
+ * \note the packet should be handed to sccp_dev_send / sccp_session_send, or released using sccp_free_packet
  */
 sccp_msg_t __attribute__ ((malloc)) * sccp_build_packet(sccp_mid_t t, size_t pkt_len)
 {
 	int padding = ((pkt_len + 8) % 4);
 	padding = (padding > 0) ? 4 - padding : 0;
-	
-	sccp_msg_t *msg = sccp_calloc(1, pkt_len + SCCP_PACKET_HEADER + padding);
+
+	size_t size = pkt_len + SCCP_PACKET_HEADER + padding;
+	int sizeclass = __sccp_packet_pool_class(size);
+	sccp_msg_t *msg = NULL;
+
+	if (sizeclass < SCCP_PACKET_POOL_CLASSES) {
+		if (packet_pool_running) {
+			struct sccp_packet_pool_shard *shard = __sccp_packet_pool_getShard();
+			struct sccp_packet_pool *pool = &shard->classes[sizeclass];
+			sccp_mutex_lock(&shard->lock);
+			if ((msg = pool->freeList)) {
+				pool->freeList = *(void **) msg;
+				pool->numFree--;
+			}
+			sccp_mutex_unlock(&shard->lock);
+		}
+		if (msg) {
+			memset(msg, 0, size);
+		} else {
+			msg = sccp_calloc(1, SCCP_PACKET_POOL_MINSIZE << sizeclass);				/* allocate the full class size, so the buffer can be pooled */
+		}
+	} else {
+		msg = sccp_calloc(1, size);
+	}
 
 	if (!msg) {
 		pbx_log(LOG_WARNING, "SCCP: Packet memory allocation error\n");
@@ -1181,7 +1319,7 @@ int sccp_dev_send(constDevicePtr d, sccp_msg_t * msg)
 		sccp_log((DEBUGCAT_MESSAGE)) (VERBOSE_PREFIX_3 "%s: >> Send message %s\n", d->id, msgtype2str(letohl(msg->header.lel_messageId)));
 		result = sccp_session_send(d, msg);
 	} else {
-		sccp_free(msg);
+		sccp_free_packet(msg);
 	}
 	return result;
 }
@@ -3069,9 +3207,7 @@ sccp_device_t *sccp_device_find_byid(const char *id, boolean_t useRealtime)
 		return NULL;
 	}
 
-	SCCP_RWLIST_RDLOCK(&GLOB(devices));
-	d = SCCP_RWLIST_FIND(&GLOB(devices), sccp_device_t, tmpd, list, (sccp_strcaseequals(tmpd->id, id)), TRUE, __FILE__, __LINE__, __PRETTY_FUNCTION__);
-	SCCP_RWLIST_UNLOCK(&GLOB(devices));
+	d = sccp_hashtable_find_retained(GLOB(device_index), id);						/* GLOB(devices) is kept for ordered (cli) traversal */
 
 #ifdef CS_SCCP_REALTIME
 	if (!d && useRealtime) {
@@ -3112,7 +3248,7 @@ sccp_device_t *sccp_device_find_realtime(const char *name)
 	if (sccp_strlen_zero(GLOB(realtimedevicetable)) || sccp_strlen_zero(name)) {
 		return NULL;
 	}
-	if ((variable = pbx_load_realtime(GLOB(realtimedevicetable), "name", name, NULL))) {
+	if ((variable = sccp_config_realtimecache_load(GLOB(realtimedevicetable), name))) {
 		v = variable;
 		sccp_log((DEBUGCAT_DEVICE + DEBUGCAT_REALTIME)) (VERBOSE_PREFIX_3 "SCCP: Device '%s' found in realtime table '%s'\n", name, GLOB(realtimedevicetable));
 
@@ -3130,6 +3266,7 @@ sccp_device_t *sccp_device_find_realtime(const char *name)
 		sccp_device_addToGlobals(d);				/** add to device to global device list */
 
 		d->realtime = TRUE;					/** set device as realtime device */
+		d->configHash = sccp_config_hashCategory(v);		/** skip this row on reload, as long as it does not change */
 		pbx_variables_destroy(v);
 
 		return d;
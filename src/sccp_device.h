@@ -232,6 +232,7 @@ struct sccp_device {
 	char *meetmeopts;											/*!< Meetme Options to be Used */
 	skinny_lampmode_t mwilamp;										/*!< MWI/Lamp to indicate MailBox Messages */
 	uint32_t mwilight;											/*!< MWI/Light bit field to to store mwi light for each line and device (offset 0 is current device state) */
+	boolean_t mwiUpdatePending;										/*!< MWI/Light recalculation for this device has been queued (protected by the mwi module) */
 
 	struct {
 		sccp_channel_t *transferee;									/*!< SCCP Channel which will be transferred */
@@ -319,7 +320,7 @@ struct sccp_device {
 	char *softkeyDefinition;										/*!< requested softKey configuration */
 	sccp_softKeySetConfiguration_t *softkeyset;								/*!< Allow for a copy of the softkeyset, if any of the softkeys needs to be redefined, for example for urihook/uriaction */
 
-	void (*copyStr2Locale) (constDevicePtr d, char *dst, ICONV_CONST char *src, size_t dst_size);		/*!< copy string to device converted to locale if necessary */
+	void (*copyStr2Locale) (constDevicePtr d, char *dst, const char *src, size_t dst_size);		/*!< copy string to device converted to locale if necessary */
 
 #ifdef CS_SCCP_CONFERENCE
 	sccp_conference_t *conference;										/*!< conference we are part of */ /*! \todo to be removed in favor of conference_id */
@@ -343,6 +344,7 @@ struct sccp_device {
 
 	boolean_t pendingDelete;										/*!< this bit will tell the scheduler to delete this line when unused */
 	boolean_t pendingUpdate;										/*!< this will contain the updated line struct once reloaded from config to update the line when unused */
+	uint32_t configHash;											/*!< hash of the sccp.conf section this device was last built from (0 = none) */
 };
 
 // Number of additional keys per addon -FS
@@ -410,6 +412,9 @@ SCCP_API sccp_buttonconfig_t * SCCP_CALL sccp_dev_serviceURL_find_byindex(device
 #define REQ(x,y) x = sccp_build_packet(y, sizeof(x->data.y))
 #define REQCMD(x,y) x = sccp_build_packet(y, 0)
 SCCP_API sccp_msg_t * SCCP_CALL sccp_build_packet(sccp_mid_t t, size_t pkt_len);
+SCCP_API void SCCP_CALL sccp_free_packet(sccp_msg_t * msg);
+SCCP_API void SCCP_CALL sccp_packet_pool_init(void);
+SCCP_API void SCCP_CALL sccp_packet_pool_destroy(void);
 
 SCCP_API void SCCP_CALL sccp_dev_check_displayprompt(constDevicePtr d);
 SCCP_API void SCCP_CALL sccp_device_setLastNumberDialed(devicePtr device, const char *lastNumberDialed, const sccp_linedevices_t *linedevice);
@@ -11,6 +11,7 @@
 #include "common.h"
 #include "sccp_device.h"
 #include "sccp_devstate.h"
+#include "sccp_session.h"
 #include "sccp_utils.h"
 
 SCCP_FILE_VERSION(__FILE__, "");
@@ -18,6 +19,7 @@ SCCP_FILE_VERSION(__FILE__, "");
 #if defined(CS_AST_HAS_EVENT) && defined(HAVE_PBX_EVENT_H)							// ast_event_subscribe
 #  include <asterisk/event.h>
 #endif
+#include <asterisk/cli.h>
 
 #if CS_DEVSTATE_FEATURE
 typedef struct sccp_devstate_SubscribingDevice sccp_devstate_SubscribingDevice_t;
@@ -39,9 +41,13 @@ struct sccp_devstate_deviceState
 	char devicestate[StationMaxNameSize];
 	PBX_EVENT_SUBSCRIPTION *sub;
 	uint32_t featureState;
+	uint32_t notifications;											/*!< Number of state changes sent to the subscribers */
+	uint32_t lastNotify;											/*!< Time the last notification took (usec) */
+	uint32_t maxNotify;											/*!< Longest notification (usec) */
 };
 
 static SCCP_LIST_HEAD (, struct sccp_devstate_deviceState) deviceStates;
+static sccp_hashtable_t *deviceStateIndex = NULL;							/* devicestate name -> deviceState, protected by deviceStates lock */
 
 void sccp_devstate_deviceRegisterListener(const sccp_event_t * event);
 sccp_devstate_deviceState_t *sccp_devstate_createDeviceStateHandler(const char *devstate);
@@ -61,6 +67,7 @@ void sccp_devstate_module_start(void)
 {
 	sccp_log((DEBUGCAT_CORE)) (VERBOSE_PREFIX_2 "SCCP: Starting devstate system\n");
 	SCCP_LIST_HEAD_INIT(&deviceStates);
+	deviceStateIndex = sccp_hashtable_create("devstates", SCCP_HASH_PRIME, SCCP_HASHTABLE_KEY_STRCASE);
 	sccp_event_subscribe(SCCP_EVENT_DEVICE_REGISTERED | SCCP_EVENT_DEVICE_UNREGISTERED, sccp_devstate_deviceRegisterListener, TRUE);
 }
 
@@ -73,6 +80,7 @@ void sccp_devstate_module_stop(void)
 
 		SCCP_LIST_LOCK(&deviceStates);
 		while ((deviceState = SCCP_LIST_REMOVE_HEAD(&deviceStates, list))) {
+			sccp_hashtable_remove(deviceStateIndex, deviceState->devicestate, deviceState);
 			pbx_event_unsubscribe(deviceState->sub);
 
 			SCCP_LIST_LOCK(&deviceState->subscribers);
@@ -88,6 +96,7 @@ void sccp_devstate_module_stop(void)
 
 	sccp_event_unsubscribe(SCCP_EVENT_DEVICE_REGISTERED | SCCP_EVENT_DEVICE_UNREGISTERED, sccp_devstate_deviceRegisterListener);
 	SCCP_LIST_HEAD_DESTROY(&deviceStates);
+	sccp_hashtable_destroy(&deviceStateIndex);
 }
 
 static void sccp_devstate_deviceRegistered(const sccp_device_t * device)
@@ -159,21 +168,20 @@ void sccp_devstate_deviceRegisterListener(const sccp_event_t * event)
 	}
 }
 
+/*!
+ * \brief Find the handler for devstate
+ * \note needs to be called with the deviceStates lock held
+ */
 sccp_devstate_deviceState_t *sccp_devstate_getDeviceStateHandler(const char *devstate)
 {
 	if (!devstate) {
 		return NULL;
 	}
 
-	sccp_devstate_deviceState_t *deviceState = NULL;
-
-	SCCP_LIST_TRAVERSE(&deviceStates, deviceState, list) {
-		if (!strncasecmp(devstate, deviceState->devicestate, sizeof(deviceState->devicestate))) {
-			break;
-		}
-	}
+	char name[StationMaxNameSize];
 
-	return deviceState;
+	sccp_copy_string(name, devstate, sizeof(name));							/* handlers are stored under their truncated name */
+	return sccp_hashtable_find(deviceStateIndex, name);
 }
 
 sccp_devstate_deviceState_t *sccp_devstate_createDeviceStateHandler(const char *devstate)
@@ -205,12 +213,14 @@ sccp_devstate_deviceState_t *sccp_devstate_createDeviceStateHandler(const char *
 	deviceState->featureState = (ast_device_state(buf) == AST_DEVICE_NOT_INUSE) ? 0 : 1;
 
 	SCCP_LIST_INSERT_HEAD(&deviceStates, deviceState, list);
+	sccp_hashtable_insert(deviceStateIndex, deviceState->devicestate, deviceState);
 	return deviceState;
 }
 
 void sccp_devstate_addSubscriber(sccp_devstate_deviceState_t * deviceState, const sccp_device_t * device, sccp_buttonconfig_t * buttonConfig)
 {
 	sccp_devstate_SubscribingDevice_t *subscriber;
+	sccp_devstate_SubscribingDevice_t *sibling = NULL;
 
 	subscriber = sccp_calloc(sizeof *subscriber, 1);
 	subscriber->device = sccp_device_retain((sccp_device_t *) device);
@@ -219,7 +229,18 @@ void sccp_devstate_addSubscriber(sccp_devstate_deviceState_t * deviceState, cons
 	subscriber->buttonConfig->button.feature.status = deviceState->featureState;
 	sccp_copy_string(subscriber->label, buttonConfig->label, sizeof(subscriber->label));
 
-	SCCP_LIST_INSERT_HEAD(&deviceState->subscribers, subscriber, list);
+	SCCP_LIST_LOCK(&deviceState->subscribers);
+	SCCP_LIST_TRAVERSE(&deviceState->subscribers, sibling, list) {					/* keep the subscribers of one device together */
+		if (sibling->device == subscriber->device) {
+			break;
+		}
+	}
+	if (sibling) {
+		SCCP_LIST_INSERT_AFTER(&deviceState->subscribers, sibling, subscriber, list);
+	} else {
+		SCCP_LIST_INSERT_HEAD(&deviceState->subscribers, subscriber, list);
+	}
+	SCCP_LIST_UNLOCK(&deviceState->subscribers);
 	sccp_devstate_notifySubscriber(deviceState, subscriber);						/* set initial state */
 }
 
@@ -227,6 +248,7 @@ void sccp_devstate_removeSubscriber(sccp_devstate_deviceState_t * deviceState, c
 {
 	sccp_devstate_SubscribingDevice_t *subscriber = NULL;
 
+	SCCP_LIST_LOCK(&deviceState->subscribers);
 	SCCP_LIST_TRAVERSE_SAFE_BEGIN(&deviceState->subscribers, subscriber, list) {
 		if (subscriber->device == device) {
 			SCCP_LIST_REMOVE_CURRENT(list);
@@ -235,6 +257,7 @@ void sccp_devstate_removeSubscriber(sccp_devstate_deviceState_t * deviceState, c
 
 	}
 	SCCP_LIST_TRAVERSE_SAFE_END;
+	SCCP_LIST_UNLOCK(&deviceState->subscribers);
 }
 
 void sccp_devstate_notifySubscriber(sccp_devstate_deviceState_t * deviceState, const sccp_devstate_SubscribingDevice_t * subscriber)
@@ -268,7 +291,9 @@ void sccp_devstate_changed_cb(const struct ast_event *ast_event, void *data)
 {
 	sccp_devstate_deviceState_t *deviceState = NULL;
 	sccp_devstate_SubscribingDevice_t *subscriber = NULL;
+	const sccp_device_t *corked = NULL;
 	enum ast_device_state state;
+	struct timeval start;
 
 #if ASTERISK_VERSION_GROUP >= 112
 	struct ast_device_state_message *dev_state = stasis_message_data(msg);
@@ -287,11 +312,86 @@ void sccp_devstate_changed_cb(const struct ast_event *ast_event, void *data)
 	deviceState->featureState = (state == AST_DEVICE_NOT_INUSE) ? 0 : 1;
 
 	sccp_log((DEBUGCAT_CORE)) (VERBOSE_PREFIX_3 "%s: (sccp_devstate_changed_cb) got new device state for %s, state: %d, deviceState->subscribers.count %d\n", "SCCP", deviceState->devicestate, state, deviceState->subscribers.size);
-	SCCP_LIST_TRAVERSE(&deviceState->subscribers, subscriber, list) {
+	start = pbx_tvnow();
+
+	SCCP_LIST_LOCK(&deviceState->subscribers);
+	SCCP_LIST_TRAVERSE(&deviceState->subscribers, subscriber, list) {					/* subscribers are grouped by device, cork each device once */
 		sccp_log((DEBUGCAT_CORE)) (VERBOSE_PREFIX_3 "%s: (sccp_devstate_changed_cb) notify subscriber for state %d\n", DEV_ID_LOG(subscriber->device), deviceState->featureState);
 		subscriber->buttonConfig->button.feature.status = deviceState->featureState;
+		if (subscriber->device != corked) {
+			if (corked) {
+				sccp_session_uncorkDevice(corked);
+			}
+			corked = subscriber->device;
+			sccp_session_corkDevice(corked);
+		}
 		sccp_devstate_notifySubscriber(deviceState, subscriber);
 	}
+	if (corked) {
+		sccp_session_uncorkDevice(corked);
+	}
+	SCCP_LIST_UNLOCK(&deviceState->subscribers);
+
+	deviceState->notifications++;
+	deviceState->lastNotify = (uint32_t) ast_tvdiff_us(pbx_tvnow(), start);
+	if (deviceState->lastNotify > deviceState->maxNotify) {
+		deviceState->maxNotify = deviceState->lastNotify;
+	}
+}
+
+/*!
+ * \brief Show Device State Handlers
+ * \param fd Fd as int
+ * \param totals Total number of lines as int
+ * \param s AMI Session
+ * \param m Message
+ * \param argc Argc as int
+ * \param argv[] Argv[] as char
+ * \return Result as int
+ *
+ * \called_from_asterisk
+ */
+int sccp_devstate_showDeviceStates(int fd, sccp_cli_totals_t *totals, struct mansession *s, const struct message *m, int argc, char *argv[])
+{
+	int local_line_total = 0;
+	int once = 0;
+
+	SCCP_LIST_LOCK(&deviceStates);
+#define CLI_AMI_TABLE_NAME DevstateHandlers
+#define CLI_AMI_TABLE_PER_ENTRY_NAME Handlers
+#define CLI_AMI_TABLE_ITERATOR for(once = 0; once < 1; once++)
+#define CLI_AMI_TABLE_FIELDS 												\
+	CLI_AMI_TABLE_FIELD(Handlers,		"-8",		d,	8,	SCCP_LIST_GETSIZE(&deviceStates))
+#include "sccp_cli_table.h"
+	SCCP_LIST_UNLOCK(&deviceStates);
+	local_line_total++;
+
+#define CLI_AMI_TABLE_NAME DeviceStates
+#define CLI_AMI_TABLE_PER_ENTRY_NAME DeviceState
+#define CLI_AMI_TABLE_LIST_ITER_HEAD &deviceStates
+#define CLI_AMI_TABLE_LIST_ITER_TYPE sccp_devstate_deviceState_t
+#define CLI_AMI_TABLE_LIST_ITER_VAR deviceState
+#define CLI_AMI_TABLE_LIST_LOCK SCCP_LIST_LOCK
+#define CLI_AMI_TABLE_LIST_ITERATOR SCCP_LIST_TRAVERSE
+#define CLI_AMI_TABLE_LIST_UNLOCK SCCP_LIST_UNLOCK
+#define CLI_AMI_TABLE_FIELDS 												\
+	CLI_AMI_TABLE_FIELD(Name,		"-25.25",	s,	25,	deviceState->devicestate)			\
+	CLI_AMI_TABLE_FIELD(State,		"-5",		d,	5,	deviceState->featureState)			\
+	CLI_AMI_TABLE_FIELD(Subscribers,	"-11",		d,	11,	SCCP_LIST_GETSIZE(&deviceState->subscribers))	\
+	CLI_AMI_TABLE_FIELD(Notified,		"-10",		u,	10,	deviceState->notifications)			\
+	CLI_AMI_TABLE_FIELD(LastNotify,		"-10",		u,	10,	deviceState->lastNotify)			\
+	CLI_AMI_TABLE_FIELD(MaxNotify,		"-10",		u,	10,	deviceState->maxNotify)
+#include "sccp_cli_table.h"
+	local_line_total++;
+
+	if (!s) {
+		pbx_cli(fd, "(notify times in usec)\n");
+	}
+	if (s) {
+		totals->lines = local_line_total;
+		totals->tables = 2;
+	}
+	return RESULT_SUCCESS;
 }
 #endif
 // kate: indent-width 8; replace-tabs off; indent-mode cstyle; auto-insert-doxygen on; line-numbers on; tab-indents on; keep-extra-spaces off; auto-brackets off;
@@ -25,6 +25,7 @@ SCCP_FILE_VERSION(__FILE__, "");
 
 void sccp_event_destroy(sccp_event_t * event);
 #define SCCP_EVENT_EXPECTED_SUBSCRIPTIONS 9			/* grep sccp_event_subscribe *.c */
+#define SCCP_EVENT_ENVELOPE_POOL 64				/* number of async event envelopes kept around for reuse */
 
 #if CS_TEST_FRAMEWORK
 #include <asterisk/test.h>
@@ -35,11 +36,11 @@ void sccp_event_destroy(sccp_event_t * event);
 /* type declarations */
 typedef struct sccp_event_subscriber sccp_event_subscriber_t;
 typedef struct sccp_event_subscriptions sccp_event_subscriptions_t;
+typedef struct sccp_event_snapshot sccp_event_snapshot_t;
 typedef SCCP_VECTOR_RW(, sccp_event_subscriber_t) sccp_event_vector_t;
 
 /* vector compare functions */
 #define SUBSCRIBER_CB_CMP(elem, value) ((elem).callback_function == (value))
-#define SUBSCRIBER_EXEC_CMP(elem, value) ((elem).execution == (value))
 
 /*!
  * \brief Execution Mode Enum
@@ -58,6 +59,18 @@ struct sccp_event_subscriber {
 	sccp_event_callback_t callback_function;
 };
 
+/*!
+ * \brief SCCP Event Subscriber Snapshot Structure
+ * \note immutable copy of the subscribers of one event type, sync subscribers first followed by the async ones.
+ * A new snapshot is built on every (un)subscribe and swapped in, firing an event only takes a reference on the current one.
+ */
+struct sccp_event_snapshot {
+	volatile int refcount;							/* current snapshot holds one reference, every event being processed another */
+	uint32_t num_sync;
+	uint32_t num_async;
+	sccp_event_subscriber_t subscribers[0];
+};
+
 /*!
  * \brief SCCP Event Subscriptions Structure
  */
@@ -66,8 +79,25 @@ static struct sccp_event_subscriptions {
 							// same as: SCCP_VECTOR_RW(sccp_event_vector, sccp_event_subscriber_t) subscribers;
 							// typedef struct sccp_event_vector sccp_event_vector_t;
 							// but using predeclared type instead
+	sccp_event_snapshot_t *snapshot;					/* protected by the subscribers rwlock */
 } event_subscriptions[NUMBER_OF_EVENT_TYPES] = {{{0}}};
 
+/*!
+ * async thread arguments (envelope)
+ */
+typedef struct __aSyncEventProcessorThreadArg AsyncArgs_t;
+struct __aSyncEventProcessorThreadArg
+{
+	uint8_t idx;
+	sccp_event_t event;
+	sccp_event_snapshot_t *snapshot;
+	SCCP_LIST_ENTRY (AsyncArgs_t) list;
+};
+static SCCP_LIST_HEAD (, AsyncArgs_t) event_envelopes;				/* pool of unused envelopes */
+static uint32_t event_envelopes_inuse = 0;					/* envelopes handed out, protected by the event_envelopes lock */
+static pbx_cond_t event_envelopes_drained;					/* signalled when the last envelope in use comes back */
+static sccp_mutex_t event_snapshot_lock;					/* only used by ATOMIC_INCR/DECR when there is no native atomic support */
+
 /*
  * \brief release held references when we are finished processing this event
  */
@@ -124,17 +154,74 @@ void sccp_event_destroy(sccp_event_t * event)
 
 static volatile boolean_t sccp_event_running = FALSE;
 
+/*!
+ * \brief drop a reference on a subscriber snapshot, freeing it when the last user is done
+ */
+static void __sccp_event_snapshot_release(sccp_event_snapshot_t * snapshot)
+{
+	if (snapshot && ATOMIC_DECR(&snapshot->refcount, 1, &event_snapshot_lock) == 1) {
+		sccp_free(snapshot);
+	}
+}
+
+/*!
+ * \brief build a new snapshot from the subscribers vector and swap it in
+ * \note called with the subscribers vector write-locked, returns the previous snapshot which should be released after unlocking
+ */
+static sccp_event_snapshot_t *__sccp_event_snapshot_rebuild(struct sccp_event_subscriptions *subscriptions)
+{
+	sccp_event_vector_t *subscribers = &subscriptions->subscribers;
+	sccp_event_snapshot_t *snapshot = NULL;
+	sccp_event_snapshot_t *old = subscriptions->snapshot;
+	size_t size = SCCP_VECTOR_SIZE(subscribers);
+	uint32_t n = 0, pos = 0;
+
+	if (size && (snapshot = sccp_calloc(1, sizeof(sccp_event_snapshot_t) + size * sizeof(sccp_event_subscriber_t)))) {
+		snapshot->refcount = 1;
+		for (n = 0; n < size; n++) {
+			if (SCCP_VECTOR_GET(subscribers, n).execution == SCCP_EVENT_SYNC) {
+				snapshot->subscribers[pos++] = SCCP_VECTOR_GET(subscribers, n);
+			}
+		}
+		snapshot->num_sync = pos;
+		for (n = 0; n < size; n++) {
+			if (SCCP_VECTOR_GET(subscribers, n).execution == SCCP_EVENT_ASYNC) {
+				snapshot->subscribers[pos++] = SCCP_VECTOR_GET(subscribers, n);
+			}
+		}
+		snapshot->num_async = pos - snapshot->num_sync;
+	} else if (size) {
+		pbx_log(LOG_ERROR, SS_Memory_Allocation_Error, "SCCP");
+		return NULL;										/* keep the old snapshot */
+	}
+	subscriptions->snapshot = snapshot;
+	return old;
+}
+
 //static void __attribute__((constructor)) sccp_event_module_init(void)
 void sccp_event_module_start(void)
 {
 	uint _idx = 0;
 	if (!sccp_event_running) {
 		sccp_log((DEBUGCAT_CORE)) (VERBOSE_PREFIX_2 "Starting event system\n");
+		sccp_mutex_init(&event_snapshot_lock);
+		SCCP_LIST_HEAD_INIT(&event_envelopes);
+		pbx_cond_init(&event_envelopes_drained, NULL);
+		event_envelopes_inuse = 0;
 		for (_idx = 0; _idx < NUMBER_OF_EVENT_TYPES; _idx++) {
 			if (SCCP_VECTOR_RW_INIT(&event_subscriptions[_idx].subscribers, SCCP_EVENT_EXPECTED_SUBSCRIPTIONS) != 0) {
 				pbx_log(LOG_ERROR, SS_Memory_Allocation_Error, "SCCP");
 				return;
 			}
+			event_subscriptions[_idx].snapshot = NULL;
+		}
+		/* prefill the envelope pool, so that firing async events does not need to allocate */
+		for (_idx = 0; _idx < SCCP_EVENT_ENVELOPE_POOL; _idx++) {
+			AsyncArgs_t *arg = sccp_calloc(1, sizeof *arg);
+			if (!arg) {
+				break;
+			}
+			SCCP_LIST_INSERT_HEAD(&event_envelopes, arg, list);
 		}
 		sccp_event_running = TRUE;
 	}
@@ -146,10 +233,33 @@ void sccp_event_module_stop(void)
 	uint _idx = 0;
 	if (sccp_event_running) {
 		sccp_log((DEBUGCAT_CORE)) (VERBOSE_PREFIX_2 "Stopping event system\n");
+		AsyncArgs_t *arg = NULL;
+
+		/* drain the lanes: wait for the async events still queued or running to hand their envelope back */
+		SCCP_LIST_LOCK(&event_envelopes);
 		sccp_event_running = FALSE;
+		while (event_envelopes_inuse) {
+			pbx_cond_wait(&event_envelopes_drained, &event_envelopes.lock);
+		}
+		SCCP_LIST_UNLOCK(&event_envelopes);
+
 		for (_idx = 0; _idx < NUMBER_OF_EVENT_TYPES; _idx++) {
+			sccp_event_snapshot_t *snapshot = NULL;
+			SCCP_VECTOR_RW_WRLOCK(&event_subscriptions[_idx].subscribers);
+			snapshot = event_subscriptions[_idx].snapshot;
+			event_subscriptions[_idx].snapshot = NULL;
+			SCCP_VECTOR_RW_UNLOCK(&event_subscriptions[_idx].subscribers);
+			__sccp_event_snapshot_release(snapshot);
 			SCCP_VECTOR_RW_FREE(&event_subscriptions[_idx].subscribers);
 		}
+		SCCP_LIST_LOCK(&event_envelopes);
+		while ((arg = SCCP_LIST_REMOVE_HEAD(&event_envelopes, list))) {
+			sccp_free(arg);
+		}
+		SCCP_LIST_UNLOCK(&event_envelopes);
+		SCCP_LIST_HEAD_DESTROY(&event_envelopes);
+		pbx_cond_destroy(&event_envelopes_drained);
+		sccp_mutex_destroy(&event_snapshot_lock);
 	}
 }
 
@@ -174,13 +284,16 @@ boolean_t sccp_event_subscribe(sccp_event_type_t eventType, sccp_event_callback_
 			};
 			
 			sccp_event_vector_t *subscribers = &(event_subscriptions[_idx].subscribers);
+			sccp_event_snapshot_t *old = NULL;
 			SCCP_VECTOR_RW_WRLOCK(subscribers);
 			if (SCCP_VECTOR_APPEND(subscribers, subscriber) == 0) {
+				old = __sccp_event_snapshot_rebuild(&event_subscriptions[_idx]);
 				res = TRUE;
 			} else {
 				pbx_log(LOG_ERROR, SS_Memory_Allocation_Error, "SCCP");
 			}
 			SCCP_VECTOR_RW_UNLOCK(subscribers);
+			__sccp_event_snapshot_release(old);
 		}
 	}
 	return res;
@@ -201,13 +314,16 @@ boolean_t sccp_event_unsubscribe(sccp_event_type_t eventType, sccp_event_callbac
 		if (eventType & _mask) {
 			sccp_event_vector_t *subscribers = &(event_subscriptions[_idx].subscribers);
 			{
+				sccp_event_snapshot_t *old = NULL;
 				SCCP_VECTOR_RW_WRLOCK(subscribers);
 				if (SCCP_VECTOR_REMOVE_CMP_UNORDERED(subscribers, cb, SUBSCRIBER_CB_CMP, SCCP_VECTOR_ELEM_CLEANUP_NOOP) == 0) {
+					old = __sccp_event_snapshot_rebuild(&event_subscriptions[_idx]);
 					res = TRUE;
 				} else {
 					pbx_log(LOG_ERROR, "SCCP: (sccp_event_subscribe) Failed to remove subscriber from subscribers vector\n");
 				}
 				SCCP_VECTOR_RW_UNLOCK(subscribers);
+				__sccp_event_snapshot_release(old);
 			}
 		}
 	}
@@ -217,22 +333,18 @@ boolean_t sccp_event_unsubscribe(sccp_event_type_t eventType, sccp_event_callbac
 /* helpers */
 /*!
  * \brief execute the callback off each subscriber in the subscribers array, for a particular event
- * \note should be handed an copied non-lockedable vector
+ * \note should be handed an immutable snapshot
  */
-static gcc_inline boolean_t __execute_callback_helper(const sccp_event_t *event, sccp_event_vector_t *subs_vector) 
+static gcc_inline boolean_t __execute_callback_helper(const sccp_event_t *event, const sccp_event_subscriber_t *subscribers, uint32_t count) 
 {
 	boolean_t res = FALSE;
-	if (subs_vector) {
-		uint32_t n = 0;
-		for (n = 0; n < SCCP_VECTOR_SIZE(subs_vector) && sccp_event_running; n++) {
-			sccp_event_subscriber_t subscriber = SCCP_VECTOR_GET(subs_vector, n);
-			if (subscriber.callback_function != NULL) {
-				//sccp_log((DEBUGCAT_EVENT)) (VERBOSE_PREFIX_3 "Processing Event %p of Type %s via %d callback:%p\n", event, sccp_event_type2str(event->type), n, subscriber.callback_function);
-				subscriber.callback_function(event);
-				res = TRUE;
-			}
+	uint32_t n = 0;
+	for (n = 0; n < count && sccp_event_running; n++) {
+		if (subscribers[n].callback_function != NULL) {
+			//sccp_log((DEBUGCAT_EVENT)) (VERBOSE_PREFIX_3 "Processing Event %p of Type %s via %d callback:%p\n", event, sccp_event_type2str(event->type), n, subscribers[n].callback_function);
+			subscribers[n].callback_function(event);
+			res = TRUE;
 		}
-		SCCP_VECTOR_PTR_FREE(subs_vector);
 	}
 	return res;
 }
@@ -254,14 +366,94 @@ static gcc_inline uint8_t __search_for_position_in_event_array(sccp_event_type_t
 /* end helpers */
 
 /*!
- * async thread arguments
+ * \brief calculate the event lane (threadpool affinity key) for an event
+ * \note events concerning the same device (registration, feature changes, line attach/detach, line status changes carrying a device)
+ * get the same key and are therefor processed one at a time and in order, whatever their type. Line creation and line status changes
+ * without a device are keyed by line. Events with different keys still run in parallel.
+ * \return key, 0 when the event does not need ordering
  */
-typedef struct __aSyncEventProcessorThreadArg
+static uint32_t __sccp_event_lane_key(const sccp_event_t * event)
 {
-	uint8_t idx;
-	sccp_event_t event;
-	sccp_event_vector_t *async_subscribers;
-} AsyncArgs_t;
+	const char *name = NULL;
+	uint32_t key = 2166136261U;
+
+	switch (event->type) {
+		case SCCP_EVENT_DEVICE_REGISTERED:
+		case SCCP_EVENT_DEVICE_UNREGISTERED:
+		case SCCP_EVENT_DEVICE_PREREGISTERED:
+			name = event->event.deviceRegistered.device ? event->event.deviceRegistered.device->id : NULL;
+			break;
+		case SCCP_EVENT_FEATURE_CHANGED:
+			name = event->event.featureChanged.device ? event->event.featureChanged.device->id : NULL;
+			break;
+		case SCCP_EVENT_LINE_CREATED:
+			name = event->event.lineCreated.line ? event->event.lineCreated.line->name : NULL;
+			break;
+		case SCCP_EVENT_DEVICE_ATTACHED:
+		case SCCP_EVENT_DEVICE_DETACHED:
+			name = (event->event.deviceAttached.linedevice && event->event.deviceAttached.linedevice->device) ? event->event.deviceAttached.linedevice->device->id : NULL;
+			break;
+		case SCCP_EVENT_LINESTATUS_CHANGED:
+			if (event->event.lineStatusChanged.optional_device) {
+				name = event->event.lineStatusChanged.optional_device->id;
+			} else {
+				name = event->event.lineStatusChanged.line ? event->event.lineStatusChanged.line->name : NULL;
+			}
+			break;
+		default:
+			break;
+	}
+	if (!name) {
+		return 0;
+	}
+	while (*name) {												/* FNV-1a */
+		key ^= (unsigned char) tolower(*name++);
+		key *= 16777619U;
+	}
+	return key ? key : 1;
+}
+
+/*!
+ * \brief take an envelope from the pool (only allocates when the pool has run dry)
+ * \return NULL when the event system is stopping
+ */
+static AsyncArgs_t *__sccp_event_envelope_get(void)
+{
+	AsyncArgs_t *arg = NULL;
+	SCCP_LIST_LOCK(&event_envelopes);
+	if (!sccp_event_running) {
+		SCCP_LIST_UNLOCK(&event_envelopes);
+		return NULL;
+	}
+	if (!(arg = SCCP_LIST_REMOVE_HEAD(&event_envelopes, list))) {
+		arg = sccp_malloc(sizeof *arg);
+	}
+	if (arg) {
+		event_envelopes_inuse++;
+	}
+	SCCP_LIST_UNLOCK(&event_envelopes);
+	return arg;
+}
+
+/*!
+ * \brief return an envelope to the pool
+ */
+static void __sccp_event_envelope_put(AsyncArgs_t * arg)
+{
+	SCCP_LIST_LOCK(&event_envelopes);
+	if (sccp_event_running && SCCP_LIST_GETSIZE(&event_envelopes) < SCCP_EVENT_ENVELOPE_POOL) {
+		SCCP_LIST_INSERT_HEAD(&event_envelopes, arg, list);
+		arg = NULL;
+	}
+	if (--event_envelopes_inuse == 0) {
+		pbx_cond_signal(&event_envelopes_drained);
+	}
+	SCCP_LIST_UNLOCK(&event_envelopes);
+	if (arg) {
+		sccp_free(arg);
+	}
+}
+
 /*!
  * async thread run within threadpool
  */
@@ -269,10 +461,12 @@ static void *sccp_event_processor(void *data)
 {
 	AsyncArgs_t *arg = data;
 	if (arg) {
+		sccp_event_snapshot_t *snapshot = arg->snapshot;
 		//sccp_log((DEBUGCAT_EVENT)) (VERBOSE_PREFIX_3 "Async Processing Event Callbacks Type %s\n", sccp_event_type2str(arg->event.type));
-		__execute_callback_helper(&arg->event, arg->async_subscribers);
+		__execute_callback_helper(&arg->event, &snapshot->subscribers[snapshot->num_sync], snapshot->num_async);
 		sccp_event_destroy(&arg->event);
-		sccp_free(arg);
+		__sccp_event_snapshot_release(snapshot);
+		__sccp_event_envelope_put(arg);
 	}
 	return NULL;
 }
@@ -281,6 +475,8 @@ static void *sccp_event_processor(void *data)
  * \brief Fire an Event
  * \param event SCCP Event
  * \note event will be freed after event is fired
+ * \note does not allocate: a reference on the current subscriber snapshot is taken and async events travel in a pooled envelope
+ * \note async events for the same device/line are queued on the same lane (see __sccp_event_lane_key), so they are handled in order
  * 
  * \warning
  *      - sccp_event_listeners->subscriber is not always locked
@@ -289,60 +485,46 @@ boolean_t sccp_event_fire(sccp_event_t * event)
 {
 	boolean_t res = FALSE;
 	if (event) {
-		sccp_event_vector_t *sync_subscribers_cpy = NULL, *async_subscribers_cpy = NULL;
-		size_t subsize = 0, syncsize = 0, asyncsize = 0;
+		sccp_event_snapshot_t *snapshot = NULL;
 		uint8_t _idx = __search_for_position_in_event_array(event->type);
 		
-		/* copy both vectors to a local copy while holding the rwlock */
-		sccp_event_vector_t *subscribers = &event_subscriptions[_idx].subscribers;
-		SCCP_VECTOR_RW_RDLOCK(subscribers);
-		if ((subsize = SCCP_VECTOR_SIZE(subscribers))) {
-			sync_subscribers_cpy = SCCP_VECTOR_CALLBACK_MULTIPLE(subscribers, SUBSCRIBER_EXEC_CMP, SCCP_EVENT_SYNC);
-			async_subscribers_cpy = SCCP_VECTOR_CALLBACK_MULTIPLE(subscribers, SUBSCRIBER_EXEC_CMP, SCCP_EVENT_ASYNC);
-			syncsize = sync_subscribers_cpy ? SCCP_VECTOR_SIZE(sync_subscribers_cpy) : 0;
-			asyncsize = async_subscribers_cpy ? SCCP_VECTOR_SIZE(async_subscribers_cpy) : 0;
+		/* take a reference on the current snapshot while holding the rwlock */
+		if (_idx < NUMBER_OF_EVENT_TYPES) {
+			sccp_event_vector_t *subscribers = &event_subscriptions[_idx].subscribers;
+			SCCP_VECTOR_RW_RDLOCK(subscribers);
+			if ((snapshot = event_subscriptions[_idx].snapshot)) {
+				(void) ATOMIC_INCR(&snapshot->refcount, 1, &event_snapshot_lock);
+			}
+			SCCP_VECTOR_RW_UNLOCK(subscribers);
 		}
-		SCCP_VECTOR_RW_UNLOCK(subscribers);
 
-		// handle synchronous events first (if any)
-		if (sync_subscribers_cpy) {
-			if (syncsize) {
-				res |= __execute_callback_helper(event, sync_subscribers_cpy);
-			} else {
-				SCCP_VECTOR_PTR_FREE(sync_subscribers_cpy);
+		if (snapshot) {
+			// handle synchronous events first (if any)
+			if (snapshot->num_sync) {
+				res |= __execute_callback_helper(event, snapshot->subscribers, snapshot->num_sync);
 			}
-		}
 
-		// handle the others asynchonously via threadpool (if any)
-		do {
-			if (async_subscribers_cpy) {
-				if (asyncsize) {
-					AsyncArgs_t *arg = NULL;
-					if (GLOB(general_threadpool) && sccp_event_running && (arg = sccp_malloc(sizeof *arg))) {
-						arg->idx = _idx;
-						memcpy(&arg->event, event, sizeof(sccp_event_t));
-						arg->async_subscribers = async_subscribers_cpy;
-						if (sccp_threadpool_add_work(GLOB(general_threadpool), (void *) sccp_event_processor, (void *) arg)) {
-							//sccp_log((DEBUGCAT_EVENT)) (VERBOSE_PREFIX_3 "Work added to threadpool for event: %p, type: %s\n", event, sccp_event_type2str(event->type));
-							event = NULL;					// set to NULL, thread will clean event up later.
-							res |= true;
-							break;						// break out of do/while loop, no further processing needed
-						} else {
-							pbx_log(LOG_ERROR, "Could not add work to threadpool for event: %s\n", sccp_event_type2str(event->type));
-							sccp_free(arg);					// explicit failure release
-						}
+			// handle the others asynchonously via threadpool (if any)
+			if (snapshot->num_async) {
+				AsyncArgs_t *arg = NULL;
+				if (GLOB(general_threadpool) && sccp_event_running && (arg = __sccp_event_envelope_get())) {
+					arg->idx = _idx;
+					memcpy(&arg->event, event, sizeof(sccp_event_t));
+					arg->snapshot = snapshot;
+					if (sccp_threadpool_add_work_keyed(GLOB(general_threadpool), __sccp_event_lane_key(event), (void *) sccp_event_processor, (void *) arg)) {
+						//sccp_log((DEBUGCAT_EVENT)) (VERBOSE_PREFIX_3 "Work added to threadpool for event: %p, type: %s\n", event, sccp_event_type2str(event->type));
+						return TRUE;							// thread will clean up event and snapshot reference later.
 					}
-					res |= __execute_callback_helper(event, async_subscribers_cpy);	// fallback to handling synchronously in case something prevented async
-				} else {
-					SCCP_VECTOR_PTR_FREE(async_subscribers_cpy);
+					pbx_log(LOG_ERROR, "Could not add work to threadpool for event: %s\n", sccp_event_type2str(event->type));
+					__sccp_event_envelope_put(arg);						// explicit failure release
 				}
+				res |= __execute_callback_helper(event, &snapshot->subscribers[snapshot->num_sync], snapshot->num_async);	// fallback to handling synchronously in case something prevented async
 			}
-		} while (0);
+			__sccp_event_snapshot_release(snapshot);
+		}
 
 		/* cleanup */
-		if (event) {
-			sccp_event_destroy(event);
-		}
+		sccp_event_destroy(event);
 	}
 	return res;
 }
@@ -502,11 +684,84 @@ cleanup:
 	return rc;
 }
 
+AST_TEST_DEFINE(sccp_event_test_lane_order)
+{
+	int rc = AST_TEST_PASS;
+	switch(cmd) {
+		case TEST_INIT:
+			info->name = "lane_order";
+			info->category = "/channels/chan_sccp/event/";
+			info->summary = "chan-sccp-b event lanes keep the events of one device in order";
+			info->description = "chan-sccp-b events of different types concerning the same device have to be queued on the same lane";
+			return AST_TEST_NOT_RUN;
+		case TEST_EXECUTE:
+			break;
+	}
+	sccp_device_t *device = sccp_calloc(1, sizeof(sccp_device_t));
+	sccp_line_t *line = sccp_calloc(1, sizeof(sccp_line_t));
+	sccp_linedevices_t *linedevice = sccp_calloc(1, sizeof(sccp_linedevices_t));
+	sccp_event_t event = {{{0}}};
+	uint32_t devicekey = 0;
+
+	pbx_test_validate_cleanup(test, device && line && linedevice, rc, cleanup);
+	sccp_copy_string(device->id, "SEP001122334455", sizeof(device->id));
+	sccp_copy_string(line->name, "98011", sizeof(line->name));
+	linedevice->device = device;
+	linedevice->line = line;
+
+	event.type = SCCP_EVENT_DEVICE_REGISTERED;
+	event.event.deviceRegistered.device = device;
+	devicekey = __sccp_event_lane_key(&event);
+	pbx_test_validate_cleanup(test, devicekey != 0, rc, cleanup);
+
+	pbx_test_status_update(test, "attach, linestatus, feature change, detach and unregister of one device share its lane\n");
+	event.type = SCCP_EVENT_DEVICE_ATTACHED;
+	event.event.deviceAttached.linedevice = linedevice;
+	pbx_test_validate_cleanup(test, __sccp_event_lane_key(&event) == devicekey, rc, cleanup);
+
+	event.type = SCCP_EVENT_LINESTATUS_CHANGED;
+	event.event.lineStatusChanged.line = line;
+	event.event.lineStatusChanged.optional_device = device;
+	pbx_test_validate_cleanup(test, __sccp_event_lane_key(&event) == devicekey, rc, cleanup);
+
+	event.type = SCCP_EVENT_FEATURE_CHANGED;
+	event.event.featureChanged.device = device;
+	event.event.featureChanged.optional_linedevice = linedevice;
+	pbx_test_validate_cleanup(test, __sccp_event_lane_key(&event) == devicekey, rc, cleanup);
+
+	event.type = SCCP_EVENT_DEVICE_DETACHED;
+	event.event.deviceAttached.linedevice = linedevice;
+	pbx_test_validate_cleanup(test, __sccp_event_lane_key(&event) == devicekey, rc, cleanup);
+
+	event.type = SCCP_EVENT_DEVICE_UNREGISTERED;
+	event.event.deviceRegistered.device = device;
+	pbx_test_validate_cleanup(test, __sccp_event_lane_key(&event) == devicekey, rc, cleanup);
+
+	pbx_test_status_update(test, "a linestatus change without device uses the lane of the line\n");
+	event.type = SCCP_EVENT_LINESTATUS_CHANGED;
+	event.event.lineStatusChanged.line = line;
+	event.event.lineStatusChanged.optional_device = NULL;
+	pbx_test_validate_cleanup(test, __sccp_event_lane_key(&event) != 0 && __sccp_event_lane_key(&event) != devicekey, rc, cleanup);
+
+cleanup:
+	if (linedevice) {
+		sccp_free(linedevice);
+	}
+	if (line) {
+		sccp_free(line);
+	}
+	if (device) {
+		sccp_free(device);
+	}
+	return rc;
+}
+
 static void __attribute__((constructor)) sccp_register_tests(void)
 {
 	AST_TEST_REGISTER(sccp_event_test_subscribe_single);
 	AST_TEST_REGISTER(sccp_event_test_subscribe_multi);
 	AST_TEST_REGISTER(sccp_event_test_subscribe_multi_sync);
+	AST_TEST_REGISTER(sccp_event_test_lane_order);
 }
 
 static void __attribute__((destructor)) sccp_unregister_tests(void)
@@ -514,6 +769,7 @@ static void __attribute__((destructor)) sccp_unregister_tests(void)
 	AST_TEST_UNREGISTER(sccp_event_test_subscribe_single);
 	AST_TEST_UNREGISTER(sccp_event_test_subscribe_multi);
 	AST_TEST_UNREGISTER(sccp_event_test_subscribe_multi_sync);
+	AST_TEST_UNREGISTER(sccp_event_test_lane_order);
 }
 #endif
 
@@ -37,6 +37,7 @@ struct sccp_global_vars {
 	int descriptor;												/*!< Server Socket Descriptor */
 	int keepalive;												/*!< KeepAlive */
 	int32_t debug;												/*!< Debug */
+	boolean_t debug_async;											/*!< Write Debug Messages from a background thread */
 	int module_running;
 	pbx_rwlock_t lock;											/*!< Asterisk: Lock Me Up and Tie me Down */
 
@@ -46,10 +47,21 @@ struct sccp_global_vars {
 #endif
 
 	sccp_threadpool_t *general_threadpool;									/*!< General Work Threadpool */
+	boolean_t session_eventloop;										/*!< Service Sessions using Event-Loop Workers instead of one Thread per Session */
+	uint8_t session_workers;										/*!< Number of Event-Loop Workers (0 = one per online cpu) */
+	uint16_t session_outqueue_high;										/*!< Session Output Queue Capacity (messages), high watermark at 3/4 */
+	uint16_t session_outqueue_low;										/*!< Session Output Queue Low Watermark (messages) */
+	uint16_t session_outqueue_timeout;									/*!< Seconds a Session Output Queue may stay congested before the session is closed */
+	uint16_t hint_coalesce_window;										/*!< Milliseconds during which hint updates are coalesced into one notification (0 = disabled) */
 
 	SCCP_RWLIST_HEAD (, sccp_session_t) sessions;								/*!< SCCP Sessions */
 	SCCP_RWLIST_HEAD (, sccp_device_t) devices;								/*!< SCCP Devices */
 	SCCP_RWLIST_HEAD (, sccp_line_t) lines;									/*!< SCCP Lines */
+	sccp_hashtable_t *session_index;									/*!< SCCP Sessions indexed by IP-Address */
+	sccp_hashtable_t *device_index;										/*!< SCCP Devices indexed by Device Id (case-insensitive) */
+	sccp_hashtable_t *line_index;										/*!< SCCP Lines indexed by Name (case-insensitive) */
+	sccp_hashtable_t *channel_index;									/*!< SCCP Channels indexed by CallId */
+	sccp_hashtable_t *passthrupartyid_index;								/*!< SCCP Channels indexed by PassThruPartyId */
 
 	sccp_mutex_t socket_lock;										/*!< Socket Lock */
 #ifndef SCCP_ATOMIC	
@@ -138,6 +150,7 @@ struct sccp_global_vars {
 #ifdef CS_SCCP_REALTIME
 	char *realtimedevicetable;										/*!< Database Table Name for SCCP Devices */
 	char *realtimelinetable;											/*!< Database Table Name for SCCP Lines */
+	uint16_t realtime_cache_ttl;										/*!< Seconds Realtime Lookups are Cached (0 = disabled) */
 #endif
 	char used_context[SCCP_MAX_EXTENSION];									/*!< placeholder to check if context are already used in regcontext (DUNDI) */
 
@@ -0,0 +1,419 @@
+/*!
+ * \file        sccp_hashtable.c
+ * \brief       SCCP Hashtable Class
+ * \note        This program is free software and may be modified and distributed under the terms of the GNU Public License.
+ *              See the LICENSE file at the top of the source tree.
+ * \note        Every bucket has it's own rwlock, so lookups on different buckets do not contend and lookups on the same
+ *              bucket only block each other during inserts/removes. Multiple values per key are allowed, find returns the
+ *              first one that was inserted.
+ */
+
+#include "config.h"
+#include "common.h"
+#include "sccp_hashtable.h"
+
+SCCP_FILE_VERSION(__FILE__, "");
+
+#include "sccp_netsock.h"
+#include "sccp_utils.h"
+
+/*!
+ * \brief Hashtable Entry
+ */
+struct sccp_hashtable_entry {
+	SCCP_LIST_ENTRY (struct sccp_hashtable_entry) list;							/*!< Linked List Entry for this Bucket */
+	void *value;												/*!< Indexed Value (not owned by the hashtable) */
+	uint32_t hash;												/*!< Full Hash of the key */
+	unsigned char key[0] __attribute__ ((aligned (8)));							/*!< Copy of the (normalized) key */
+};
+
+SCCP_RWLIST_HEAD (sccp_hashtable_bucket, struct sccp_hashtable_entry);						/*!< Hashtable Bucket */
+
+/*!
+ * \brief Hashtable
+ */
+struct sccp_hashtable {
+	char name[32];												/*!< Name (used in log messages) */
+	sccp_hashtable_keytype_t keytype;									/*!< Type of the key */
+	uint32_t num_buckets;											/*!< Number of Buckets */
+	struct sccp_hashtable_bucket buckets[0];								/*!< Buckets */
+};
+
+/* ------------------------------------------------------------------------------------------------------------ KEYS - */
+/*!
+ * \brief Normalize a socket address, so that ipv4 and ipv4-mapped-ipv6 addresses compare/hash the same way
+ */
+static gcc_inline void __sccp_hashtable_normalize_addr(const struct sockaddr_storage *in, struct sockaddr_storage *out)
+{
+	if (!sccp_netsock_ipv4_mapped(in, out)) {
+		memcpy(out, in, sizeof(struct sockaddr_storage));
+	}
+}
+
+static gcc_inline uint32_t __sccp_hashtable_hash_bytes(uint32_t hash, const unsigned char *bytes, size_t len)
+{
+	size_t pos = 0;
+	for (pos = 0; pos < len; pos++) {									/* FNV-1a */
+		hash ^= bytes[pos];
+		hash *= 16777619U;
+	}
+	return hash;
+}
+
+static gcc_inline uint32_t __sccp_hashtable_hash_addr(const struct sockaddr_storage *addr)
+{
+	if (addr->ss_family == AF_INET6) {
+		return __sccp_hashtable_hash_bytes(2166136261U, (const unsigned char *) &((const struct sockaddr_in6 *) addr)->sin6_addr, sizeof(struct in6_addr));
+	}
+	return __sccp_hashtable_hash_bytes(2166136261U, (const unsigned char *) &((const struct sockaddr_in *) addr)->sin_addr, sizeof(struct in_addr));
+}
+
+static gcc_inline uint32_t __sccp_hashtable_hash_uint32(uint32_t value)
+{
+	return value * 2654435761U;										/* knuth multiplicative hash, spreads sequential id's */
+}
+
+static gcc_inline uint32_t __sccp_hashtable_hash_string(const char *str)
+{
+	return __sccp_hashtable_hash_bytes(2166136261U, (const unsigned char *) str, strlen(str));
+}
+
+static gcc_inline uint32_t __sccp_hashtable_hash_strcase(const char *str)
+{
+	uint32_t hash = 2166136261U;
+	while (*str) {
+		hash ^= (unsigned char) tolower(*str++);
+		hash *= 16777619U;
+	}
+	return hash;
+}
+
+/*!
+ * \brief Calculate the hash for key, socket addresses are normalized into addr
+ * \return size of the normalized key
+ */
+static size_t __sccp_hashtable_prepare_key(const sccp_hashtable_t * table, const void *key, uint32_t * hash, struct sockaddr_storage *addr)
+{
+	switch (table->keytype) {
+		case SCCP_HASHTABLE_KEY_SOCKADDR:
+			__sccp_hashtable_normalize_addr((const struct sockaddr_storage *) key, addr);
+			*hash = __sccp_hashtable_hash_addr(addr);
+			return sizeof(struct sockaddr_storage);
+		case SCCP_HASHTABLE_KEY_UINT32:
+			*hash = __sccp_hashtable_hash_uint32(*(const uint32_t *) key);
+			return sizeof(uint32_t);
+		case SCCP_HASHTABLE_KEY_STRING:
+			*hash = __sccp_hashtable_hash_string((const char *) key);
+			return strlen((const char *) key) + 1;
+		case SCCP_HASHTABLE_KEY_STRCASE:
+		default:
+			*hash = __sccp_hashtable_hash_strcase((const char *) key);
+			return strlen((const char *) key) + 1;
+	}
+}
+
+static gcc_inline boolean_t __sccp_hashtable_key_equals(const sccp_hashtable_t * table, const struct sccp_hashtable_entry *entry, const void *key, const struct sockaddr_storage *addr)
+{
+	switch (table->keytype) {
+		case SCCP_HASHTABLE_KEY_SOCKADDR:
+			return sccp_netsock_cmp_addr((const struct sockaddr_storage *) entry->key, addr) == 0;
+		case SCCP_HASHTABLE_KEY_UINT32:
+			return *(const uint32_t *) entry->key == *(const uint32_t *) key;
+		case SCCP_HASHTABLE_KEY_STRING:
+			return sccp_strequals((const char *) entry->key, (const char *) key);
+		case SCCP_HASHTABLE_KEY_STRCASE:
+		default:
+			return sccp_strcaseequals((const char *) entry->key, (const char *) key);
+	}
+}
+
+/* ------------------------------------------------------------------------------------------------------- HASHTABLE - */
+/*!
+ * \brief Create a new hashtable
+ * \param name Name used in log messages
+ * \param buckets Number of buckets (use SCCP_HASH_PRIME if unsure)
+ * \param keytype Type of key
+ * \return Hashtable or NULL on failure
+ */
+sccp_hashtable_t *sccp_hashtable_create(const char *name, uint32_t buckets, sccp_hashtable_keytype_t keytype)
+{
+	sccp_hashtable_t *table = NULL;
+	uint32_t bucket = 0;
+
+	if (!buckets) {
+		buckets = SCCP_HASH_PRIME;
+	}
+	if (!(table = sccp_calloc(1, sizeof(sccp_hashtable_t) + (buckets * sizeof(struct sccp_hashtable_bucket))))) {
+		pbx_log(LOG_ERROR, SS_Memory_Allocation_Error, "SCCP");
+		return NULL;
+	}
+	sccp_copy_string(table->name, name, sizeof(table->name));
+	table->keytype = keytype;
+	table->num_buckets = buckets;
+	for (bucket = 0; bucket < buckets; bucket++) {
+		SCCP_RWLIST_HEAD_INIT(&table->buckets[bucket]);
+	}
+	sccp_log((DEBUGCAT_HIGH)) (VERBOSE_PREFIX_3 "SCCP: (hashtable) created '%s' with %d buckets\n", table->name, buckets);
+	return table;
+}
+
+/*!
+ * \brief Destroy a hashtable, the values are left untouched
+ */
+void sccp_hashtable_destroy(sccp_hashtable_t ** table)
+{
+	struct sccp_hashtable_entry *entry = NULL;
+	uint32_t bucket = 0;
+
+	if (!table || !*table) {
+		return;
+	}
+	for (bucket = 0; bucket < (*table)->num_buckets; bucket++) {
+		SCCP_RWLIST_WRLOCK(&(*table)->buckets[bucket]);
+		while ((entry = SCCP_RWLIST_REMOVE_HEAD(&(*table)->buckets[bucket], list))) {
+			sccp_free(entry);
+		}
+		SCCP_RWLIST_UNLOCK(&(*table)->buckets[bucket]);
+		SCCP_RWLIST_HEAD_DESTROY(&(*table)->buckets[bucket]);
+	}
+	sccp_free(*table);
+}
+
+/*!
+ * \brief Add value to the hashtable under key
+ * \note the key is copied, the value is not retained
+ */
+boolean_t sccp_hashtable_insert(sccp_hashtable_t * table, const void *key, void *value)
+{
+	struct sccp_hashtable_entry *entry = NULL;
+	struct sockaddr_storage addr = { 0 };
+	uint32_t hash = 0;
+	size_t keylen = 0;
+
+	if (!table || !key || !value) {
+		return FALSE;
+	}
+	keylen = __sccp_hashtable_prepare_key(table, key, &hash, &addr);
+	if (!(entry = sccp_calloc(1, sizeof(struct sccp_hashtable_entry) + keylen))) {
+		pbx_log(LOG_ERROR, SS_Memory_Allocation_Error, "SCCP");
+		return FALSE;
+	}
+	entry->value = value;
+	entry->hash = hash;
+	memcpy(entry->key, (table->keytype == SCCP_HASHTABLE_KEY_SOCKADDR) ? (const void *) &addr : key, keylen);
+
+	struct sccp_hashtable_bucket *bucket = &table->buckets[hash % table->num_buckets];
+	SCCP_RWLIST_WRLOCK(bucket);
+	SCCP_RWLIST_INSERT_TAIL(bucket, entry, list);
+	SCCP_RWLIST_UNLOCK(bucket);
+	return TRUE;
+}
+
+/*!
+ * \brief Remove the entry matching key and value from the hashtable
+ * \return TRUE if an entry was removed
+ */
+boolean_t sccp_hashtable_remove(sccp_hashtable_t * table, const void *key, const void *value)
+{
+	struct sccp_hashtable_entry *entry = NULL;
+	struct sockaddr_storage addr = { 0 };
+	uint32_t hash = 0;
+
+	if (!table || !key) {
+		return FALSE;
+	}
+	__sccp_hashtable_prepare_key(table, key, &hash, &addr);
+
+	struct sccp_hashtable_bucket *bucket = &table->buckets[hash % table->num_buckets];
+	SCCP_RWLIST_WRLOCK(bucket);
+	SCCP_RWLIST_TRAVERSE_SAFE_BEGIN(bucket, entry, list) {
+		if (entry->value == value && entry->hash == hash && __sccp_hashtable_key_equals(table, entry, key, &addr)) {
+			SCCP_RWLIST_REMOVE_CURRENT(list);
+			break;
+		}
+	}
+	SCCP_RWLIST_TRAVERSE_SAFE_END;
+	SCCP_RWLIST_UNLOCK(bucket);
+
+	if (entry) {
+		sccp_free(entry);
+		return TRUE;
+	}
+	return FALSE;
+}
+
+/*!
+ * \brief Find the first value stored under key
+ * \param table Hashtable
+ * \param key Key to look for
+ * \param retain Retain the (refcounted) value before releasing the bucket lock
+ * \param filename Debug FileName
+ * \param lineno Debug LineNumber
+ * \param func Debug Function Name
+ * \return value or NULL
+ */
+void *__sccp_hashtable_find(sccp_hashtable_t * table, const void *key, boolean_t retain, const char *filename, int lineno, const char *func)
+{
+	struct sccp_hashtable_entry *entry = NULL;
+	struct sockaddr_storage addr = { 0 };
+	void *value = NULL;
+	uint32_t hash = 0;
+
+	if (!table || !key) {
+		return NULL;
+	}
+	__sccp_hashtable_prepare_key(table, key, &hash, &addr);
+
+	struct sccp_hashtable_bucket *bucket = &table->buckets[hash % table->num_buckets];
+	SCCP_RWLIST_RDLOCK(bucket);
+	SCCP_RWLIST_TRAVERSE(bucket, entry, list) {
+		if (entry->hash == hash && __sccp_hashtable_key_equals(table, entry, key, &addr)) {
+			value = retain ? sccp_refcount_retain(entry->value, filename, lineno, func) : entry->value;
+			break;
+		}
+	}
+	SCCP_RWLIST_UNLOCK(bucket);
+	return value;
+}
+
+/*!
+ * \brief Call cb for every value stored under key, in insertion order
+ * \note cb is called with the bucket read-locked, it should not modify the hashtable
+ * \return number of values visited
+ */
+uint32_t sccp_hashtable_foreach_key(sccp_hashtable_t * table, const void *key, sccp_hashtable_cb_t cb, void *data)
+{
+	struct sccp_hashtable_entry *entry = NULL;
+	struct sockaddr_storage addr = { 0 };
+	uint32_t hash = 0;
+	uint32_t count = 0;
+
+	if (!table || !key || !cb) {
+		return 0;
+	}
+	__sccp_hashtable_prepare_key(table, key, &hash, &addr);
+
+	struct sccp_hashtable_bucket *bucket = &table->buckets[hash % table->num_buckets];
+	SCCP_RWLIST_RDLOCK(bucket);
+	SCCP_RWLIST_TRAVERSE(bucket, entry, list) {
+		if (entry->hash == hash && __sccp_hashtable_key_equals(table, entry, key, &addr)) {
+			cb(entry->value, data);
+			count++;
+		}
+	}
+	SCCP_RWLIST_UNLOCK(bucket);
+	return count;
+}
+
+/*!
+ * \brief Number of entries in the hashtable
+ */
+uint32_t sccp_hashtable_count(const sccp_hashtable_t * table)
+{
+	uint32_t count = 0;
+	uint32_t bucket = 0;
+
+	if (table) {
+		for (bucket = 0; bucket < table->num_buckets; bucket++) {
+			count += SCCP_RWLIST_GETSIZE(&table->buckets[bucket]);
+		}
+	}
+	return count;
+}
+#if CS_TEST_FRAMEWORK
+#include <asterisk/test.h>
+static void sccp_hashtable_test_sum_cb(void *value, void *data)
+{
+	*(int *) data += *(int *) value;
+}
+
+AST_TEST_DEFINE(chan_sccp_hashtable_tests)
+{
+	sccp_hashtable_t *table = NULL;
+	struct sockaddr_storage sas4, sas4mapped, sas6;
+	int value1 = 1, value2 = 2;
+	int sum = 0;
+
+	switch (cmd) {
+	case TEST_INIT:
+		info->name = "hashtable";
+		info->category = "/channels/chan_sccp/hashtable/";
+		info->summary = "chan-sccp-b hashtable test";
+		info->description = "chan-sccp-b string, ip-address and uint32 hashtable tests";
+		return AST_TEST_NOT_RUN;
+	case TEST_EXECUTE:
+		break;
+	}
+
+	pbx_test_status_update(test, "Executing chan-sccp-b string hashtable tests...\n");
+	table = sccp_hashtable_create("test", 7, SCCP_HASHTABLE_KEY_STRCASE);
+	pbx_test_validate(test, table != NULL);
+	pbx_test_validate(test, sccp_hashtable_insert(table, "SEP001122334455", &value1));
+	pbx_test_validate(test, sccp_hashtable_insert(table, "SEP001122334466", &value2));
+	pbx_test_validate(test, sccp_hashtable_count(table) == 2);
+	pbx_test_validate(test, sccp_hashtable_find(table, "sep001122334455") == &value1);
+	pbx_test_validate(test, sccp_hashtable_find(table, "SEP001122334466") == &value2);
+	pbx_test_validate(test, sccp_hashtable_find(table, "SEP001122334477") == NULL);
+	pbx_test_validate(test, !sccp_hashtable_remove(table, "SEP001122334455", &value2));
+	pbx_test_validate(test, sccp_hashtable_remove(table, "Sep001122334455", &value1));
+	pbx_test_validate(test, sccp_hashtable_find(table, "SEP001122334455") == NULL);
+	pbx_test_validate(test, sccp_hashtable_count(table) == 1);
+	pbx_test_validate(test, sccp_hashtable_insert(table, "SCCP/98011", &value1));
+	pbx_test_validate(test, sccp_hashtable_insert(table, "sccp/98011", &value2));
+	sum = 0;
+	pbx_test_validate(test, sccp_hashtable_foreach_key(table, "SCCP/98011", sccp_hashtable_test_sum_cb, &sum) == 2);
+	pbx_test_validate(test, sum == value1 + value2);
+	pbx_test_validate(test, sccp_hashtable_foreach_key(table, "SCCP/98031", sccp_hashtable_test_sum_cb, &sum) == 0);
+	sccp_hashtable_destroy(&table);
+	pbx_test_validate(test, table == NULL);
+
+	pbx_test_status_update(test, "Executing chan-sccp-b case-sensitive string hashtable tests...\n");
+	table = sccp_hashtable_create("test", 7, SCCP_HASHTABLE_KEY_STRING);
+	pbx_test_validate(test, sccp_hashtable_insert(table, "1000@default", &value1));
+	pbx_test_validate(test, sccp_hashtable_insert(table, "1000@Default", &value2));
+	pbx_test_validate(test, sccp_hashtable_find(table, "1000@default") == &value1);
+	pbx_test_validate(test, sccp_hashtable_find(table, "1000@Default") == &value2);
+	pbx_test_validate(test, sccp_hashtable_find(table, "1000@DEFAULT") == NULL);
+	pbx_test_validate(test, !sccp_hashtable_remove(table, "1000@DEFAULT", &value1));
+	pbx_test_validate(test, sccp_hashtable_remove(table, "1000@default", &value1));
+	pbx_test_validate(test, sccp_hashtable_count(table) == 1);
+	sccp_hashtable_destroy(&table);
+
+	pbx_test_status_update(test, "Executing chan-sccp-b ip-address hashtable tests...\n");
+	sccp_sockaddr_storage_parse(&sas4, "10.15.15.1:2000", PARSE_PORT_REQUIRE);
+	sccp_sockaddr_storage_parse(&sas4mapped, "[::ffff:10.15.15.1]:2001", PARSE_PORT_REQUIRE);
+	sccp_sockaddr_storage_parse(&sas6, "fe80::ffff:0:ffff:0", PARSE_PORT_FORBID);
+	table = sccp_hashtable_create("test", 7, SCCP_HASHTABLE_KEY_SOCKADDR);
+	pbx_test_validate(test, sccp_hashtable_insert(table, &sas4, &value1));
+	pbx_test_validate(test, sccp_hashtable_insert(table, &sas6, &value2));
+	pbx_test_validate(test, sccp_hashtable_find(table, &sas4mapped) == &value1);
+	pbx_test_validate(test, sccp_hashtable_find(table, &sas6) == &value2);
+	pbx_test_validate(test, sccp_hashtable_remove(table, &sas4mapped, &value1));
+	pbx_test_validate(test, sccp_hashtable_find(table, &sas4) == NULL);
+	sccp_hashtable_destroy(&table);
+
+	pbx_test_status_update(test, "Executing chan-sccp-b uint32 hashtable tests...\n");
+	uint32_t id1 = 1, id2 = 1 ^ 0xFFFFFFFF;
+	table = sccp_hashtable_create("test", 7, SCCP_HASHTABLE_KEY_UINT32);
+	pbx_test_validate(test, sccp_hashtable_insert(table, &id1, &value1));
+	pbx_test_validate(test, sccp_hashtable_insert(table, &id2, &value2));
+	pbx_test_validate(test, sccp_hashtable_find(table, &id1) == &value1);
+	pbx_test_validate(test, sccp_hashtable_find(table, &id2) == &value2);
+	pbx_test_validate(test, sccp_hashtable_remove(table, &id2, &value2));
+	pbx_test_validate(test, sccp_hashtable_find(table, &id2) == NULL);
+	sccp_hashtable_destroy(&table);
+
+	return AST_TEST_PASS;
+}
+
+static void __attribute__((constructor)) sccp_register_tests(void)
+{
+	AST_TEST_REGISTER(chan_sccp_hashtable_tests);
+}
+
+static void __attribute__((destructor)) sccp_unregister_tests(void)
+{
+	AST_TEST_UNREGISTER(chan_sccp_hashtable_tests);
+}
+#endif
+// kate: indent-width 8; replace-tabs off; indent-mode cstyle; auto-insert-doxygen on; line-numbers on; tab-indents on; keep-extra-spaces off; auto-brackets off;
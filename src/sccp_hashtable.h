@@ -0,0 +1,47 @@
+/*!
+ * \file        sccp_hashtable.h
+ * \brief       SCCP Hashtable Header
+ * \note        This program is free software and may be modified and distributed under the terms of the GNU Public License.
+ *              See the LICENSE file at the top of the source tree.
+ * \note        Simple chained hashtable, used to index objects that are kept in one of the global lists,
+ *              so that lookups do not have to traverse the complete list. The table does not own the values
+ *              it points to, it is up to the caller to keep the index in sync with the list.
+ */
+#pragma once
+
+__BEGIN_C_EXTERN__
+
+/*!
+ * \brief Type of key used by a hashtable
+ */
+typedef enum sccp_hashtable_keytype {
+	SCCP_HASHTABLE_KEY_STRCASE = 0,										/*!< case-insensitive string (const char *) */
+	SCCP_HASHTABLE_KEY_SOCKADDR,										/*!< ip-address of a struct sockaddr_storage, port is ignored (const struct sockaddr_storage *) */
+	SCCP_HASHTABLE_KEY_UINT32,										/*!< 32-bit unsigned integer, like a callid (const uint32_t *) */
+	SCCP_HASHTABLE_KEY_STRING,										/*!< case-sensitive string (const char *) */
+} sccp_hashtable_keytype_t;
+
+/*!
+ * \brief Callback used by sccp_hashtable_foreach_key
+ */
+typedef void (*sccp_hashtable_cb_t) (void *value, void *data);
+
+SCCP_API sccp_hashtable_t * SCCP_CALL sccp_hashtable_create(const char *name, uint32_t buckets, sccp_hashtable_keytype_t keytype);
+SCCP_API void SCCP_CALL sccp_hashtable_destroy(sccp_hashtable_t ** table);
+SCCP_API boolean_t SCCP_CALL sccp_hashtable_insert(sccp_hashtable_t * table, const void *key, void *value);
+SCCP_API boolean_t SCCP_CALL sccp_hashtable_remove(sccp_hashtable_t * table, const void *key, const void *value);
+SCCP_API void * SCCP_CALL __sccp_hashtable_find(sccp_hashtable_t * table, const void *key, boolean_t retain, const char *filename, int lineno, const char *func);
+SCCP_API uint32_t SCCP_CALL sccp_hashtable_foreach_key(sccp_hashtable_t * table, const void *key, sccp_hashtable_cb_t cb, void *data);
+SCCP_API uint32_t SCCP_CALL sccp_hashtable_count(const sccp_hashtable_t * table);
+
+/*!
+ * \brief Find value by key
+ */
+#define sccp_hashtable_find(_table, _key) __sccp_hashtable_find(_table, _key, FALSE, __FILE__, __LINE__, __PRETTY_FUNCTION__)
+/*!
+ * \brief Find refcounted value by key and return it retained (retain happens under the bucket lock)
+ */
+#define sccp_hashtable_find_retained(_table, _key) __sccp_hashtable_find(_table, _key, TRUE, __FILE__, __LINE__, __PRETTY_FUNCTION__)
+
+__END_C_EXTERN__
+// kate: indent-width 8; replace-tabs off; indent-mode cstyle; auto-insert-doxygen on; line-numbers on; tab-indents on; keep-extra-spaces off; auto-brackets off;
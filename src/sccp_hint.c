@@ -32,6 +32,7 @@ SCCP_FILE_VERSION(__FILE__, "");
 #include "sccp_device.h"
 #include "sccp_indicate.h"											// only for SCCP_CHANNELSTATE_Idling
 #include "sccp_line.h"
+#include "sccp_session.h"
 #include "sccp_utils.h"
 
 #if defined(CS_AST_HAS_EVENT) && defined(HAVE_PBX_EVENT_H) 	// ast_event_subscribe
@@ -54,8 +55,21 @@ struct sccp_hint_SubscribingDevice
 	sccp_device_t *device;											/*!< SCCP Device */
 	uint8_t instance;											/*!< Instance */
 	uint8_t positionOnDevice;										/*!< Instance */
+	boolean_t cidAvailable;											/*!< Device can show callerid on this button (dynamic speeddial) */
+	char label[StationMaxNameSize];										/*!< Speeddial Label */
 };														/*!< SCCP Hint Subscribing Device Structure */
 
+/*!
+ *\brief SCCP Hint State, rendered once per notification and shared by all subscribers of the same class
+ */
+struct sccp_hint_renderedState {
+	skinny_busylampfield_state_t status;									/*!< BLF Status (dynamic speeddial) */
+	char prefix[8];												/*!< Label Prefix for subscribers without callerid (dynamic speeddial) */
+	char cidPrefix[StationMaxNameSize * 2 + 8];								/*!< Label Prefix for subscribers showing callerid (dynamic speeddial) */
+	skinny_callstate_t iconstate;										/*!< Icon State (old hint style) */
+	skinny_callstate_t iconstateRingin;									/*!< Icon State when the device allows ringin notification (old hint style) */
+};
+
 /*!
  *\brief SCCP Hint Line State Structure
  */
@@ -80,7 +94,7 @@ struct sccp_hint_lineState
  * \brief SCCP Hint List Structure
  */
 struct sccp_hint_list {
-	//pbx_mutex_t lock;                                                                                       /*!< Asterisk Lock */
+	sccp_mutex_t lock;											/*!< Coalescing Lock */
 
 	char exten[SCCP_MAX_EXTENSION];										/*!< Extension for Hint */
 	char context[SCCP_MAX_CONTEXT];										/*!< Context for Hint */
@@ -101,6 +115,13 @@ struct sccp_hint_list {
 	skinny_calltype_t calltype;										/*!< Skinny Call Type */
 
 	int stateid;												/*!< subscription id in asterisk */
+	int coalesce_id;											/*!< scheduled (coalesced) notification id */
+	boolean_t coalesce_running;										/*!< scheduled notification is being sent right now */
+	boolean_t coalesce_cancelling;										/*!< cancel side claimed coalesce_id and owns the reference of the scheduled callback */
+	uint8_t refcount;											/*!< hint list + pending scheduled notifications (protected by lock) */
+	struct timeval lastNotify;										/*!< time subscribers were last notified */
+	uint32_t sentUpdates;											/*!< number of notifications sent to subscribers */
+	uint32_t suppressedUpdates;										/*!< number of state changes folded into a pending notification */
 #ifdef CS_USE_ASTERISK_DISTRIBUTED_DEVSTATE
 	PBX_EVENT_SUBSCRIPTION *device_state_sub;									/*!< asterisk distributed device state subscription */
 #endif
@@ -115,11 +136,15 @@ static void sccp_hint_updateLineStateForMultipleChannels(struct sccp_hint_lineSt
 static void sccp_hint_updateLineStateForSingleChannel(struct sccp_hint_lineState *lineState);
 static void sccp_hint_checkForDND(struct sccp_hint_lineState *lineState);
 static sccp_hint_list_t *sccp_hint_create(char *hint_exten, char *hint_context);
+static void sccp_hint_indexLines(sccp_hint_list_t * hint);
 static void sccp_hint_notifySubscribers(sccp_hint_list_t * hint);			/* old */
+static void sccp_hint_notifySubscribersCoalesced(sccp_hint_list_t * hint);
+static void sccp_hint_cancelCoalesced(sccp_hint_list_t * hint);
+static void sccp_hint_unref(sccp_hint_list_t * hint);
 static void sccp_hint_notifyLineStateUpdate(struct sccp_hint_lineState *linestate); 	/* new */
 static void sccp_hint_deviceRegistered(const sccp_device_t * device);
 static void sccp_hint_deviceUnRegistered(const char *deviceName);
-static void sccp_hint_addSubscription4Device(const sccp_device_t * device, const char *hintStr, const uint8_t instance, const uint8_t positionOnDevice);
+static void sccp_hint_addSubscription4Device(const sccp_device_t * device, const char *hintStr, const char *label, const uint8_t instance, const uint8_t positionOnDevice);
 static void sccp_hint_attachLine(sccp_line_t * line, sccp_device_t * device);
 static void sccp_hint_detachLine(sccp_line_t * line, sccp_device_t * device);
 static void sccp_hint_lineStatusChanged(sccp_line_t * line, sccp_device_t * device);
@@ -191,6 +216,8 @@ static void sccp_hint_distributed_devstate_cb(const pbx_event_t * event, void *d
 /* ========================================================================================================================= List Declarations */
 static SCCP_LIST_HEAD (, struct sccp_hint_lineState) lineStates;
 static SCCP_LIST_HEAD (, sccp_hint_list_t) sccp_hint_subscriptions;
+static sccp_hashtable_t *sccp_hint_lineIndex;									/* "SCCP/<linename>" -> hints referencing that line */
+static sccp_hashtable_t *sccp_hint_lineStateIndex;								/* "<linename>" -> lineState (devicestate lookups) */
 
 /* ========================================================================================================================= Module Start/Stop */
 /*!
@@ -201,6 +228,8 @@ void sccp_hint_module_start(void)
 	sccp_log((DEBUGCAT_CORE)) (VERBOSE_PREFIX_2 "SCCP: Starting hint system\n");
 	SCCP_LIST_HEAD_INIT(&lineStates);
 	SCCP_LIST_HEAD_INIT(&sccp_hint_subscriptions);
+	sccp_hint_lineIndex = sccp_hashtable_create("hintlines", SCCP_HASH_PRIME, SCCP_HASHTABLE_KEY_STRCASE);
+	sccp_hint_lineStateIndex = sccp_hashtable_create("linestates", SCCP_HASH_PRIME, SCCP_HASHTABLE_KEY_STRCASE);
 	sccp_event_subscribe(SCCP_EVENT_DEVICE_REGISTERED | SCCP_EVENT_DEVICE_UNREGISTERED | SCCP_EVENT_DEVICE_DETACHED | SCCP_EVENT_DEVICE_ATTACHED | SCCP_EVENT_LINESTATUS_CHANGED, sccp_hint_eventListener, TRUE);
 	sccp_event_subscribe(SCCP_EVENT_FEATURE_CHANGED, sccp_hint_handleFeatureChangeEvent, TRUE);
 #ifdef CS_USE_ASTERISK_DISTRIBUTED_DEVSTATE
@@ -219,6 +248,7 @@ void sccp_hint_module_stop(void)
 		struct sccp_hint_lineState *lineState;
 
 		SCCP_LIST_LOCK(&lineStates);
+		sccp_hashtable_destroy(&sccp_hint_lineStateIndex);
 		while ((lineState = SCCP_LIST_REMOVE_HEAD(&lineStates, list))) {
 			if (lineState->line) {
 				sccp_line_release(&lineState->line);		/* explicit release*/
@@ -233,11 +263,22 @@ void sccp_hint_module_stop(void)
 		sccp_hint_SubscribingDevice_t *subscriber;
 
 		SCCP_LIST_LOCK(&sccp_hint_subscriptions);
+		sccp_hashtable_destroy(&sccp_hint_lineIndex);
 		while ((hint = SCCP_LIST_REMOVE_HEAD(&sccp_hint_subscriptions, list))) {
 #ifdef CS_USE_ASTERISK_DISTRIBUTED_DEVSTATE
 			pbx_event_unsubscribe(hint->device_state_sub);
 #endif
 			ast_extension_state_del(hint->stateid, NULL);
+			sccp_hint_cancelCoalesced(hint);
+
+			/* a callback that claimed coalesce_id before us may still be sending, wait for it; it drops its own reference afterwards */
+			sccp_mutex_lock(&hint->lock);
+			while (hint->coalesce_running) {
+				sccp_mutex_unlock(&hint->lock);
+				usleep(1000);
+				sccp_mutex_lock(&hint->lock);
+			}
+			sccp_mutex_unlock(&hint->lock);
 
 			// All subscriptions that have this device should be removed, force cleanup 
 			SCCP_LIST_LOCK(&hint->subscribers);
@@ -251,8 +292,7 @@ void sccp_hint_module_stop(void)
 			}
 			SCCP_LIST_UNLOCK(&hint->subscribers);
 			SCCP_LIST_HEAD_DESTROY(&hint->subscribers);
-			iCallInfo.Destructor(&hint->callInfo);
-			sccp_free(hint);
+			sccp_hint_unref(hint);
 		}
 		SCCP_LIST_UNLOCK(&sccp_hint_subscriptions);
 	}
@@ -369,7 +409,7 @@ static int sccp_hint_devstate_cb(char *context, char *id, enum ast_extension_sta
 			break;
 	}
 
-	sccp_hint_notifySubscribers(hint);
+	sccp_hint_notifySubscribersCoalesced(hint);
 	return 0;
 }
 
@@ -446,7 +486,7 @@ static void sccp_hint_deviceRegistered(const sccp_device_t * device)
 			positionOnDevice++;
 
 			if (config->type == SPEEDDIAL && !sccp_strlen_zero(config->button.speeddial.hint)) {
-				sccp_hint_addSubscription4Device(device, config->button.speeddial.hint, config->instance, positionOnDevice);
+				sccp_hint_addSubscription4Device(device, config->button.speeddial.hint, config->label, config->instance, positionOnDevice);
 			}
 		}
 	}
@@ -486,6 +526,7 @@ static void sccp_hint_deviceUnRegistered(const char *deviceName)
  * \brief Subscribe to a Hint
  * \param device SCCP Device
  * \param hintStr Asterisk Hint Name as char
+ * \param label Speeddial Label as char
  * \param instance Instance as int
  * \param positionOnDevice button index on device (used to detect devicetype)
  * 
@@ -494,7 +535,7 @@ static void sccp_hint_deviceUnRegistered(const char *deviceName)
  * 
  * \note called with retained device
  */
-static void sccp_hint_addSubscription4Device(const sccp_device_t * device, const char *hintStr, const uint8_t instance, const uint8_t positionOnDevice)
+static void sccp_hint_addSubscription4Device(const sccp_device_t * device, const char *hintStr, const char *label, const uint8_t instance, const uint8_t positionOnDevice)
 {
 	sccp_hint_list_t *hint = NULL;
 
@@ -546,6 +587,7 @@ static void sccp_hint_addSubscription4Device(const sccp_device_t * device, const
 		}
 		SCCP_LIST_LOCK(&sccp_hint_subscriptions);
 		SCCP_LIST_INSERT_HEAD(&sccp_hint_subscriptions, hint, list);
+		sccp_hint_indexLines(hint);
 		SCCP_LIST_UNLOCK(&sccp_hint_subscriptions);
 	}
 
@@ -562,6 +604,10 @@ static void sccp_hint_addSubscription4Device(const sccp_device_t * device, const
 	subscriber->device = sccp_device_retain((sccp_device_t *) device);
 	subscriber->instance = instance;
 	subscriber->positionOnDevice = positionOnDevice;
+	sccp_copy_string(subscriber->label, label ? label : "", sizeof(subscriber->label));
+#ifdef CS_DYNAMIC_SPEEDDIAL
+	subscriber->cidAvailable = sccp_hint_isCIDavailabe(device, positionOnDevice);
+#endif
 
 	sccp_log((DEBUGCAT_HINT)) (VERBOSE_PREFIX_4 "%s: (sccp_hint_addSubscription4Device) Adding subscription for hint %s@%s\n", DEV_ID_LOG(device), hint->exten, hint->context);
 	SCCP_LIST_INSERT_HEAD(&hint->subscribers, subscriber, list);
@@ -619,7 +665,9 @@ static sccp_hint_list_t *sccp_hint_create(char *hint_exten, char *hint_context)
 	hint->calltype = SKINNY_CALLTYPE_SENTINEL;
 
 	SCCP_LIST_HEAD_INIT(&hint->subscribers);
-	//sccp_mutex_init(&hint->lock);
+	sccp_mutex_init(&hint->lock);
+	hint->coalesce_id = -1;
+	hint->refcount = 1;
 
 	sccp_copy_string(hint->exten, hint_exten, sizeof(hint->exten));
 	sccp_copy_string(hint->context, hint_context, sizeof(hint->context));
@@ -677,6 +725,7 @@ static void sccp_hint_attachLine(sccp_line_t * line, sccp_device_t * device)
 	if (!lineState->line) {		/* retain one instance of line in lineState->line */
 		//sccp_log((DEBUGCAT_HINT)) (VERBOSE_PREFIX_4 "%s: (sccp_hint_attachLine) attaching line: %s\n", DEV_ID_LOG(device), line->name);
 		lineState->line = sccp_line_retain(line);
+		sccp_hashtable_insert(sccp_hint_lineStateIndex, line->name, lineState);
 	}
 	SCCP_LIST_UNLOCK(&lineStates);
 	
@@ -694,6 +743,7 @@ static void sccp_hint_detachLine(sccp_line_t * line, sccp_device_t * device)
 		SCCP_LIST_TRAVERSE_SAFE_BEGIN(&lineStates, lineState, list) {
 			if (lineState->line == line) {
 				//sccp_log((DEBUGCAT_HINT)) (VERBOSE_PREFIX_4 "%s: (sccp_hint_detachLine) line: %s detached\n", DEV_ID_LOG(device), line->name);
+				sccp_hashtable_remove(sccp_hint_lineStateIndex, line->name, lineState);		/* unpublish before freeing, lookups hold the bucket lock */
 				if (lineState->line) {
 					sccp_line_release(&lineState->line);		/* explicit release*/
 				}
@@ -1097,15 +1147,196 @@ static enum ast_device_state sccp_hint_hint2DeviceState(sccp_channelstate_t stat
 }
 
 /* ========================================================================================================================= Subscriber Notify : Updates Speeddial */
+/*!
+ * \brief Render the state dependent part of the hint once, before fanning it out to the subscribers
+ * \param hint SCCP Hint Linked List Pointer
+ * \param rendered Rendered State (out)
+ */
+static void sccp_hint_renderState(sccp_hint_list_t * hint, struct sccp_hint_renderedState *rendered)
+{
+	memset(rendered, 0, sizeof(*rendered));
+
+#ifdef CS_DYNAMIC_SPEEDDIAL
+	char cidName[StationMaxNameSize] = "";
+	char cidNumber[StationMaxDirnumSize] = "";
+
+	rendered->status = SKINNY_BLF_STATUS_UNKNOWN;
+	switch (hint->currentState) {
+		case SCCP_CHANNELSTATE_DOWN:
+			rendered->status = SKINNY_BLF_STATUS_UNKNOWN;					/* default state */
+			break;
+
+		case SCCP_CHANNELSTATE_ONHOOK:
+			rendered->status = SKINNY_BLF_STATUS_IDLE;
+			break;
+
+		case SCCP_CHANNELSTATE_DND:
+			sccp_copy_string(rendered->prefix, "(DND) ", sizeof(rendered->prefix));
+			rendered->status = SKINNY_BLF_STATUS_DND;					/* dnd */
+			break;
+
+		case SCCP_CHANNELSTATE_CONGESTION:
+			rendered->status = SKINNY_BLF_STATUS_UNKNOWN;					/* device/line not found */
+			break;
+
+		case SCCP_CHANNELSTATE_RINGING:
+			rendered->status = SKINNY_BLF_STATUS_ALERTING;					/* ringin */
+			/* fall through */
+
+		default:
+			if (hint->calltype == SKINNY_CALLTYPE_INBOUND) {
+				iCallInfo.Getter(hint->callInfo, 
+					SCCP_CALLINFO_CALLINGPARTY_NAME, &cidName, 
+					SCCP_CALLINFO_CALLINGPARTY_NUMBER, &cidNumber, 
+					SCCP_CALLINFO_KEY_SENTINEL);
+			} else {
+				iCallInfo.Getter(hint->callInfo, 
+					SCCP_CALLINFO_CALLEDPARTY_NAME, &cidName, 
+					SCCP_CALLINFO_CALLEDPARTY_NUMBER, &cidNumber, 
+					SCCP_CALLINFO_KEY_SENTINEL);
+			}
+			if (strlen(cidName) > 0 || strlen(cidNumber) > 0) {
+				snprintf(rendered->cidPrefix, sizeof(rendered->cidPrefix), "%s %s ", strlen(cidName) > 0 ? cidName : cidNumber, (SCCP_CHANNELSTATE_CONNECTED == hint->currentState) ? "<=>" : ((hint->calltype == SKINNY_CALLTYPE_OUTBOUND) ? "<-" : "->"));
+			}
+			if (rendered->status == SKINNY_BLF_STATUS_UNKNOWN) {				/* still default value --> set */
+				rendered->status = SKINNY_BLF_STATUS_INUSE;
+			}
+			break;
+	}
+	if (sccp_strlen_zero(rendered->cidPrefix)) {
+		sccp_copy_string(rendered->cidPrefix, rendered->prefix, sizeof(rendered->cidPrefix));
+	}
+#endif
+
+	/*
+	   With the old hint style we should only use SCCP_CHANNELSTATE_ONHOOK and SCCP_CHANNELSTATE_CALLREMOTEMULTILINE as callstate,
+	   otherwise we get a callplane on device -> set all states except onhook to SCCP_CHANNELSTATE_CALLREMOTEMULTILINE -MC
+	 */
+	rendered->iconstate = SKINNY_CALLSTATE_CALLREMOTEMULTILINE;
+	switch (hint->currentState) {
+		case SCCP_CHANNELSTATE_DOWN:
+		case SCCP_CHANNELSTATE_ONHOOK:
+			rendered->iconstate = SKINNY_CALLSTATE_ONHOOK;
+			break;
+		case SCCP_CHANNELSTATE_ZOMBIE:
+		case SCCP_CHANNELSTATE_CONGESTION:
+		case SCCP_CHANNELSTATE_CONNECTED:
+		case SCCP_CHANNELSTATE_OFFHOOK:
+		case SCCP_CHANNELSTATE_RINGOUT:
+		case SCCP_CHANNELSTATE_RINGING:
+		case SCCP_CHANNELSTATE_BUSY:
+		case SCCP_CHANNELSTATE_HOLD:
+		case SCCP_CHANNELSTATE_CALLWAITING:
+		case SCCP_CHANNELSTATE_CALLPARK:
+		case SCCP_CHANNELSTATE_PROCEED:
+		case SCCP_CHANNELSTATE_CALLREMOTEMULTILINE:
+		case SCCP_CHANNELSTATE_INVALIDNUMBER:
+		case SCCP_CHANNELSTATE_DIALING:
+		case SCCP_CHANNELSTATE_PROGRESS:
+		case SCCP_CHANNELSTATE_GETDIGITS:
+		case SCCP_CHANNELSTATE_SPEEDDIAL:
+		case SCCP_CHANNELSTATE_DIGITSFOLL:
+		case SCCP_CHANNELSTATE_INVALIDCONFERENCE:
+		case SCCP_CHANNELSTATE_CONNECTEDCONFERENCE:
+		case SCCP_CHANNELSTATE_BLINDTRANSFER:
+		case SCCP_CHANNELSTATE_DND:
+		case SCCP_CHANNELSTATE_CALLTRANSFER:
+		case SCCP_CHANNELSTATE_CALLCONFERENCE:
+			rendered->iconstate = SKINNY_CALLSTATE_CALLREMOTEMULTILINE;
+			break;
+		case SCCP_CHANNELSTATE_SENTINEL:
+			break;
+	}
+	rendered->iconstateRingin = (SCCP_CHANNELSTATE_RINGING == hint->currentState) ? SKINNY_CALLSTATE_RINGIN : rendered->iconstate;
+}
+
+#ifdef CS_DYNAMIC_SPEEDDIAL
+/*!
+ * \brief Stamp the rendered state with the subscriber's instance and label and send it as FeatureStatDynamicMessage
+ */
+static void sccp_hint_sendDynamicSpeeddial(constDevicePtr d, sccp_hint_SubscribingDevice_t * subscriber, const struct sccp_hint_renderedState *rendered)
+{
+	sccp_msg_t *msg = NULL;
+	char displayMessage[80] = "";
+	size_t len = 0;
+
+	snprintf(displayMessage, sizeof(displayMessage), "%s%s", subscriber->cidAvailable ? rendered->cidPrefix : rendered->prefix, subscriber->label);
+	sccp_log((DEBUGCAT_HINT)) (VERBOSE_PREFIX_4 "%s: (sccp_hint_notifySubscribers) notify device: %s@%d, status: %d, display name: \"%s\"\n", DEV_ID_LOG(d), DEV_ID_LOG(d), subscriber->instance, rendered->status, displayMessage);
+
+	/*!
+	 * hack to fix the white text without shadow issue -MC
+	 *
+	 * first send a label which is 1-character shorter than the correct one. 
+	 * then send another message with a longer label (correct/final label) will force an update (in white over the back drop in black)
+	 */
+	REQ(msg, FeatureStatDynamicMessage);
+	if (!msg) {
+		return;
+	}
+	msg->data.FeatureStatDynamicMessage.lel_featureIndex = htolel(subscriber->instance);
+	msg->data.FeatureStatDynamicMessage.lel_featureID = htolel(SKINNY_BUTTONTYPE_BLFSPEEDDIAL);
+	msg->data.FeatureStatDynamicMessage.lel_featureStatus = htolel(rendered->status);
+	sccp_copy_string(msg->data.FeatureStatDynamicMessage.featureTextLabel, displayMessage, sizeof(msg->data.FeatureStatDynamicMessage.featureTextLabel));
+	len = strlen(msg->data.FeatureStatDynamicMessage.featureTextLabel);
+
+	sccp_msg_t *msg2 = NULL;
+	REQ(msg2, FeatureStatDynamicMessage);
+	if (msg2) {
+		memcpy(&msg2->data.FeatureStatDynamicMessage, &msg->data.FeatureStatDynamicMessage, sizeof(msg2->data.FeatureStatDynamicMessage));
+	}
+	if (len > 0) {
+		msg->data.FeatureStatDynamicMessage.featureTextLabel[len - 1] = '\0';
+	}
+	sccp_dev_send(d, msg);
+	if (msg2) {
+		sccp_dev_send(d, msg2);
+	}
+}
+#endif
+
+/*!
+ * \brief Send the rendered state to an old style (protocol < 15) subscriber
+ */
+static void sccp_hint_sendCallstate(sccp_hint_list_t * hint, constDevicePtr d, sccp_hint_SubscribingDevice_t * subscriber, const struct sccp_hint_renderedState *rendered)
+{
+	skinny_callstate_t iconstate = d->allowRinginNotification ? rendered->iconstateRingin : rendered->iconstate;
+
+	sccp_log((DEBUGCAT_HINT)) (VERBOSE_PREFIX_4 "%s: (sccp_hint_notifySubscribers) can not handle dynamic speeddial, fall back to old behavior using state %s (%d)\n", DEV_ID_LOG(d), sccp_channelstate2str(hint->currentState), hint->currentState);
+	sccp_log((DEBUGCAT_HINT)) (VERBOSE_PREFIX_4 "%s: (sccp_hint_notifySubscribers) setting icon to state %s (%d)\n", DEV_ID_LOG(d), skinny_callstate2str(iconstate), iconstate);
+
+	if (SCCP_CHANNELSTATE_RINGING == hint->previousState) {
+		/* we send a congestion to the phone, so call will not be marked as missed call */
+		sccp_device_sendcallstate(d, subscriber->instance, 0, SKINNY_CALLSTATE_CONGESTION, SKINNY_CALLPRIORITY_NORMAL, SKINNY_CALLINFO_VISIBILITY_HIDDEN);
+	}
+
+	sccp_device_sendcallstate(d, subscriber->instance, 0, iconstate, SKINNY_CALLPRIORITY_NORMAL, SKINNY_CALLINFO_VISIBILITY_DEFAULT); /** do not set visibility to COLLAPSED, this will hidde callInfo in state CALLREMOTEMULTILINE */
+
+	if (hint->currentState == SCCP_CHANNELSTATE_ONHOOK || hint->currentState == SCCP_CHANNELSTATE_CONGESTION) {
+		sccp_device_setLamp(d, SKINNY_STIMULUS_LINE, subscriber->instance, SKINNY_LAMP_OFF);
+		sccp_dev_set_keyset(d, subscriber->instance, 0, KEYMODE_ONHOOK);
+
+	} else if (hint->currentState == SCCP_CHANNELSTATE_RINGING && d->allowRinginNotification) {
+		sccp_device_setLamp(d, SKINNY_STIMULUS_LINE, subscriber->instance, SKINNY_LAMP_BLINK);
+		sccp_dev_set_keyset(d, subscriber->instance, 0, KEYMODE_INUSEHINT);
+
+	} else {
+		iCallInfo.Send(hint->callInfo, 0 /*callid*/, (hint->calltype == SKINNY_CALLTYPE_OUTBOUND) ? SKINNY_CALLTYPE_OUTBOUND : SKINNY_CALLTYPE_INBOUND, subscriber->instance, d, TRUE);
+		sccp_device_setLamp(d, SKINNY_STIMULUS_LINE, subscriber->instance, SKINNY_LAMP_ON);
+		sccp_dev_set_keyset(d, subscriber->instance, 0 /*callid*/, KEYMODE_INUSEHINT);
+	}
+}
+
 /*!
  * \brief send hint status to subscriber
  * \param hint SCCP Hint Linked List Pointer
+ * \note the state is rendered once (per protocol class and callerid visibility), per subscriber only the instance and label are filled in
  *
  * \todo Check if the actual device still exists while going throughthe hint->subscribers and not pointing at rubish
  */
 static void sccp_hint_notifySubscribers(sccp_hint_list_t * hint)
 {
 	sccp_hint_SubscribingDevice_t *subscriber = NULL;
+	struct sccp_hint_renderedState rendered;
 
 	if (!hint) {
 		pbx_log(LOG_ERROR, "SCCP: (sccp_hint_notifySubscribers) no hint provided to notifySubscribers about\n");
@@ -1118,6 +1349,7 @@ static void sccp_hint_notifySubscribers(sccp_hint_list_t * hint)
 	}
 
 	sccp_log((DEBUGCAT_HINT)) (VERBOSE_PREFIX_3 "%s: (sccp_hint_notifySubscribers) notify %u subscriber(s) of %s's state %s\n", hint->exten, SCCP_LIST_GETSIZE(&hint->subscribers), hint->hint_dialplan, sccp_channelstate2str(hint->currentState));
+	sccp_hint_renderState(hint, &rendered);
 
 	SCCP_LIST_LOCK(&hint->subscribers);
 	SCCP_LIST_TRAVERSE(&hint->subscribers, subscriber, list) {
@@ -1125,104 +1357,10 @@ static void sccp_hint_notifySubscribers(sccp_hint_list_t * hint)
 
 		if (d) {
 			sccp_log((DEBUGCAT_HINT)) (VERBOSE_PREFIX_4 "%s: (sccp_hint_notifySubscribers) notify subscriber %s of %s's state %s (%d)\n", DEV_ID_LOG(d), d->id, hint->hint_dialplan, sccp_channelstate2str(hint->currentState), hint->currentState);
+			sccp_session_corkDevice(d);								/* send all messages for this subscriber in one go */
 #ifdef CS_DYNAMIC_SPEEDDIAL
-			sccp_msg_t *msg = NULL;
-			sccp_speed_t k;
-			char displayMessage[80] = "";
-			skinny_busylampfield_state_t status = SKINNY_BLF_STATUS_UNKNOWN;
 			if (d->inuseprotocolversion >= 15) {
-				sccp_dev_speed_find_byindex( d, subscriber->instance, TRUE, &k);
-
-				REQ(msg, FeatureStatDynamicMessage);
-				if (msg) {
-					char cidName[StationMaxNameSize] = "";
-					char cidNumber[StationMaxDirnumSize] = "";
-
-					switch (hint->currentState) {
-					case SCCP_CHANNELSTATE_DOWN:
-						snprintf(displayMessage, sizeof(displayMessage), "%s", k.name);
-						status = SKINNY_BLF_STATUS_UNKNOWN;	/* default state */
-						break;
-
-					case SCCP_CHANNELSTATE_ONHOOK:
-						snprintf(displayMessage, sizeof(displayMessage), "%s", k.name);
-						status = SKINNY_BLF_STATUS_IDLE;
-						break;
-
-					case SCCP_CHANNELSTATE_DND:
-						//snprintf(displayMessage, sizeof(displayMessage), k.name, sizeof(displayMessage));
-						snprintf(displayMessage, sizeof(displayMessage), "(DND) %s", k.name);
-						status = SKINNY_BLF_STATUS_DND;	/* dnd */
-						break;
-
-					case SCCP_CHANNELSTATE_CONGESTION:
-						snprintf(displayMessage, sizeof(displayMessage), "%s", k.name);
-						status = SKINNY_BLF_STATUS_UNKNOWN;	/* device/line not found */
-						break;
-
-					case SCCP_CHANNELSTATE_RINGING:
-						status = SKINNY_BLF_STATUS_ALERTING;	/* ringin */
-						/* fall through */
-
-					default:
-#ifdef CS_DYNAMIC_SPEEDDIAL
-						if (sccp_hint_isCIDavailabe(d, subscriber->positionOnDevice) == TRUE) {
-							if (hint->calltype == SKINNY_CALLTYPE_INBOUND) {
-								iCallInfo.Getter(hint->callInfo, 
-									SCCP_CALLINFO_CALLINGPARTY_NAME, &cidName, 
-									SCCP_CALLINFO_CALLINGPARTY_NUMBER, &cidNumber, 
-									SCCP_CALLINFO_KEY_SENTINEL);
-							} else {
-								iCallInfo.Getter(hint->callInfo, 
-									SCCP_CALLINFO_CALLEDPARTY_NAME, &cidName, 
-									SCCP_CALLINFO_CALLEDPARTY_NUMBER, &cidNumber, 
-									SCCP_CALLINFO_KEY_SENTINEL);
-							}
-							if (strlen(cidName) > 0) {
-								snprintf(displayMessage, sizeof(displayMessage), "%s %s %s", cidName, (SCCP_CHANNELSTATE_CONNECTED == hint->currentState) ? "<=>" : ((hint->calltype == SKINNY_CALLTYPE_OUTBOUND) ? "<-" : "->"), k.name);
-							} else if (strlen(cidNumber) > 0) {
-								snprintf(displayMessage, sizeof(displayMessage), "%s %s %s", cidNumber, (SCCP_CHANNELSTATE_CONNECTED == hint->currentState) ? "<=>" : ((hint->calltype == SKINNY_CALLTYPE_OUTBOUND) ? "<-" : "->"), k.name);
-							} else {
-								snprintf(displayMessage, sizeof(displayMessage), "%s", k.name);
-							}
-						} else 
-#endif
-						{
-							snprintf(displayMessage, sizeof(displayMessage), "%s", k.name);
-						}
-						if (status == SKINNY_BLF_STATUS_UNKNOWN) {	/* still default value --> set */
-							status = SKINNY_BLF_STATUS_INUSE;
-						}
-						break;
-					}
-					sccp_log((DEBUGCAT_HINT)) (VERBOSE_PREFIX_4 "%s: (sccp_hint_notifySubscribers) set display name to: \"%s\"\n", DEV_ID_LOG(d), displayMessage);
-					sccp_copy_string(msg->data.FeatureStatDynamicMessage.featureTextLabel, displayMessage, sizeof(msg->data.FeatureStatDynamicMessage.featureTextLabel));
-					msg->data.FeatureStatDynamicMessage.featureTextLabel[strlen(displayMessage)-1] = '\0';
-					sccp_log((DEBUGCAT_HINT)) (VERBOSE_PREFIX_4 "%s: (sccp_hint_notifySubscribers) notify device: %s@%d state: %d(%d)\n", DEV_ID_LOG(d), DEV_ID_LOG(d), subscriber->instance, hint->currentState, msg->data.FeatureStatDynamicMessage.lel_featureStatus);
-					
-					msg->data.FeatureStatDynamicMessage.lel_featureIndex = htolel(subscriber->instance);
-					msg->data.FeatureStatDynamicMessage.lel_featureID = htolel(SKINNY_BUTTONTYPE_BLFSPEEDDIAL);
-					msg->data.FeatureStatDynamicMessage.lel_featureStatus = htolel(status);
-					
-					/*!
-					* hack to fix the white text without shadow issue -MC
-					*
-					* first send a label which is 1-character shorter than the correct one. 
-					* then send another message with a longer label (correct/final label) will force an update (in white over the back drop in black)
-					*/
-					sccp_dev_send(d, msg);
-					
-					
-					REQ(msg, FeatureStatDynamicMessage);
-					sccp_copy_string(msg->data.FeatureStatDynamicMessage.featureTextLabel, displayMessage, sizeof(msg->data.FeatureStatDynamicMessage.featureTextLabel));
-					msg->data.FeatureStatDynamicMessage.lel_featureIndex = htolel(subscriber->instance);
-					msg->data.FeatureStatDynamicMessage.lel_featureID = htolel(SKINNY_BUTTONTYPE_BLFSPEEDDIAL);
-					msg->data.FeatureStatDynamicMessage.lel_featureStatus = htolel(status);
-					
-					sccp_dev_send(d, msg);
-				} else {
-					sccp_free(msg);
-				}
+				sccp_hint_sendDynamicSpeeddial(d, subscriber, &rendered);
 			} else
 #endif
 			{
@@ -1230,80 +1368,147 @@ static void sccp_hint_notifySubscribers(sccp_hint_list_t * hint)
 				   we have dynamic speeddial enabled, but subscriber can not handle this.
 				   We have to switch back to old hint style and send old state.
 				 */
-				sccp_log((DEBUGCAT_HINT)) (VERBOSE_PREFIX_4 "%s: (sccp_hint_notifySubscribers) can not handle dynamic speeddial, fall back to old behavior using state %s (%d)\n", DEV_ID_LOG(d), sccp_channelstate2str(hint->currentState), hint->currentState);
+				sccp_hint_sendCallstate(hint, d, subscriber, &rendered);
+			}
+			sccp_session_uncorkDevice(d);
+		} else {
+			sccp_log((DEBUGCAT_HINT)) (VERBOSE_PREFIX_4 "SCCP: (sccp_hint_notifySubscribers) device not found/retained\n");
+		}
+	}
+	SCCP_LIST_UNLOCK(&hint->subscribers);
+}
 
-				/*
-				   With the old hint style we should only use SCCP_CHANNELSTATE_ONHOOK and SCCP_CHANNELSTATE_CALLREMOTEMULTILINE as callstate,
-				   otherwise we get a callplane on device -> set all states except onhook to SCCP_CHANNELSTATE_CALLREMOTEMULTILINE -MC
-				 */
-				skinny_callstate_t iconstate = SKINNY_CALLSTATE_CALLREMOTEMULTILINE;
+/*!
+ * \brief drop a reference to the hint, the last one frees it
+ * \note a scheduled notification holds a reference of its own, so that a hint removed while the notification is firing stays valid
+ */
+static void sccp_hint_unref(sccp_hint_list_t * hint)
+{
+	uint8_t refcount = 0;
+
+	sccp_mutex_lock(&hint->lock);
+	refcount = --hint->refcount;
+	sccp_mutex_unlock(&hint->lock);
+	if (!refcount) {
+		sccp_mutex_destroy(&hint->lock);
+		iCallInfo.Destructor(&hint->callInfo);
+		sccp_free(hint);
+	}
+}
 
-				switch (hint->currentState) {
-					case SCCP_CHANNELSTATE_DOWN:
-					case SCCP_CHANNELSTATE_ONHOOK:
-						iconstate = SKINNY_CALLSTATE_ONHOOK;
-						break;
-					case SCCP_CHANNELSTATE_RINGING:
-						if (d->allowRinginNotification) {
-							iconstate = SKINNY_CALLSTATE_RINGIN;
-						}
-						break;
-					case SCCP_CHANNELSTATE_ZOMBIE:
-					case SCCP_CHANNELSTATE_CONGESTION:
-					case SCCP_CHANNELSTATE_CONNECTED:
-					case SCCP_CHANNELSTATE_OFFHOOK:
-					case SCCP_CHANNELSTATE_RINGOUT:
-					case SCCP_CHANNELSTATE_BUSY:
-					case SCCP_CHANNELSTATE_HOLD:
-					case SCCP_CHANNELSTATE_CALLWAITING:
-					case SCCP_CHANNELSTATE_CALLPARK:
-					case SCCP_CHANNELSTATE_PROCEED:
-					case SCCP_CHANNELSTATE_CALLREMOTEMULTILINE:
-					case SCCP_CHANNELSTATE_INVALIDNUMBER:
-					case SCCP_CHANNELSTATE_DIALING:
-					case SCCP_CHANNELSTATE_PROGRESS:
-					case SCCP_CHANNELSTATE_GETDIGITS:
-					case SCCP_CHANNELSTATE_SPEEDDIAL:
-					case SCCP_CHANNELSTATE_DIGITSFOLL:
-					case SCCP_CHANNELSTATE_INVALIDCONFERENCE:
-					case SCCP_CHANNELSTATE_CONNECTEDCONFERENCE:
-					case SCCP_CHANNELSTATE_BLINDTRANSFER:
-					case SCCP_CHANNELSTATE_DND:
-					case SCCP_CHANNELSTATE_CALLTRANSFER:
-					case SCCP_CHANNELSTATE_CALLCONFERENCE:
-						iconstate = SKINNY_CALLSTATE_CALLREMOTEMULTILINE;
-						break;
-					case SCCP_CHANNELSTATE_SENTINEL:
-						break;
-				}
-				sccp_log((DEBUGCAT_HINT)) (VERBOSE_PREFIX_4 "%s: (sccp_hint_notifySubscribers) setting icon to state %s (%d)\n", DEV_ID_LOG(d), skinny_callstate2str(iconstate), iconstate);
+/*!
+ * \brief cancel the pending scheduled notification (if any)
+ * \note the reference held by the scheduled callback belongs to whichever side clears coalesce_id first (under hint->lock). When we
+ *       claim it, the callback leaves the hint alone, and no new notification is scheduled until ast_sched_del has returned (it waits
+ *       for a callback which is already running). The scheduler is never called with hint->lock held, the callback needs the same lock.
+ */
+static void sccp_hint_cancelCoalesced(sccp_hint_list_t * hint)
+{
+	int id = -1;
 
-				if (SCCP_CHANNELSTATE_RINGING == hint->previousState) {
-					/* we send a congestion to the phone, so call will not be marked as missed call */
-					sccp_device_sendcallstate(d, subscriber->instance, 0, SKINNY_CALLSTATE_CONGESTION, SKINNY_CALLPRIORITY_NORMAL, SKINNY_CALLINFO_VISIBILITY_HIDDEN);
-				}
+	sccp_mutex_lock(&hint->lock);
+	if ((id = hint->coalesce_id) > -1) {
+		hint->coalesce_id = -1;
+		hint->coalesce_cancelling = TRUE;
+	}
+	sccp_mutex_unlock(&hint->lock);
+
+	if (id > -1) {
+		iPbx.sched_del(id);										/* outcome does not matter, we own the reference either way */
+		sccp_mutex_lock(&hint->lock);
+		hint->coalesce_cancelling = FALSE;
+		sccp_mutex_unlock(&hint->lock);
+		sccp_hint_unref(hint);
+	}
+}
 
-				sccp_device_sendcallstate(d, subscriber->instance, 0, iconstate, SKINNY_CALLPRIORITY_NORMAL, SKINNY_CALLINFO_VISIBILITY_DEFAULT); /** do not set visibility to COLLAPSED, this will hidde callInfo in state CALLREMOTEMULTILINE */
+/*!
+ * \brief scheduled end of the coalescing window, notify the subscribers about the latest state
+ * \note the callback only owns its reference when it claims coalesce_id, if the cancel side got there first it returns without
+ *       touching the hint again (sccp_hint_cancelCoalesced drops the reference once ast_sched_del has waited for us).
+ */
+static int sccp_hint_coalesceTimeout(const void *data)
+{
+	sccp_hint_list_t *hint = (sccp_hint_list_t *) data;
+	boolean_t claimed = FALSE;
+	boolean_t notify = FALSE;
 
-				if (hint->currentState == SCCP_CHANNELSTATE_ONHOOK || hint->currentState == SCCP_CHANNELSTATE_CONGESTION) {
-					sccp_device_setLamp(d, SKINNY_STIMULUS_LINE, subscriber->instance, SKINNY_LAMP_OFF);
-					sccp_dev_set_keyset(d, subscriber->instance, 0, KEYMODE_ONHOOK);
+	if (!hint) {
+		return 0;
+	}
+	sccp_mutex_lock(&hint->lock);
+	if (hint->coalesce_id > -1) {
+		hint->coalesce_id = -1;
+		claimed = TRUE;
+		if (GLOB(module_running)) {
+			hint->coalesce_running = TRUE;
+			hint->lastNotify = pbx_tvnow();
+			hint->sentUpdates++;
+			notify = TRUE;
+		}
+	}
+	sccp_mutex_unlock(&hint->lock);
+	if (!claimed) {
+		return 0;
+	}
 
-				} else if (hint->currentState == SCCP_CHANNELSTATE_RINGING && d->allowRinginNotification) {
-					sccp_device_setLamp(d, SKINNY_STIMULUS_LINE, subscriber->instance, SKINNY_LAMP_BLINK);
-					sccp_dev_set_keyset(d, subscriber->instance, 0, KEYMODE_INUSEHINT);
+	if (notify) {
+		sccp_log((DEBUGCAT_HINT)) (VERBOSE_PREFIX_4 "%s: (sccp_hint_coalesceTimeout) coalescing window ended, sending state %s\n", hint->exten, sccp_channelstate2str(hint->currentState));
+		sccp_hint_notifySubscribers(hint);
+		sccp_mutex_lock(&hint->lock);
+		hint->coalesce_running = FALSE;
+		sccp_mutex_unlock(&hint->lock);
+	}
+	sccp_hint_unref(hint);
+	return 0;
+}
 
-				} else {
-					iCallInfo.Send(hint->callInfo, 0 /*callid*/, (hint->calltype == SKINNY_CALLTYPE_OUTBOUND) ? SKINNY_CALLTYPE_OUTBOUND : SKINNY_CALLTYPE_INBOUND, subscriber->instance, d, TRUE);
-					sccp_device_setLamp(d, SKINNY_STIMULUS_LINE, subscriber->instance, SKINNY_LAMP_ON);
-					sccp_dev_set_keyset(d, subscriber->instance, 0 /*callid*/, KEYMODE_INUSEHINT);
-				}
+/*!
+ * \brief notify subscribers, coalescing state changes arriving within GLOB(hint_coalesce_window) ms into a single notification
+ *
+ * \note the first update after a quiet period is sent immediately and opens the window, updates arriving inside the window
+ * only update the hint state and are sent once when the window closes. The first RINGING always bypasses the window, so
+ * alerting is never delayed.
+ */
+static void sccp_hint_notifySubscribersCoalesced(sccp_hint_list_t * hint)
+{
+	uint16_t window = GLOB(hint_coalesce_window);
+	boolean_t notifyNow = TRUE;
+	boolean_t cancel = FALSE;
+
+	sccp_mutex_lock(&hint->lock);
+	struct timeval now = pbx_tvnow();
+	int64_t elapsed = ast_tvdiff_ms(now, hint->lastNotify);
+
+	if (window && !(SCCP_CHANNELSTATE_RINGING == hint->currentState && SCCP_CHANNELSTATE_RINGING != hint->previousState)) {
+		if (hint->coalesce_id > -1) {									/* notification already pending, it will pick up this state */
+			hint->suppressedUpdates++;
+			notifyNow = FALSE;
+		} else if (elapsed < window && !hint->coalesce_cancelling) {				/* while a cancel is in progress, send right away */
+			if ((hint->coalesce_id = iPbx.sched_add(window - elapsed, sccp_hint_coalesceTimeout, hint)) > -1) {
+				hint->refcount++;								/* reference held by the scheduled callback */
+				hint->suppressedUpdates++;
+				notifyNow = FALSE;
 			}
-		} else {
-			sccp_log((DEBUGCAT_HINT)) (VERBOSE_PREFIX_4 "SCCP: (sccp_hint_notifySubscribers) device not found/retained\n");
 		}
+	} else if (hint->coalesce_id > -1) {									/* sending now, drop the pending notification (after unlocking) */
+		cancel = TRUE;
+		hint->suppressedUpdates++;
+	}
+	if (notifyNow) {
+		hint->lastNotify = now;
+		hint->sentUpdates++;
+	}
+	sccp_mutex_unlock(&hint->lock);
+
+	if (cancel) {
+		sccp_hint_cancelCoalesced(hint);
+	}
+	if (notifyNow) {
+		sccp_hint_notifySubscribers(hint);
+	} else {
+		sccp_log((DEBUGCAT_HINT)) (VERBOSE_PREFIX_4 "%s: (sccp_hint_notifySubscribersCoalesced) coalescing state %s\n", hint->exten, sccp_channelstate2str(hint->currentState));
 	}
-	SCCP_LIST_UNLOCK(&hint->subscribers);
 }
 
 /* ========================================================================================================================= PBX Notify */
@@ -1338,32 +1543,56 @@ static void sccp_hint_notifySubscribersViaPbx(sccp_hint_list_t *hint, struct scc
 }
 
 /* ========================================================================================================================= PBX Notify */
+struct sccp_hint_isIndexed {
+	const sccp_hint_list_t *hint;
+	boolean_t found;
+};
+
 /*!
- * \brief helper function to parse aggegated hint_dialplan to search for a match with lineName
+ * \brief Check whether a line is already indexed for this hint (sccp_hashtable_foreach_key callback)
+ */
+static void sccp_hint_isIndexed_cb(void *value, void *data)
+{
+	struct sccp_hint_isIndexed *lookup = (struct sccp_hint_isIndexed *) data;
+
+	if (value == lookup->hint) {
+		lookup->found = TRUE;
+	}
+}
+
+/*!
+ * \brief parse the aggregated hint_dialplan once and add the hint to sccp_hint_lineIndex for every SCCP line it references
  *
  * \note: We need to be able to parse a hint like this:
  * exten => 112,hint, SIP/123&Meetme:444&SCCP/98011&SCCP/98031&Custom:DND112,CustomPresence:112,Meetme:444
- * and match on the lineName we are looking for, i.e.: SCCP/98011 and SCCP/98031
+ * and index it under the lineNames it refers to, i.e.: SCCP/98011 and SCCP/98031
+ * \note called with sccp_hint_subscriptions locked
  */
-static boolean_t sccp_match_dialplan2lineName(char *hint_app, char *lineName)
+static void sccp_hint_indexLines(sccp_hint_list_t * hint)
 {
-	char *rest = strdupa(hint_app);
-        char *cur;
-        char *tmp;
-
-        // get the device portion of the hint string
-        if ((tmp = strrchr(rest, ','))) {
-                *tmp = '\0';
-        }
-        
-        // check for match for aggregated entry
-        while ((cur = strsep(&rest, "&"))) {
-        	if (sccp_strcaseequals(cur, lineName)) {
-			//sccp_log((DEBUGCAT_HINT)) (VERBOSE_PREFIX_3 "SCCP: (parse_hint_device) cur:%s matches lineName:%s\n", cur, lineName);
-        		return TRUE;
-        	}
-        }
-        return FALSE;
+	char *rest = strdupa(hint->hint_dialplan);
+	char *cur;
+	char *tmp;
+	struct sccp_hint_isIndexed lookup = { hint, FALSE };
+
+	// get the device portion of the hint string
+	if ((tmp = strrchr(rest, ','))) {
+		*tmp = '\0';
+	}
+
+	// index every sccp line in the aggregated entry (only once per hint)
+	while ((cur = strsep(&rest, "&"))) {
+		if (strncasecmp(cur, "SCCP/", 5) || sccp_strlen_zero(cur + 5)) {
+			continue;
+		}
+		lookup.found = FALSE;
+		sccp_hashtable_foreach_key(sccp_hint_lineIndex, cur, sccp_hint_isIndexed_cb, &lookup);
+		if (lookup.found) {
+			continue;
+		}
+		sccp_log((DEBUGCAT_HINT)) (VERBOSE_PREFIX_4 "SCCP: (sccp_hint_indexLines) indexing hint %s@%s under %s\n", hint->exten, hint->context, cur);
+		sccp_hashtable_insert(sccp_hint_lineIndex, cur, hint);
+	}
 }
 
 /*
@@ -1374,10 +1603,65 @@ static boolean_t sccp_match_dialplan2lineName(char *hint_app, char *lineName)
  *   -> number/name has changed, but state stayed the same -> notifySubscribers			(shortcut)
  *   -> state changed -> sccp_hint_notifySubscribersViaPbx -> PBX -> sccp_hint_distributed_devstate_cb -> notifySubscribers
  */
+struct sccp_hint_lineStateUpdate {
+	struct sccp_hint_lineState *lineState;
+	char *lineName;
+	enum ast_device_state newDeviceState;
+};
+
+/*!
+ * \brief Update a single hint that references the line which changed state (sccp_hashtable_foreach_key callback)
+ */
+static void sccp_hint_notifyLineStateUpdate4Hint(void *value, void *data)
+{
+	sccp_hint_list_t *hint = (sccp_hint_list_t *) value;
+	struct sccp_hint_lineStateUpdate *update = (struct sccp_hint_lineStateUpdate *) data;
+	struct sccp_hint_lineState *lineState = update->lineState;
+	enum ast_device_state newDeviceState = update->newDeviceState;
+	enum ast_device_state oldDeviceState = AST_DEVICE_UNKNOWN;
+
+	sccp_log((DEBUGCAT_HINT)) (VERBOSE_PREFIX_4 "SCCP: (sccp_hint_notifyLineStateUpdate) matched lineName:%s to dialplan:%s\n", update->lineName, hint->hint_dialplan);
+
+	hint->calltype = lineState->callInfo.calltype;
+	if (hint->calltype == SKINNY_CALLTYPE_INBOUND) {
+		iCallInfo.Setter(hint->callInfo, 
+			SCCP_CALLINFO_CALLINGPARTY_NAME, lineState->callInfo.partyName,
+			SCCP_CALLINFO_CALLINGPARTY_NUMBER, lineState->callInfo.partyNumber,
+			SCCP_CALLINFO_KEY_SENTINEL);
+	} else {
+		iCallInfo.Setter(hint->callInfo, 
+			SCCP_CALLINFO_CALLEDPARTY_NAME, lineState->callInfo.partyName,
+			SCCP_CALLINFO_CALLEDPARTY_NUMBER, lineState->callInfo.partyNumber,
+			SCCP_CALLINFO_KEY_SENTINEL);
+	}
+	oldDeviceState = sccp_hint_hint2DeviceState(hint->currentState);
+
+	sccp_log((DEBUGCAT_HINT)) (VERBOSE_PREFIX_3 "SCCP: (sccp_hint_notifyLineStateUpdate) Notify asterisk to set state to sccp channelstate '%s' (%d) on line '%s'\n", sccp_channelstate2str(lineState->state), lineState->state, update->lineName);
+	sccp_log((DEBUGCAT_HINT)) (VERBOSE_PREFIX_3 "SCCP: (sccp_hint_notifyLineStateUpdate) => asterisk: '%s' (%d) => '%s' (%d) on line %s\n", pbxsccp_devicestate2str(oldDeviceState), oldDeviceState, pbxsccp_devicestate2str(newDeviceState), newDeviceState, update->lineName);
+	if (newDeviceState == oldDeviceState) {
+		sccp_hint_notifySubscribersCoalesced(hint);							/* shortcut to inform sccp subscribers about cid update changes only */
+	} else {
+		sccp_hint_notifySubscribersViaPbx(hint, lineState, update->lineName, newDeviceState);		/* go through pbx to inform subscribers about both state and cid */
+	}
+}
+
+/*
+ * \brief Notify Line Status Update either directly or via PBX(including distributed devstate)
+ * \param lineState SCCP LineState
+ * \nore:
+ * - notifyLineStateUpdate
+ *   -> number/name has changed, but state stayed the same -> notifySubscribers			(shortcut)
+ *   -> state changed -> sccp_hint_notifySubscribersViaPbx -> PBX -> sccp_hint_distributed_devstate_cb -> notifySubscribers
+ * - only the hints referencing this line are visited, using sccp_hint_lineIndex
+ */
 static void sccp_hint_notifyLineStateUpdate(struct sccp_hint_lineState *lineState)
 {
-	sccp_hint_list_t *hint = NULL;
 	char lineName[StationMaxNameSize + 5];
+	struct sccp_hint_lineStateUpdate update = {
+		.lineState = lineState,
+		.lineName = lineName,
+		.newDeviceState = sccp_hint_hint2DeviceState(lineState->state),
+	};
 
 	{
 		AUTO_RELEASE sccp_line_t *line = lineState->line ? sccp_line_retain(lineState->line) : NULL;
@@ -1387,42 +1671,12 @@ static void sccp_hint_notifyLineStateUpdate(struct sccp_hint_lineState *lineStat
 			return;
 		}
 	}
-	enum ast_device_state newDeviceState = sccp_hint_hint2DeviceState(lineState->state);
-	enum ast_device_state oldDeviceState = AST_DEVICE_UNKNOWN;
 
-	/* Local Update */
+	/* Local Update, do not stop after the first match, but update all matching hints */
  	SCCP_LIST_LOCK(&sccp_hint_subscriptions);
-	SCCP_LIST_TRAVERSE(&sccp_hint_subscriptions, hint, list) {
-		if (!sccp_strlen_zero(hint->hint_dialplan) && sccp_match_dialplan2lineName(hint->hint_dialplan, lineName)) {
-			sccp_log((DEBUGCAT_HINT)) (VERBOSE_PREFIX_4 "SCCP: (sccp_hint_notifyLineStateUpdate) matched lineName:%s to dialplan:%s\n", lineName, hint->hint_dialplan);
-
-			hint->calltype = lineState->callInfo.calltype;
-			if (hint->calltype == SKINNY_CALLTYPE_INBOUND) {
-				iCallInfo.Setter(hint->callInfo, 
-					SCCP_CALLINFO_CALLINGPARTY_NAME, lineState->callInfo.partyName,
-					SCCP_CALLINFO_CALLINGPARTY_NUMBER, lineState->callInfo.partyNumber,
-					SCCP_CALLINFO_KEY_SENTINEL);
-			} else {
-				iCallInfo.Setter(hint->callInfo, 
-					SCCP_CALLINFO_CALLEDPARTY_NAME, lineState->callInfo.partyName,
-					SCCP_CALLINFO_CALLEDPARTY_NUMBER, lineState->callInfo.partyNumber,
-					SCCP_CALLINFO_KEY_SENTINEL);
-			}
-			oldDeviceState = sccp_hint_hint2DeviceState(hint->currentState);
-
-			sccp_log((DEBUGCAT_HINT)) (VERBOSE_PREFIX_3 "SCCP: (sccp_hint_notifyLineStateUpdate) Notify asterisk to set state to sccp channelstate '%s' (%d) on line 'SCCP/%s'\n", sccp_channelstate2str(lineState->state), lineState->state, lineState->line->name);
-			sccp_log((DEBUGCAT_HINT)) (VERBOSE_PREFIX_3 "SCCP: (sccp_hint_notifyLineStateUpdate) => asterisk: '%s' (%d) => '%s' (%d) on line SCCP/%s\n", pbxsccp_devicestate2str(oldDeviceState), oldDeviceState, pbxsccp_devicestate2str(newDeviceState), newDeviceState, lineState->line->name);
-			if (newDeviceState == oldDeviceState) {
-				sccp_hint_notifySubscribers(hint);								/* shortcut to inform sccp subscribers about cid update changes only */
-			} else {
-				sccp_hint_notifySubscribersViaPbx(hint, lineState, lineName, newDeviceState);			/* go through pbx to inform subscribers about both state and cid */
-			}
-			
-			/*! note: do not break after the first match, but update all matching hints */
-		}
-	}
+	sccp_hashtable_foreach_key(sccp_hint_lineIndex, lineName, sccp_hint_notifyLineStateUpdate4Hint, &update);
 	SCCP_LIST_UNLOCK(&sccp_hint_subscriptions);
-	sccp_log((DEBUGCAT_HINT)) (VERBOSE_PREFIX_3 "SCCP: (sccp_hint_notifyLineStateUpdate) Notified asterisk to set state to sccp channelstate '%s' (%d) => asterisk: '%s' (%d) on channel SCCP/%s\n", sccp_channelstate2str(lineState->state), lineState->state, pbxsccp_devicestate2str(newDeviceState), newDeviceState, lineState->line->name);
+	sccp_log((DEBUGCAT_HINT)) (VERBOSE_PREFIX_3 "SCCP: (sccp_hint_notifyLineStateUpdate) Notified asterisk to set state to sccp channelstate '%s' (%d) => asterisk: '%s' (%d) on channel %s\n", sccp_channelstate2str(lineState->state), lineState->state, pbxsccp_devicestate2str(update.newDeviceState), update.newDeviceState, lineName);
 }
 
 /* ========================================================================================================================= Helper Functions */
@@ -1480,22 +1734,30 @@ static void sccp_hint_checkForDND(struct sccp_hint_lineState *lineState)
 	}
 }
 
+/*!
+ * \brief copy the state of the lineState found in sccp_hint_lineStateIndex (sccp_hashtable_foreach_key callback)
+ * \note called with the hashtable bucket read-locked, which keeps detachLine from freeing the lineState underneath us
+ */
+static void sccp_hint_getLinestate_cb(void *value, void *data)
+{
+	struct sccp_hint_lineState *lineState = (struct sccp_hint_lineState *) value;
+	sccp_channelstate_t *state = (sccp_channelstate_t *) data;
+
+	if (lineState->line) {
+		sccp_log(DEBUGCAT_HINT)(VERBOSE_PREFIX_3 "%s (getLinestate) state:%s, party:%s/%s, calltype:%s\n", lineState->line->name, sccp_channelstate2str(lineState->state),
+			lineState->callInfo.partyNumber,lineState->callInfo.partyName,
+			(!SCCP_CHANNELSTATE_Idling(lineState->state) && lineState->callInfo.calltype) ? skinny_calltype2str(lineState->callInfo.calltype) : "INACTIVE");
+		*state = lineState->state;
+	}
+}
+
 sccp_channelstate_t sccp_hint_getLinestate(const char *linename, const char *deviceId)
 {
-	struct sccp_hint_lineState *lineState = NULL;
 	sccp_channelstate_t state = SCCP_CHANNELSTATE_CONGESTION;
 
-	SCCP_LIST_LOCK(&lineStates);
-	SCCP_LIST_TRAVERSE(&lineStates, lineState, list) {
-		if (lineState->line && sccp_strcaseequals(lineState->line->name, linename)) {
-                	sccp_log(DEBUGCAT_HINT)(VERBOSE_PREFIX_3 "%s (getLinestate) state:%s, party:%s/%s, calltype:%s\n", lineState->line->name, sccp_channelstate2str(lineState->state),
-                	        lineState->callInfo.partyNumber,lineState->callInfo.partyName,
-                	        (!SCCP_CHANNELSTATE_Idling(lineState->state) && lineState->callInfo.calltype) ? skinny_calltype2str(lineState->callInfo.calltype) : "INACTIVE");
-                        state = lineState->state;
-			break;
-		}
+	if (!sccp_strlen_zero(linename)) {
+		sccp_hashtable_foreach_key(sccp_hint_lineStateIndex, linename, sccp_hint_getLinestate_cb, &state);
 	}
-	SCCP_LIST_UNLOCK(&lineStates);
 	return state;
 }
 
@@ -1590,7 +1852,9 @@ int sccp_show_hint_subscriptions(int fd, sccp_cli_totals_t *totals, struct manse
  		CLI_AMI_TABLE_FIELD(CallInfoNumber,	"-15.15",	s,	15,	cidNumber)			\
  		CLI_AMI_TABLE_FIELD(CallInfoName,	"-30.30",	s,	30,	cidName)			\
  		CLI_AMI_TABLE_FIELD(Direction,		"-10.10",	s,	10,	(subscription->calltype && subscription->calltype != SKINNY_CALLTYPE_SENTINEL) ? skinny_calltype2str(subscription->calltype) : "") \
- 		CLI_AMI_TABLE_FIELD(Subs,		"-4",		d,	4,	SCCP_LIST_GETSIZE(&subscription->subscribers))
+ 		CLI_AMI_TABLE_FIELD(Subs,		"-4",		d,	4,	SCCP_LIST_GETSIZE(&subscription->subscribers))		\
+ 		CLI_AMI_TABLE_FIELD(Sent,		"-8",		u,	8,	subscription->sentUpdates)				\
+ 		CLI_AMI_TABLE_FIELD(Suppressed,		"-10",		u,	10,	subscription->suppressedUpdates)
 
 #include "sccp_cli_table.h"
 
@@ -17,6 +17,7 @@
 #include "sccp_device.h"
 #include "sccp_indicate.h"
 #include "sccp_line.h"
+#include "sccp_session.h"
 #include "sccp_utils.h"
 
 SCCP_FILE_VERSION(__FILE__, "");
@@ -78,6 +79,8 @@ void __sccp_indicate(const sccp_device_t * const device, sccp_channel_t * const
 	sccp_channel_setChannelstate(c, state);
 	sccp_callinfo_t * const ci = sccp_channel_getCallInfo(c);
 
+	sccp_session_corkDevice(d);										/* send the messages belonging to this transition in one go */
+
 	switch (state) {
 		case SCCP_CHANNELSTATE_DOWN:
 			//iPbx.set_callstate(c, AST_STATE_DOWN);
@@ -413,6 +416,7 @@ void __sccp_indicate(const sccp_device_t * const device, sccp_channel_t * const
 			sccp_log((DEBUGCAT_INDICATE)) (VERBOSE_PREFIX_3 "%s: SCCP_CHANNELSTATE:default  %s (%d) -> %s (%d)\n", d->id, sccp_channelstate2str(c->previousChannelState), c->previousChannelState, sccp_channelstate2str(c->state), c->state);
 			break;
 	}
+	sccp_session_uncorkDevice(d);
 
 	/* if channel state has changed, notify the others */
 	if (c->state != c->previousChannelState) {
@@ -99,7 +99,7 @@ void sccp_line_post_reload(void)
 				SCCP_LIST_TRAVERSE(&GLOB(devices), d, list) {
 					SCCP_LIST_LOCK(&d->buttonconfig);
 					SCCP_LIST_TRAVERSE(&d->buttonconfig, buttonconfig, list) {
-						if (buttonconfig->type == LINE && !sccp_strlen_zero(buttonconfig->button.line.name) && !sccp_strequals(line->name, buttonconfig->button.line.name) ) {
+						if (buttonconfig->type == LINE && !sccp_strlen_zero(buttonconfig->button.line.name) && sccp_strequals(line->name, buttonconfig->button.line.name) ) {
 							d->pendingUpdate = TRUE;
 						}
 					}
@@ -171,6 +171,7 @@ void sccp_line_addToGlobals(sccp_line_t * line)
 		/* add to list */
 		sccp_line_retain(l);										/* add retained line to the list */
 		SCCP_RWLIST_INSERT_SORTALPHA(&GLOB(lines), l, list, cid_num);
+		sccp_hashtable_insert(GLOB(line_index), l->name, l);
 		sccp_log((DEBUGCAT_CORE)) (VERBOSE_PREFIX_3 "Added line '%s' to Glob(lines)\n", l->name);
 
 		/* emit event */
@@ -197,6 +198,7 @@ void sccp_line_removeFromGlobals(sccp_line_t * line)
 	if (line) {
 		SCCP_RWLIST_WRLOCK(&GLOB(lines));
 		removed_line = SCCP_RWLIST_REMOVE(&GLOB(lines), line, list);
+		sccp_hashtable_remove(GLOB(line_index), removed_line->name, removed_line);
 		SCCP_RWLIST_UNLOCK(&GLOB(lines));
 
 		sccp_log((DEBUGCAT_CORE)) (VERBOSE_PREFIX_3 "Removed line '%s' from Glob(lines)\n", removed_line->name);
@@ -705,6 +707,7 @@ void sccp_line_removeChannel(sccp_line_t * line, sccp_channel_t * channel)
 		SCCP_LIST_LOCK(&l->channels);
 		if ((c = SCCP_LIST_REMOVE(&l->channels, channel, list))) {
 			sccp_log((DEBUGCAT_LINE)) (VERBOSE_PREFIX_1 "SCCP: Removing channel %d from line %s\n", c->callid, l->name);
+			sccp_channel_removeFromIndexes(c);
 			sccp_channel_release(&c);					/* explicit release of channel from list */
 		}
 		SCCP_LIST_UNLOCK(&l->channels);
@@ -849,9 +852,7 @@ sccp_line_t *sccp_line_find_byname(const char *name, uint8_t useRealtime)
 {
 	sccp_line_t *l = NULL;
 
-	SCCP_RWLIST_RDLOCK(&GLOB(lines));
-	l = SCCP_RWLIST_FIND(&GLOB(lines), sccp_line_t, tmpl, list, (sccp_strcaseequals(tmpl->name, name)), TRUE, __FILE__, __LINE__, __PRETTY_FUNCTION__);
-	SCCP_RWLIST_UNLOCK(&GLOB(lines));
+	l = sccp_hashtable_find_retained(GLOB(line_index), name);						/* GLOB(lines) is kept for ordered (cli) traversal */
 #ifdef CS_SCCP_REALTIME
 	if (!l && useRealtime) {
 		l = sccp_line_find_realtime_byname(name);
@@ -902,7 +903,7 @@ sccp_line_t *sccp_line_find_realtime_byname(const char *name)
 		return NULL;
 	}
 
-	if ((variable = pbx_load_realtime(GLOB(realtimelinetable), "name", name, NULL))) {
+	if ((variable = sccp_config_realtimecache_load(GLOB(realtimelinetable), name))) {
 		v = variable;
 		sccp_log((DEBUGCAT_LINE + DEBUGCAT_REALTIME)) (VERBOSE_PREFIX_3 "SCCP: Line '%s' found in realtime table '%s'\n", name, GLOB(realtimelinetable));
 
@@ -912,6 +913,7 @@ sccp_line_t *sccp_line_find_realtime_byname(const char *name)
 		if ((l = sccp_line_create(name))) {								/* already retained */
 			sccp_config_applyLineConfiguration(l, variable);
 			l->realtime = TRUE;
+			l->configHash = sccp_config_hashCategory(variable);					/* skip this row on reload, as long as it does not change */
 			sccp_line_addToGlobals(l);								// can return previous instance on doubles
 			pbx_variables_destroy(v);
 		} else {
@@ -97,6 +97,7 @@ struct sccp_line {
 	/* this is for reload routines */
 	boolean_t pendingDelete;										/*!< this bit will tell the scheduler to delete this line when unused */
 	boolean_t pendingUpdate;										/*!< this bit will tell the scheduler to update this line when unused */
+	uint32_t configHash;											/*!< hash of the sccp.conf section this line was last built from (0 = none) */
 };														/*!< SCCP Line Structure */
 
 /*!
@@ -41,6 +41,9 @@ static char management_startcall_desc[] = "Description: start a new call on a de
 static char management_answercall_desc[] = "Description: answer a ringing channel. (DEPRECATED in favor of SCCPAnswerCall1)\n" "\n" "Variables:\n" "  Devicename: Name of the Device\n" "  channelId: Id of the channel to pickup\n";
 static char management_hangupcall_desc[] = "Description: hangup a channel/call\n" "\n" "Variables:\n" "  channelId: Id of the Channel to hangup\n";
 static char management_hold_desc[] = "Description: hold/resume a call\n" "\n" "Variables:\n" "  channelId: Id of the channel to hold/unhold\n" "  hold: hold=true / resume=false\n" "  Devicename: Name of the Device\n" "  SwapChannels: Swap channels when resuming and an active channel is present (true/false)\n";
+#ifdef CS_SCCP_REALTIME
+static char management_flush_realtime_cache_desc[] = "Description: forget all cached realtime device/line lookups, so that changes in the database are picked up immediately\n";
+#endif
 
 void sccp_manager_eventListener(const sccp_event_t * event);
 
@@ -58,6 +61,9 @@ static int sccp_manager_startCall(struct mansession *s, const struct message *m)
 static int sccp_manager_answerCall2(struct mansession *s, const struct message *m);
 static int sccp_manager_hangupCall(struct mansession *s, const struct message *m);
 static int sccp_manager_holdCall(struct mansession *s, const struct message *m);
+#ifdef CS_SCCP_REALTIME
+static int sccp_manager_flush_realtime_cache(struct mansession *s, const struct message *m);
+#endif
 
 #if HAVE_PBX_MANAGER_HOOK_H
 static int sccp_asterisk_managerHookHelper(int category, const char *event, char *content);
@@ -95,6 +101,9 @@ int sccp_register_management(void)
 	result |= pbx_manager_register("SCCPHangupCall", _MAN_FLAGS, sccp_manager_hangupCall, "hangup a channel", management_hangupcall_desc);
 	result |= pbx_manager_register("SCCPHoldCall", _MAN_FLAGS, sccp_manager_holdCall, "hold/unhold a call", management_hold_desc);
 	result |= pbx_manager_register("SCCPConfigMetaData", _MAN_FLAGS, sccp_manager_config_metadata, "retrieve config metadata in json format", management_fetch_config_metadata_desc);
+#ifdef CS_SCCP_REALTIME
+	result |= pbx_manager_register("SCCPFlushRealtimeCache", _MAN_FLAGS, sccp_manager_flush_realtime_cache, "flush cached realtime lookups", management_flush_realtime_cache_desc);
+#endif
 #undef _MAN_FLAGS
 
 #if HAVE_PBX_MANAGER_HOOK_H
@@ -125,6 +134,9 @@ int sccp_unregister_management(void)
 	result |= pbx_manager_unregister("SCCPHangupCall");
 	result |= pbx_manager_unregister("SCCPHoldCall");
 	result |= pbx_manager_unregister("SCCPConfigMetaData");
+#ifdef CS_SCCP_REALTIME
+	result |= pbx_manager_unregister("SCCPFlushRealtimeCache");
+#endif
 #if HAVE_PBX_MANAGER_HOOK_H
 	ast_manager_unregister_hook(&sccp_manager_hook);
 #endif
@@ -769,6 +781,23 @@ static int sccp_manager_hangupCall(struct mansession *s, const struct message *m
 	return 0;
 }
 
+#ifdef CS_SCCP_REALTIME
+/*!
+ * \brief Flush the Realtime Lookup Cache
+ * \param s Management Session
+ * \param m Message
+ * \return Success as int
+ *
+ * \called_from_asterisk
+ */
+static int sccp_manager_flush_realtime_cache(struct mansession *s, const struct message *m)
+{
+	sccp_config_realtimecache_flush();
+	astman_send_ack(s, m, "Realtime cache flushed");
+	return 0;
+}
+#endif
+
 /*!
  * \brief Put ChannelId Call on Hold (on/off)
  * \param s Management Session
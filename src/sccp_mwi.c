@@ -13,7 +13,9 @@
 #include "sccp_atomic.h"
 #include "sccp_channel.h"
 #include "sccp_line.h"
+#include "sccp_session.h"
 #include "sccp_utils.h"
+#include "sccp_vector.h"
 
 SCCP_FILE_VERSION(__FILE__, "");
 
@@ -27,6 +29,7 @@ SCCP_FILE_VERSION(__FILE__, "");
 #ifndef CS_AST_HAS_EVENT
 #define SCCP_MWI_CHECK_INTERVAL 30
 #endif
+#define SCCP_MWI_MAILBOX_SIZE 60
 
 /*!
  * \brief SCCP Mailbox Line Type Definition
@@ -59,8 +62,8 @@ typedef struct sccp_mailbox_subscriber_list sccp_mailbox_subscriber_list_t;
  * Each line that holds a subscription for this mailbox is listed in
  */
 struct sccp_mailbox_subscriber_list {
-	char mailbox[60];
-	char context[60];
+	char mailbox[SCCP_MWI_MAILBOX_SIZE];
+	char context[SCCP_MWI_MAILBOX_SIZE];
 
 	SCCP_LIST_HEAD (, sccp_mailboxLine_t) sccp_mailboxLine;
 	SCCP_LIST_ENTRY (sccp_mailbox_subscriber_list_t) list;
@@ -92,6 +95,7 @@ struct sccp_mailbox_subscriber_list {
 };																/*!< SCCP Mailbox Subscriber List Structure */
 
 void sccp_mwi_setMWILineStatus(sccp_linedevices_t * lineDevice);
+static void sccp_mwi_setMWILineIcon(sccp_linedevices_t * lineDevice);
 void sccp_mwi_destroySubscription(sccp_mailbox_subscriber_list_t *subscription);
 void sccp_mwi_linecreatedEvent(const sccp_event_t * event);
 void sccp_mwi_deviceAttachedEvent(const sccp_event_t * event);
@@ -99,6 +103,19 @@ void sccp_mwi_addMailboxSubscription(char *mailbox, char *context, sccp_line_t *
 void sccp_mwi_lineStatusChangedEvent(const sccp_event_t * event);
 
 static SCCP_LIST_HEAD (, sccp_mailbox_subscriber_list_t) sccp_mailbox_subscriptions;
+static sccp_hashtable_t *sccp_mailbox_index = NULL;							/* mailbox@context -> subscription, case-sensitive */
+static sccp_mutex_t sccp_mwi_pending_lock;									/* protects device->mwiUpdatePending */
+
+SCCP_VECTOR(sccp_mwi_devicelist, sccp_device_t *);
+
+/*!
+ * \brief Build the key used to index a subscription (mailbox@context)
+ * \note mailbox and context are truncated the same way they are when stored in the subscription
+ */
+static void sccp_mwi_mailboxKey(char *buf, size_t buflen, const char *mailbox, const char *context)
+{
+	snprintf(buf, buflen, "%.*s@%.*s", SCCP_MWI_MAILBOX_SIZE - 1, mailbox, SCCP_MWI_MAILBOX_SIZE - 1, context);
+}
 
 /*!
  * start mwi module.
@@ -106,6 +123,8 @@ static SCCP_LIST_HEAD (, sccp_mailbox_subscriber_list_t) sccp_mailbox_subscripti
 void sccp_mwi_module_start(void)
 {
 	SCCP_LIST_HEAD_INIT(&sccp_mailbox_subscriptions);
+	sccp_mailbox_index = sccp_hashtable_create("mwi_mailboxes", SCCP_HASH_PRIME, SCCP_HASHTABLE_KEY_STRING);
+	sccp_mutex_init(&sccp_mwi_pending_lock);
 	sccp_log((DEBUGCAT_CORE)) (VERBOSE_PREFIX_2 "SCCP: Starting MWI system\n");
 
 	sccp_event_subscribe(SCCP_EVENT_LINE_CREATED, sccp_mwi_linecreatedEvent, TRUE);
@@ -131,17 +150,78 @@ void sccp_mwi_module_stop(void)
 	}
 	SCCP_LIST_UNLOCK(&sccp_mailbox_subscriptions);
 	SCCP_LIST_HEAD_DESTROY(&sccp_mailbox_subscriptions);
+	sccp_hashtable_destroy(&sccp_mailbox_index);
+	sccp_mutex_destroy(&sccp_mwi_pending_lock);
+}
+
+/*!
+ * \brief Mark device as needing an mwi recalculation
+ * \param device SCCP Device
+ * \param dirtyDevices list of devices marked by this caller, the device is added retained
+ *
+ * Devices that are already pending are skipped, the caller that marked them first will do the update. Because the
+ * pending flag is cleared before the line statistics are read, a counter change made before marking is never lost.
+ */
+static void sccp_mwi_markDevicePending(sccp_device_t * device, struct sccp_mwi_devicelist *dirtyDevices)
+{
+	sccp_mutex_lock(&sccp_mwi_pending_lock);
+	if (!device->mwiUpdatePending) {
+		sccp_device_t *d = sccp_device_retain(device);
+		if (d) {
+			if (SCCP_VECTOR_APPEND(dirtyDevices, d) == 0) {
+				d->mwiUpdatePending = TRUE;
+			} else {
+				pbx_log(LOG_ERROR, SS_Memory_Allocation_Error, DEV_ID_LOG(d));
+				sccp_device_release(&d);							/* explicit release */
+			}
+		}
+	}
+	sccp_mutex_unlock(&sccp_mwi_pending_lock);
+}
+
+/*!
+ * \brief Recalculate the line icons and the device mwi light in one go
+ * \param device SCCP Device
+ */
+static void sccp_mwi_updateDevice(sccp_device_t * device)
+{
+	uint32_t instance = 0;
+
+	sccp_mutex_lock(&sccp_mwi_pending_lock);
+	device->mwiUpdatePending = FALSE;
+	sccp_mutex_unlock(&sccp_mwi_pending_lock);
+
+	sccp_session_corkDevice(device);									/* send all lamp messages for this device in one go */
+	for (instance = SCCP_FIRST_LINEINSTANCE; instance < device->lineButtons.size; instance++) {
+		if (device->lineButtons.instance[instance] && device->lineButtons.instance[instance]->line) {
+			sccp_mwi_setMWILineIcon(device->lineButtons.instance[instance]);
+		}
+	}
+	if (sccp_device_getRegistrationState(device) == SKINNY_DEVICE_RS_OK) {
+		sccp_mwi_check(device);
+	}
+	sccp_session_uncorkDevice(device);
 }
 
 /*!
  * \brief Generic update mwi count
  * \param subscription Pointer to a mailbox subscription
+ *
+ * \note First all line statistics are updated and the devices on those lines are collected, after which every
+ * affected device is recalculated once, even if it shares several of the lines using this mailbox.
  */
 static void sccp_mwi_updatecount(sccp_mailbox_subscriber_list_t * subscription)
 {
 	sccp_mailboxLine_t *mailboxLine = NULL;
+	struct sccp_mwi_devicelist dirtyDevices;
+	sccp_device_t *device = NULL;
+	size_t idx = 0;
 
 	sccp_log((DEBUGCAT_MWI)) (VERBOSE_PREFIX_3 "(sccp_mwi_updatecount)\n");
+	if (SCCP_VECTOR_INIT(&dirtyDevices, 8) != 0) {
+		pbx_log(LOG_ERROR, SS_Memory_Allocation_Error, "SCCP");
+		return;
+	}
 	SCCP_LIST_LOCK(&subscription->sccp_mailboxLine);
 	SCCP_LIST_TRAVERSE(&subscription->sccp_mailboxLine, mailboxLine, list) {
 		AUTO_RELEASE sccp_line_t *line = sccp_line_retain(mailboxLine->line);
@@ -158,11 +238,11 @@ static void sccp_mwi_updatecount(sccp_mailbox_subscriber_list_t * subscription)
 			/* done */
 			sccp_log((DEBUGCAT_MWI)) (VERBOSE_PREFIX_3 "%s:(sccp_mwi_updatecount) newmsgs:%d, oldmsgs:%d\n", line->name, line->voicemailStatistic.newmsgs, line->voicemailStatistic.oldmsgs);
 
-			/* notify each device on line */
+			/* collect each device on line */
 			SCCP_LIST_LOCK(&line->devices);
 			SCCP_LIST_TRAVERSE(&line->devices, lineDevice, list) {
 				if (lineDevice && lineDevice->device) {
-					sccp_mwi_setMWILineStatus(lineDevice);
+					sccp_mwi_markDevicePending(lineDevice->device, &dirtyDevices);
 				} else {
 					pbx_log(LOG_ERROR, "error: null line device.\n");
 				}
@@ -171,6 +251,15 @@ static void sccp_mwi_updatecount(sccp_mailbox_subscriber_list_t * subscription)
 		}
 	}
 	SCCP_LIST_UNLOCK(&subscription->sccp_mailboxLine);
+
+	/* notify each device once */
+	sccp_log((DEBUGCAT_MWI)) (VERBOSE_PREFIX_3 "%s@%s: (sccp_mwi_updatecount) updating %d device(s)\n", subscription->mailbox, subscription->context, (int) SCCP_VECTOR_SIZE(&dirtyDevices));
+	for (idx = 0; idx < SCCP_VECTOR_SIZE(&dirtyDevices); idx++) {
+		device = SCCP_VECTOR_GET(&dirtyDevices, idx);
+		sccp_mwi_updateDevice(device);
+		sccp_device_release(&device);									/* explicit release */
+	}
+	SCCP_VECTOR_FREE(&dirtyDevices);
 }
 
 #if defined(CS_AST_HAS_EVENT)
@@ -335,11 +424,14 @@ void sccp_mwi_unsubscribeMailbox(sccp_mailbox_t * mailbox)
 
 	sccp_log((DEBUGCAT_MWI)) (VERBOSE_PREFIX_2 "SCCP: unsubscribe mailbox: %s@%s\n", mailbox->mailbox, mailbox->context);
 	sccp_mailbox_subscriber_list_t *subscription = NULL;
+	char key[SCCP_MWI_MAILBOX_SIZE * 2];
 
 	SCCP_LIST_LOCK(&sccp_mailbox_subscriptions);
 	SCCP_LIST_TRAVERSE_SAFE_BEGIN(&sccp_mailbox_subscriptions, subscription, list) {
 		if (sccp_strequals(mailbox->mailbox, subscription->mailbox) && sccp_strequals(mailbox->context, subscription->context)) {
 			SCCP_LIST_REMOVE_CURRENT(list);
+			sccp_mwi_mailboxKey(key, sizeof(key), subscription->mailbox, subscription->context);
+			sccp_hashtable_remove(sccp_mailbox_index, key, subscription);
 			sccp_mwi_destroySubscription(subscription);
 		}
 	}
@@ -446,13 +538,11 @@ void sccp_mwi_addMailboxSubscription(char *mailbox, char *context, sccp_line_t *
 	}
 	sccp_mailbox_subscriber_list_t *subscription = NULL;
 	sccp_mailboxLine_t *mailboxLine = NULL;
+	char key[SCCP_MWI_MAILBOX_SIZE * 2];
 
+	sccp_mwi_mailboxKey(key, sizeof(key), mailbox, context);
 	SCCP_LIST_LOCK(&sccp_mailbox_subscriptions);
-	SCCP_LIST_TRAVERSE(&sccp_mailbox_subscriptions, subscription, list) {
-		if (sccp_strequals(mailbox, subscription->mailbox) && sccp_strequals(context, subscription->context)) {
-			break;
-		}
-	}
+	subscription = sccp_hashtable_find(sccp_mailbox_index, key);
 	SCCP_LIST_UNLOCK(&sccp_mailbox_subscriptions);
 
 	if (!subscription) {
@@ -469,6 +559,7 @@ void sccp_mwi_addMailboxSubscription(char *mailbox, char *context, sccp_line_t *
 
 		SCCP_LIST_LOCK(&sccp_mailbox_subscriptions);
 		SCCP_LIST_INSERT_HEAD(&sccp_mailbox_subscriptions, subscription, list);
+		sccp_hashtable_insert(sccp_mailbox_index, key, subscription);
 		SCCP_LIST_UNLOCK(&sccp_mailbox_subscriptions);
 
 		/* get initial value */
@@ -556,10 +647,10 @@ void sccp_mwi_addMailboxSubscription(char *mailbox, char *context, sccp_line_t *
 }
 
 /*!
- * \brief Set MWI Line Status
+ * \brief Set MWI Line Icon, only sends a lamp message when the state for this line instance changed
  * \param lineDevice SCCP LineDevice
  */
-void sccp_mwi_setMWILineStatus(sccp_linedevices_t * lineDevice)
+static void sccp_mwi_setMWILineIcon(sccp_linedevices_t * lineDevice)
 {
 	pbx_assert(lineDevice != NULL && lineDevice->device != NULL);
 	
@@ -598,6 +689,19 @@ void sccp_mwi_setMWILineStatus(sccp_linedevices_t * lineDevice)
 	} else {
 		sccp_log((DEBUGCAT_MWI)) (VERBOSE_PREFIX_3 "%s: (mwi_setMWILineStatus) Device already knows this state %s on line %s (%d). skipping update\n", DEV_ID_LOG(d), status ? "ON" : "OFF", (l ? l->name : "unknown"), instance);
 	}
+}
+
+/*!
+ * \brief Set MWI Line Status
+ * \param lineDevice SCCP LineDevice
+ */
+void sccp_mwi_setMWILineStatus(sccp_linedevices_t * lineDevice)
+{
+	pbx_assert(lineDevice != NULL && lineDevice->device != NULL);
+
+	sccp_device_t *d = lineDevice->device;
+
+	sccp_mwi_setMWILineIcon(lineDevice);
 	if (sccp_device_getRegistrationState(d) == SKINNY_DEVICE_RS_OK) {
 		sccp_mwi_check(d); /* we need to check mwi status again, to enable/disable device mwi light */
 	}
@@ -42,6 +42,7 @@
 #include "sccp_atomic.h"
 #include "sccp_utils.h"
 #include <asterisk/cli.h>
+#include <asterisk/threadstorage.h>
 
 // required for refcount inuse checking
 #include "sccp_channel.h"
@@ -53,6 +54,7 @@ SCCP_FILE_VERSION(__FILE__, "");
 //nb: SCCP_HASH_PRIME defined in config.h, default 563
 #define SCCP_SIMPLE_HASH(_a) (((unsigned long)(_a)) % SCCP_HASH_PRIME)
 #define SCCP_LIVE_MARKER 13
+#define SCCP_REFCOUNT_MAGIC 0x5CC9F00D										// marks the header in front of every refcounted object
 #define REF_FILE "/tmp/sccp_refs"
 static enum sccp_refcount_runstate runState = SCCP_REF_STOPPED;
 
@@ -60,17 +62,19 @@ static struct sccp_refcount_obj_info {
 	int (*destructor) (const void *ptr);
 	char datatype[StationMaxDeviceNameSize];
 	sccp_debug_category_t debugcat;
+	uint32_t poolsize;											// number of released objects to keep per pool shard (0 = no pooling)
+	volatile CAS32_TYPE numObjects;										// number of objects of this type currently allocated
 } obj_info[] = {
 /* *INDENT-OFF* */
-	[SCCP_REF_PARTICIPANT] = {NULL, "participant", DEBUGCAT_CONFERENCE},
-	[SCCP_REF_CONFERENCE] = {NULL, "conference", DEBUGCAT_CONFERENCE},
-	[SCCP_REF_EVENT] = {NULL, "event", DEBUGCAT_EVENT},
-	[SCCP_REF_CHANNEL] = {NULL, "channel", DEBUGCAT_CHANNEL},
-	[SCCP_REF_LINEDEVICE] = {NULL, "linedevice", DEBUGCAT_LINE},
-	[SCCP_REF_LINE] = {NULL, "line", DEBUGCAT_LINE},
-	[SCCP_REF_DEVICE] = {NULL, "device", DEBUGCAT_DEVICE},
+	[SCCP_REF_PARTICIPANT] = {NULL, "participant", DEBUGCAT_CONFERENCE, 8},
+	[SCCP_REF_CONFERENCE] = {NULL, "conference", DEBUGCAT_CONFERENCE, 2},
+	[SCCP_REF_EVENT] = {NULL, "event", DEBUGCAT_EVENT, 32},
+	[SCCP_REF_CHANNEL] = {NULL, "channel", DEBUGCAT_CHANNEL, 0},					// not pooled: channels and linedevices are still looked up through
+	[SCCP_REF_LINEDEVICE] = {NULL, "linedevice", DEBUGCAT_LINE, 0},					// pointers held without a reference, which a reuse would silently redirect
+	[SCCP_REF_LINE] = {NULL, "line", DEBUGCAT_LINE, 0},
+	[SCCP_REF_DEVICE] = {NULL, "device", DEBUGCAT_DEVICE, 0},
 #if CS_TEST_FRAMEWORK
-	[SCCP_REF_TEST] = {NULL, "test", DEBUGCAT_HIGH},
+	[SCCP_REF_TEST] = {NULL, "test", DEBUGCAT_HIGH, 64},
 #endif
 /* *INDENT-ON* */
 };
@@ -79,38 +83,162 @@ typedef struct refcount_object RefCountedObject;
 
 #ifdef SCCP_ATOMIC
 #define obj_lock NULL
+#define obj_info_lock NULL
 #else
 #define	obj_lock &obj->lock
+AST_MUTEX_DEFINE_STATIC(__obj_info_lock);
+#define obj_info_lock &__obj_info_lock
 #endif
 
 struct refcount_object {
+	/* the fields in front of type survive pooling (see SCCP_REFCOUNT_RECYCLED), they are only ever changed atomically */
 #ifndef SCCP_ATOMIC
 	ast_mutex_t lock;
 #endif
 	volatile CAS32_TYPE refcount;
+	volatile CAS32_TYPE generation;										// bumped every time the object dies, a retain racing with the death/reuse of a pooled object notices the change
 	enum sccp_refcounted_types type;
 	char identifier[REFCOUNT_INDENTIFIER_SIZE];
 	int len;
 	int alive;
+	uint32_t magic;
+	RefCountedObject *nextFree;										// next released object on the pool free list
+#if CS_REFCOUNT_DEBUG
 	SCCP_RWLIST_ENTRY (RefCountedObject) list;
+#endif
 	unsigned char data[0] __attribute__((aligned(8)));
 };
 
+/* The object header sits directly in front of the data pointer handed out by sccp_refcount_object_alloc, so retain/release can get to it
+ * by pointer arithmetic. The objects hash table is only maintained in refcount debug builds, to be able to list all objects (leak checking) */
+#define SCCP_REFCOUNT_OBJ(_ptr) ((RefCountedObject *) ((unsigned char *) (_ptr) - offsetof(RefCountedObject, data)))
+#define SCCP_REFCOUNT_RECYCLED offsetof(RefCountedObject, type)							// start of the part of the object that is reset when it gets reused
 
+#if CS_REFCOUNT_DEBUG
 static ast_rwlock_t objectslock;										// general lock to modify hash table entries
 static struct refcount_objentry{
 	SCCP_RWLIST_HEAD (, RefCountedObject) refCountedObjects  __attribute__((aligned(8)));			//!< one rwlock per hash table entry, used to modify list
 } *objects[SCCP_HASH_PRIME];											//!< objects hash table
 
-#if CS_REFCOUNT_DEBUG
 static FILE *sccp_ref_debug_log;
 #endif
 
+/* Per type object pools: released objects are put on a free list and handed out again by sccp_refcount_object_alloc, instead of going back
+ * to the allocator. Every type has SCCP_REFCOUNT_POOL_SHARDS free lists and each thread sticks to one of them, so that threads releasing
+ * and allocating objects at the same time do not contend on a single lock. The number of objects kept per shard comes from obj_info[].poolsize.
+ * Only objects of the size first seen for a type are pooled. Pooled memory stays type-stable: a stale pointer to a pooled object still points
+ * at a refcount header, its refcount and generation fields are never reset, so sccp_refcount_retain can safely detect that the object died
+ * or got reused after it looked it up, and back out. */
+#define SCCP_REFCOUNT_POOL_SHARDS 8
+static struct sccp_refcount_pool {
+	sccp_mutex_t lock;											// protects objsize and highWater updates
+	size_t objsize;												// size of pooled objects (header included)
+	volatile CAS32_TYPE highWater;										// max number of objects allocated at the same time
+	struct sccp_refcount_pool_shard {
+		sccp_mutex_t lock;
+		RefCountedObject *freeList;
+		uint32_t numFree;
+		uint32_t hits;
+		uint32_t misses;
+	} shards[SCCP_REFCOUNT_POOL_SHARDS];
+} pools[ARRAY_LEN(obj_info)];
+AST_THREADSTORAGE(sccp_refcount_pool_shard_buf);
+static volatile CAS32_TYPE nextPoolShard = 0;
+
+static gcc_inline struct sccp_refcount_pool_shard *sccp_refcount_pool_getShard(enum sccp_refcounted_types type)
+{
+	int *shard = ast_threadstorage_get(&sccp_refcount_pool_shard_buf, sizeof(int));
+
+	if (do_expect(shard != NULL)) {
+		if (dont_expect(!*shard)) {									// first use by this thread, 0 means unassigned
+			*shard = (ATOMIC_INCR(&nextPoolShard, 1, obj_info_lock) % SCCP_REFCOUNT_POOL_SHARDS) + 1;
+		}
+		return &pools[type].shards[*shard - 1];
+	}
+	return &pools[type].shards[0];
+}
+
+static gcc_inline RefCountedObject *sccp_refcount_pool_get(enum sccp_refcounted_types type, size_t size)
+{
+	struct sccp_refcount_pool *pool = &pools[type];
+	RefCountedObject *obj = NULL;
+
+	if (do_expect((&obj_info[type])->poolsize && runState == SCCP_REF_RUNNING)) {
+		if (dont_expect(!pool->objsize)) {
+			sccp_mutex_lock(&pool->lock);
+			if (!pool->objsize) {									// first allocation wins
+				pool->objsize = size;
+			}
+			sccp_mutex_unlock(&pool->lock);
+		}
+		if (pool->objsize == size) {
+			struct sccp_refcount_pool_shard *shard = sccp_refcount_pool_getShard(type);
+			sccp_mutex_lock(&shard->lock);
+			if ((obj = shard->freeList)) {
+				shard->freeList = obj->nextFree;
+				shard->numFree--;
+				shard->hits++;
+			} else {
+				shard->misses++;
+			}
+			sccp_mutex_unlock(&shard->lock);
+		}
+	}
+	if (obj) {
+		memset((unsigned char *) obj + SCCP_REFCOUNT_RECYCLED, 0, size - SCCP_REFCOUNT_RECYCLED);
+	} else if ((obj = sccp_calloc(size, 1))) {
+#ifndef SCCP_ATOMIC
+		ast_mutex_init(&obj->lock);
+#endif
+	}
+	return obj;
+}
+
+static gcc_inline void sccp_refcount_pool_put(RefCountedObject *obj, enum sccp_refcounted_types type, size_t size)
+{
+	struct sccp_refcount_pool *pool = &pools[type];
+
+	if (do_expect(pool->objsize == size && runState == SCCP_REF_RUNNING)) {
+		struct sccp_refcount_pool_shard *shard = sccp_refcount_pool_getShard(type);
+		sccp_mutex_lock(&shard->lock);
+		if (shard->numFree < (&obj_info[type])->poolsize) {
+			obj->nextFree = shard->freeList;
+			shard->freeList = obj;
+			shard->numFree++;
+			obj = NULL;
+		}
+		sccp_mutex_unlock(&shard->lock);
+	}
+	if (obj) {
+		sccp_free(obj);
+	}
+}
+
+static void sccp_refcount_pool_stats(enum sccp_refcounted_types type, uint32_t *numFree, uint32_t *hits, uint32_t *misses)
+{
+	uint32_t shard;
+
+	*numFree = *hits = *misses = 0;
+	for (shard = 0; shard < SCCP_REFCOUNT_POOL_SHARDS; shard++) {
+		*numFree += pools[type].shards[shard].numFree;
+		*hits += pools[type].shards[shard].hits;
+		*misses += pools[type].shards[shard].misses;
+	}
+}
+
 void sccp_refcount_init(void)
 {
+	uint32_t type, shard;
+
 	sccp_log((DEBUGCAT_REFCOUNT + DEBUGCAT_HIGH)) (VERBOSE_PREFIX_1 "SCCP: (Refcount) init\n");
-	pbx_rwlock_init_notracking(&objectslock);								// No tracking to safe cpu cycles
+	for (type = 0; type < ARRAY_LEN(obj_info); type++) {
+		pbx_mutex_init_notracking(&pools[type].lock);
+		for (shard = 0; shard < SCCP_REFCOUNT_POOL_SHARDS; shard++) {
+			pbx_mutex_init_notracking(&pools[type].shards[shard].lock);
+		}
+	}
 #if CS_REFCOUNT_DEBUG
+	pbx_rwlock_init_notracking(&objectslock);								// No tracking to safe cpu cycles
 	sccp_ref_debug_log = fopen(REF_FILE, "w");
 	if (!sccp_ref_debug_log) {
 		pbx_log(LOG_NOTICE, "SCCP: Failed to open ref debug log file '%s'\n", REF_FILE);
@@ -121,8 +249,7 @@ void sccp_refcount_init(void)
 
 void sccp_refcount_destroy(void)
 {
-	uint32_t hash, type;
-	RefCountedObject *obj;
+	uint32_t type;
 
 	pbx_log(LOG_NOTICE, "SCCP: (Refcount) Shutting Down. Checking Clean Shutdown...\n");
 	int numObjects = 0;
@@ -130,6 +257,10 @@ void sccp_refcount_destroy(void)
 
 	sched_yield();												//make sure all other threads can finish their work first.
 
+#if CS_REFCOUNT_DEBUG
+	uint32_t hash;
+	RefCountedObject *obj;
+
 	// cleanup if necessary, if everything is well, this should not be necessary
 	ast_rwlock_wrlock(&objectslock);
 	for (type = 0; type < ARRAY_LEN(obj_info); type++) { 							// unwind in order of type priority
@@ -145,6 +276,7 @@ void sccp_refcount_destroy(void)
 #ifndef SCCP_ATOMIC
 					ast_mutex_destroy(&obj->lock);
 #endif
+					ATOMIC_DECR(&(&obj_info[obj->type])->numObjects, 1, obj_info_lock);
 					memset(obj, 0, sizeof(RefCountedObject));
 					sccp_free(obj);
 					obj = NULL;
@@ -164,6 +296,35 @@ void sccp_refcount_destroy(void)
 	if (numObjects) {
 		pbx_log(LOG_WARNING, "SCCP: (Refcount) Note: We found %d objects which had to be forcefulfy removed during refcount shutdown, see above.\n", numObjects);
 	}
+#else
+	// without the objects hash table, we can only report the objects which are still around (configure --enable-refcount-debug to clean them up)
+	for (type = 0; type < ARRAY_LEN(obj_info); type++) {
+		if ((&obj_info[type])->numObjects) {
+			pbx_log(LOG_NOTICE, "SCCP: (Refcount) %d objects of type:%s still allocated\n", (int) (&obj_info[type])->numObjects, (&obj_info[type])->datatype);
+			numObjects += (&obj_info[type])->numObjects;
+		}
+	}
+	if (numObjects) {
+		pbx_log(LOG_WARNING, "SCCP: (Refcount) Note: We found %d objects which were not released during refcount shutdown, see above.\n", numObjects);
+	}
+#endif
+	// release pooled objects
+	RefCountedObject *pooled;
+	uint32_t shard;
+	for (type = 0; type < ARRAY_LEN(obj_info); type++) {
+		for (shard = 0; shard < SCCP_REFCOUNT_POOL_SHARDS; shard++) {
+			sccp_mutex_lock(&pools[type].shards[shard].lock);
+			while ((pooled = pools[type].shards[shard].freeList)) {
+				pools[type].shards[shard].freeList = pooled->nextFree;
+				sccp_free(pooled);
+			}
+			pools[type].shards[shard].numFree = 0;
+			sccp_mutex_unlock(&pools[type].shards[shard].lock);
+			pbx_mutex_destroy(&pools[type].shards[shard].lock);
+		}
+		pools[type].objsize = 0;
+		pbx_mutex_destroy(&pools[type].lock);
+	}
 #if CS_REFCOUNT_DEBUG
 	if (sccp_ref_debug_log) {
 		fclose(sccp_ref_debug_log);
@@ -189,14 +350,13 @@ void *const sccp_refcount_object_alloc(size_t size, enum sccp_refcounted_types t
 {
 	RefCountedObject *obj;
 	void *ptr = NULL;
-	uint32_t hash;
 
 	if (!runState) {
 		pbx_log(LOG_ERROR, "SCCP: (sccp_refcount_object_alloc) Not Running Yet!\n");
 		return NULL;
 	}
 
-	if (!(obj = sccp_calloc(size + (sizeof *obj), 1) )) {
+	if (!(obj = sccp_refcount_pool_get(type, size + (sizeof *obj)))) {
 		pbx_log(LOG_ERROR, SS_Memory_Allocation_Error, "SCCP: obj");
 		return NULL;
 	}
@@ -207,15 +367,14 @@ void *const sccp_refcount_object_alloc(size_t size, enum sccp_refcounted_types t
 	// initialize object    
 	obj->len = (int)size;
 	obj->type = type;
-	obj->refcount = 1;
-#ifndef SCCP_ATOMIC
-	ast_mutex_init(&obj->lock);
-#endif
+	ATOMIC_INCR(&obj->refcount, 1, obj_lock);								// pooled object: a racing retain may still hold a transient reference
+	obj->magic = SCCP_REFCOUNT_MAGIC;
 	sccp_copy_string(obj->identifier, identifier, sizeof(obj->identifier));
+	ptr = obj->data;
 
+#if CS_REFCOUNT_DEBUG
 	// generate hash
-	ptr = obj->data;
-	hash = SCCP_SIMPLE_HASH(ptr);
+	uint32_t hash = SCCP_SIMPLE_HASH(ptr);
 
 	if (!objects[hash]) {
 		// create new hashtable head when necessary (should this possibly be moved to refcount_init, to avoid raceconditions ?)
@@ -238,8 +397,18 @@ void *const sccp_refcount_object_alloc(size_t size, enum sccp_refcounted_types t
 		SCCP_RWLIST_INSERT_HEAD(&(objects[hash]->refCountedObjects), obj, list);
 		SCCP_RWLIST_UNLOCK(&(objects[hash]->refCountedObjects));
 	}
-
 	sccp_log((DEBUGCAT_REFCOUNT)) (VERBOSE_PREFIX_1 "SCCP: (alloc_obj) Creating new %s %s (%p) inside %p at hash: %d\n", (&obj_info[obj->type])->datatype, identifier, ptr, obj, hash);
+#else
+	sccp_log((DEBUGCAT_REFCOUNT)) (VERBOSE_PREFIX_1 "SCCP: (alloc_obj) Creating new %s %s (%p) inside %p\n", (&obj_info[obj->type])->datatype, identifier, ptr, obj);
+#endif
+	int numObjects = ATOMIC_INCR(&(&obj_info[type])->numObjects, 1, obj_info_lock) + 1;
+	if (numObjects > pools[type].highWater) {								// only take the lock when we might have a new maximum
+		sccp_mutex_lock(&pools[type].lock);
+		if (numObjects > pools[type].highWater) {
+			pools[type].highWater = numObjects;
+		}
+		sccp_mutex_unlock(&pools[type].lock);
+	}
 	obj->alive = SCCP_LIVE_MARKER;
 
 #if CS_REFCOUNT_DEBUG
@@ -293,43 +462,34 @@ static gcc_inline int __sccp_refcount_debug(const void *ptr, RefCountedObject *
 static gcc_inline RefCountedObject *sccp_refcount_find_obj(const void *ptr, const char *filename, int lineno, const char *func)
 {
 	RefCountedObject *obj = NULL;
-	boolean_t found = FALSE;
 
 	if (ptr == NULL) {
 		return NULL;
 	}
 
-	int hash = SCCP_SIMPLE_HASH(ptr);
-
-	if (objects[hash]) {
-		SCCP_RWLIST_RDLOCK(&(objects[hash])->refCountedObjects);
-		SCCP_RWLIST_TRAVERSE(&(objects[hash])->refCountedObjects, obj, list) {
-			if (obj->data == ptr) {
-				if (SCCP_LIVE_MARKER == obj->alive) {
-					found = TRUE;
-				} else {
+	obj = SCCP_REFCOUNT_OBJ(ptr);
+	if (do_expect(SCCP_REFCOUNT_MAGIC == obj->magic && SCCP_LIVE_MARKER == obj->alive)) {
+		return obj;
+	}
+	if (SCCP_REFCOUNT_MAGIC == obj->magic) {
 #if CS_REFCOUNT_DEBUG
-					__sccp_refcount_debug((void *) ptr, obj, 0, filename, lineno, func);
+		__sccp_refcount_debug((void *) ptr, obj, 0, filename, lineno, func);
 #endif
-					sccp_log((DEBUGCAT_REFCOUNT)) (VERBOSE_PREFIX_1 "SCCP: (sccp_refcount_find_obj) %p Already declared dead (hash: %d)\n", obj, hash);
-				}
-				break;
-			}
-		}
-		SCCP_RWLIST_UNLOCK(&(objects[hash])->refCountedObjects);
+		sccp_log((DEBUGCAT_REFCOUNT)) (VERBOSE_PREFIX_1 "SCCP: (sccp_refcount_find_obj) %p Already declared dead\n", obj);
 	}
-	return found ? obj : NULL;
+	return NULL;
 }
 
 static gcc_inline void sccp_refcount_remove_obj(const void *ptr)
 {
 	RefCountedObject *obj = NULL;
-	boolean_t cleanup_objects = FALSE;
 
 	if (ptr == NULL) {
 		return;
 	}
 
+#if CS_REFCOUNT_DEBUG
+	boolean_t cleanup_objects = FALSE;
 	int hash = SCCP_SIMPLE_HASH(ptr);
 
 	sccp_log((DEBUGCAT_REFCOUNT)) (VERBOSE_PREFIX_1 "SCCP: (sccp_refcount_remove_obj) Removing %p from hash table at hash: %d\n", ptr, hash);
@@ -348,21 +508,29 @@ static gcc_inline void sccp_refcount_remove_obj(const void *ptr)
 		}
 		SCCP_RWLIST_UNLOCK(&(objects[hash])->refCountedObjects);
 	}
+#else
+	obj = SCCP_REFCOUNT_OBJ(ptr);
+#endif
 	if (obj) {
 		sched_yield();											// make sure all other threads can finish their work first.
 		// should resolve lockless refcount SMP issues
 		// BTW we are not allowed to sleep whilst haveing a reference
 		// fire destructor
 		if (obj && obj->data == ptr && SCCP_LIVE_MARKER != obj->alive) {
-			sccp_log((DEBUGCAT_REFCOUNT)) (VERBOSE_PREFIX_1 "SCCP: (sccp_refcount_remove_obj) Destroying %p at hash: %d\n", obj, hash);
+			sccp_log((DEBUGCAT_REFCOUNT)) (VERBOSE_PREFIX_1 "SCCP: (sccp_refcount_remove_obj) Destroying %p\n", obj);
 			if ((&obj_info[obj->type])->destructor) {
 				(&obj_info[obj->type])->destructor(ptr);
 			}
-			memset(obj, 0, sizeof(RefCountedObject));
-			sccp_free(obj);
+			enum sccp_refcounted_types type = obj->type;
+			size_t size = obj->len + sizeof(RefCountedObject);
+			ATOMIC_DECR(&(&obj_info[type])->numObjects, 1, obj_info_lock);
+			ATOMIC_INCR(&obj->generation, 1, obj_lock);
+			memset((unsigned char *) obj + SCCP_REFCOUNT_RECYCLED, 0, sizeof(RefCountedObject) - SCCP_REFCOUNT_RECYCLED);
+			sccp_refcount_pool_put(obj, type, size);
 			obj = NULL;
 		}
 	}
+#if CS_REFCOUNT_DEBUG
 	if (cleanup_objects && runState == SCCP_REF_RUNNING && objects[hash]) {
 		ast_rwlock_wrlock(&objectslock);
 		SCCP_RWLIST_WRLOCK(&(objects[hash])->refCountedObjects);
@@ -375,11 +543,35 @@ static gcc_inline void sccp_refcount_remove_obj(const void *ptr)
 		}
 		ast_rwlock_unlock(&objectslock);
 	}
+#endif
 }
 
 int sccp_show_refcount(int fd, sccp_cli_totals_t *totals, struct mansession *s, const struct message *m, int argc, char *argv[])
 {
 	int local_line_total = 0;
+	int local_table_total = 0;
+	uint32_t type;
+	uint32_t poolFree = 0, poolHits = 0, poolMisses = 0;
+
+	// Objects and Pool Statistics per Type (always available, does not need the objects hash table)
+#define CLI_AMI_TABLE_NAME Types
+#define CLI_AMI_TABLE_PER_ENTRY_NAME Type
+#define CLI_AMI_TABLE_ITERATOR for(type = 1; type < ARRAY_LEN(obj_info); type++)
+#define CLI_AMI_TABLE_BEFORE_ITERATION											\
+		sccp_refcount_pool_stats(type, &poolFree, &poolHits, &poolMisses);
+#define CLI_AMI_TABLE_FIELDS 												\
+	CLI_AMI_TABLE_FIELD(Type,		"-17.17",	s,	17,	(&obj_info[type])->datatype)		\
+	CLI_AMI_TABLE_FIELD(Objects,		"-8.8",		d,	8,	(int) (&obj_info[type])->numObjects)	\
+	CLI_AMI_TABLE_FIELD(HighWater,		"-9.9",		d,	9,	(int) pools[type].highWater)		\
+	CLI_AMI_TABLE_FIELD(PoolSize,		"-8.8",		d,	8,	(&obj_info[type])->poolsize * SCCP_REFCOUNT_POOL_SHARDS)	\
+	CLI_AMI_TABLE_FIELD(Pooled,		"-8.8",		u,	8,	poolFree)				\
+	CLI_AMI_TABLE_FIELD(Hits,		"-10.10",	u,	10,	poolHits)				\
+	CLI_AMI_TABLE_FIELD(Misses,		"-10.10",	u,	10,	poolMisses)
+#include "sccp_cli_table.h"
+	local_line_total++;
+	local_table_total++;
+
+#if CS_REFCOUNT_DEBUG
 	int bucket, prev = 0;
 	RefCountedObject *obj = NULL;
 	unsigned int maxdepth = 0;
@@ -499,10 +691,16 @@ int sccp_show_refcount(int fd, sccp_cli_totals_t *totals, struct mansession *s,
 			local_line_total++;
 		}
 	}
+	local_table_total += 2;
+#else
+	if (!s) {
+		pbx_cli(fd, "Listing of individual refcounted objects requires ./configure --enable-refcount-debug.\n");
+	}
+#endif
 
 	if (s) {
 		totals->lines = local_line_total;
-		totals->tables = 2;
+		totals->tables = local_table_total;
 	}
 	return RESULT_SUCCESS;
 }
@@ -510,10 +708,11 @@ int sccp_show_refcount(int fd, sccp_cli_totals_t *totals, struct mansession *s,
 #ifdef CS_EXPERIMENTAL
 int sccp_refcount_force_release(long findobj, char *identifier)
 {
-	uint32_t hash;
-	RefCountedObject *obj = NULL;
 	void *ptr = NULL;
 
+#if CS_REFCOUNT_DEBUG
+	RefCountedObject *obj = NULL;
+	uint32_t hash;
 	ast_rwlock_rdlock(&objectslock);
 	for (hash = 0; hash < SCCP_HASH_PRIME; hash++) {
 		if (objects[hash]) {
@@ -527,6 +726,10 @@ int sccp_refcount_force_release(long findobj, char *identifier)
 		}
 	}
 	ast_rwlock_unlock(&objectslock);
+#else
+	/* without the objects hashtable there is no way to validate the address that was typed in, refuse instead of dereferencing it */
+	pbx_log(LOG_WARNING, "SCCP: Forcefully releasing refcounted object 0x%lx (%s) requires ./configure --enable-refcount-debug.\n", findobj, identifier);
+#endif
 	if (ptr) {
 		sccp_log(DEBUGCAT_CORE) (VERBOSE_PREFIX_1 "Forcefully releasing one instance of %s\n", identifier);
 		sccp_refcount_release(ptr, __FILE__, __LINE__, __PRETTY_FUNCTION__);
@@ -547,11 +750,23 @@ void sccp_refcount_updateIdentifier(void *ptr, char *identifier)
 	}
 }
 
+/*!
+ * \brief last reference is gone, declare the object dead and destroy it
+ */
+static gcc_inline void sccp_refcount_finalize(RefCountedObject * obj, const void *ptr, const char *filename, int lineno, const char *func)
+{
+	int alive = ATOMIC_DECR(&obj->alive, SCCP_LIVE_MARKER, &obj->lock);
+
+	sccp_log((DEBUGCAT_REFCOUNT)) (VERBOSE_PREFIX_1 "SCCP: %-15.15s:%-4.4d (%-35.35s)) (release) Finalizing %p (%p) (alive:%d)\n", filename, lineno, func, obj, ptr, alive);
+	sccp_refcount_remove_obj(ptr);
+}
+
 gcc_inline void * const sccp_refcount_retain(const void * const ptr, const char *filename, int lineno, const char *func)
 {
 	RefCountedObject *obj = NULL;
 	volatile int refcountval;
 	int newrefcountval;
+	int generation = ptr ? SCCP_REFCOUNT_OBJ(ptr)->generation : 0;					// taken before the alive check, so a reuse after it shows up
 
 	if (do_expect((obj = sccp_refcount_find_obj(ptr, filename, lineno, func)) != NULL)) {
 #if CS_REFCOUNT_DEBUG
@@ -561,7 +776,19 @@ gcc_inline void * const sccp_refcount_retain(const void * const ptr, const char
 		refcountval = ATOMIC_INCR((&obj->refcount), 1, &obj->lock);
 		// ANNOTATE_HAPPENS_AFTER(&obj->refcount);
 		newrefcountval = refcountval + 1;
-		
+
+		/* revalidate: the object might have died (and been handed out again by its pool) between the lookup and the increment */
+		if (dont_expect(refcountval <= 0 || SCCP_LIVE_MARKER != obj->alive || generation != ATOMIC_FETCH(&obj->generation, &obj->lock))) {
+			refcountval = ATOMIC_DECR((&obj->refcount), 1, &obj->lock);
+			/* dropping to zero only finalizes a reused object (new generation, alive) whose new owner released it while we held it, a
+			 * dying or pooled object is left alone, its own release already took care of it */
+			if (refcountval == 1 && SCCP_LIVE_MARKER == obj->alive && generation != ATOMIC_FETCH(&obj->generation, &obj->lock)) {
+				sccp_refcount_finalize(obj, ptr, filename, lineno, func);
+			}
+			sccp_log((DEBUGCAT_REFCOUNT)) (VERBOSE_PREFIX_1 "SCCP: %-15.15s:%-4.4d (%-35.35s)) (retain) %p died while being retained\n", filename, lineno, func, ptr);
+			return NULL;
+		}
+
 		if (dont_expect( (sccp_globals->debug & (((&obj_info[obj->type])->debugcat + DEBUGCAT_REFCOUNT))) == ((&obj_info[obj->type])->debugcat + DEBUGCAT_REFCOUNT))) {
 			pbx_log(__LOG_VERBOSE, __FILE__, 0, "", " %-15.15s:%-4.4d (%-35.35s) %*.*s> %*s refcount increased %.2d  +> %.2d for %10s: %s (%p)\n", filename, lineno, func, refcountval, refcountval, "--------------------", 20 - refcountval, " ", refcountval, newrefcountval, (&obj_info[obj->type])->datatype, obj->identifier, obj);
 		}
@@ -586,7 +813,7 @@ gcc_inline void * const sccp_refcount_release(const void * * const ptr, const ch
 {
 	RefCountedObject *obj = NULL;
 	volatile int refcountval;
-	int newrefcountval, alive;
+	int newrefcountval;
 	sccp_debug_category_t debugcat;
 
 	if (do_expect( (obj = sccp_refcount_find_obj(*ptr, filename, lineno, func)) != NULL && obj->refcount > 0)) {
@@ -604,9 +831,7 @@ gcc_inline void * const sccp_refcount_release(const void * * const ptr, const ch
 		
 		newrefcountval = refcountval - 1;
 		if (dont_expect(newrefcountval == 0)) {
-			alive = ATOMIC_DECR(&obj->alive, SCCP_LIVE_MARKER, &obj->lock);
-			sccp_log((DEBUGCAT_REFCOUNT)) (VERBOSE_PREFIX_1 "SCCP: %-15.15s:%-4.4d (%-35.35s)) (release) Finalizing %p (%p) (alive:%d)\n", filename, lineno, func, obj, *ptr, alive);
-			sccp_refcount_remove_obj(*ptr);
+			sccp_refcount_finalize(obj, *ptr, filename, lineno, func);
 		} else {
 			if (dont_expect( (sccp_globals->debug & ((debugcat + DEBUGCAT_REFCOUNT))) == (debugcat ^ DEBUGCAT_REFCOUNT))) {
 				pbx_log(__LOG_VERBOSE, __FILE__, 0, "", " %-15.15s:%-4.4d (%-35.35s) <%*.*s %*s refcount decreased %.2d  <- %.2d for %10s: %s (%p)\n", filename, lineno, func, newrefcountval, newrefcountval, "--------------------", 20 - newrefcountval, " ", newrefcountval, refcountval, (&obj_info[obj->type])->datatype, obj->identifier, obj);
@@ -797,6 +1022,8 @@ AST_TEST_DEFINE(sccp_refcount_tests)
 	sleep(1);
 
 	/* peer directly inside refcounted objects to see if there are any stranded refcounted objects, which should have been destroyed */
+	pbx_test_validate(test, (&obj_info[SCCP_REF_TEST])->numObjects == 0);
+#if CS_REFCOUNT_DEBUG
 	ast_rwlock_rdlock(&objectslock);
 	RefCountedObject *obj = NULL;
 	for (loop = 0; loop < SCCP_HASH_PRIME; loop++) {
@@ -809,6 +1036,24 @@ AST_TEST_DEFINE(sccp_refcount_tests)
 		}
 	}
 	ast_rwlock_unlock(&objectslock);
+#endif
+
+	pbx_test_status_update(test, "Reused pooled objects get a new generation...\n");
+	object[0] = (struct refcount_test *) sccp_refcount_object_alloc(sizeof(struct refcount_test), SCCP_REF_TEST, "pooled", refcount_test_destroy);
+	pbx_test_validate(test, object[0] != NULL);
+	RefCountedObject *pooled = SCCP_REFCOUNT_OBJ(object[0]);
+	int generation = pooled->generation;
+	object[0]->str = pbx_strdup("pooled");
+	object[0] = sccp_refcount_release((const void ** const)&object[0], __FILE__, __LINE__, __PRETTY_FUNCTION__);
+	object[0] = (struct refcount_test *) sccp_refcount_object_alloc(sizeof(struct refcount_test), SCCP_REF_TEST, "reused", refcount_test_destroy);
+	pbx_test_validate(test, object[0] != NULL);
+	if (SCCP_REFCOUNT_OBJ(object[0]) == pooled) {								/* same thread, so we normally get the same object back */
+		pbx_test_validate(test, pooled->generation != generation && pooled->refcount == 1);
+	}
+	object[0]->str = pbx_strdup("reused");
+	object[0] = sccp_refcount_release((const void ** const)&object[0], __FILE__, __LINE__, __PRETTY_FUNCTION__);
+	pbx_test_validate(test, (&obj_info[SCCP_REF_TEST])->numObjects == 0);
+
 	sccp_free(object);
 	return AST_TEST_PASS;
 }
@@ -21,6 +21,8 @@ SCCP_FILE_VERSION(__FILE__, "");
 #include "sccp_netsock.h"
 #include "sccp_utils.h"
 #include <netinet/in.h>
+#include <sys/uio.h>
+#include <fcntl.h>
 
 #ifndef CS_USE_POLL_COMPAT
 #include <poll.h>
@@ -38,6 +40,11 @@ SCCP_FILE_VERSION(__FILE__, "");
 #  include <asterisk/acl.h>
 #endif
 #include <asterisk/cli.h>
+#if defined(linux)
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#define SCCP_SESSION_EVENTLOOP 1										/* session_eventloop=yes is available */
+#endif
 
 /* arbitrary values */
 //#define SOCKET_TIMEOUT_SEC 0											/* timeout after seven seconds when trying to read/write from/to a socket */
@@ -53,10 +60,18 @@ SCCP_FILE_VERSION(__FILE__, "");
 //#define READ_RETRIES 5											/* number of read retries */
 //#define READ_BACKOFF 50											/* backoff time in millisecs, doubled every read retry (150+300+600+1200+2400+4800 = 9450 millisecs = 9.5 sec)*/
 //#define WRITE_RETRIES 5												/* number of write retries */
-#define WRITE_BACKOFF 500											/* backoff time in millisecs, doubled every write retry (150+300+600+1200+2400+4800 = 9450 millisecs = 9.5 sec) */
+//#define WRITE_BACKOFF 500											/* backoff time in millisecs, doubled every write retry (150+300+600+1200+2400+4800 = 9450 millisecs = 9.5 sec) */
+
+#define SESSION_RECV_BUFFER_SIZE (SCCP_MAX_PACKET * 2)								/* size of the receive ring buffer, always holds at least one complete message */
+#define SESSION_OUTQUEUE_IOV 32											/* maximum number of queued messages written using a single sendmsg */
+#define SESSION_OUTQUEUE_MIN 16											/* lower limit for session_outqueue_high */
+#define SESSION_OUTQUEUE_POLL 500										/* poll interval in millisecs while a session thread has output pending */
 
 #define SESSION_DEVICE_CLEANUP_TIME 10										/* wait time before destroying a device on thread exit */
 #define KEEPALIVE_ADDITIONAL_PERCENT 10										/* extra time allowed for device keepalive overrun (percentage of GLOB(keepalive)) */
+#define SESSION_EVENTLOOP_MAX_EVENTS 64										/* maximum number of socket events handled per epoll_wait */
+#define SESSION_EVENTLOOP_MAX_WORKERS 64									/* upper limit for the number of event-loop workers */
+#define SESSION_EVENTLOOP_TICK 1000										/* event-loop housekeeping interval in millisecs (keepalive timeouts) */
 //#define ACCEPT_UWAIT_ON_KNOWN_IP 2										/* wait time when ip-address is already known */
 //#define ACCEPT_RETRIES 5											/* number of reqtries when we already know this ip-address */
 
@@ -73,6 +88,10 @@ void *sccp_netsock_device_thread(void *session);
 sccp_session_t *sccp_session_findByDevice(const sccp_device_t * device);
 sccp_session_t *sccp_session_findByIP(const struct sockaddr_storage *sin);
 void sccp_session_destroySessionsByDeviceName(const char *name);
+static boolean_t __sccp_session_drain(sccp_session_t * s);
+#ifdef SCCP_SESSION_EVENTLOOP
+static void sccp_session_engine_stop(void);
+#endif
 
 /*!
  * \brief SCCP Session Structure
@@ -82,7 +101,7 @@ struct sccp_session {
 	time_t lastKeepAlive;											/*!< Last KeepAlive Time */
 	SCCP_RWLIST_ENTRY (sccp_session_t) list;								/*!< Linked List Entry for this Session */
 	sccp_device_t *device;											/*!< Associated Device */
-	struct pollfd fds[1];											/*!< File Descriptor */
+	struct pollfd fds[2];											/*!< File Descriptor (fds[1] is the wakeup pipe used by a session thread) */
 	struct sockaddr_storage sin;										/*!< Incoming Socket Address */
 	uint32_t protocolType;
 	volatile boolean_t session_stop;									/*!< Signal Session Stop */
@@ -92,6 +111,30 @@ struct sccp_session {
 	struct sockaddr_storage ourip;										/*!< Our IP is for rtp use */
 	struct sockaddr_storage ourIPv4;
 	char designator[40];
+	sccp_msg_t **outqueue;											/*!< Ring of outbound messages waiting to be written (protected by write_lock) */
+	uint16_t outqueue_size;											/*!< Capacity of outqueue */
+	uint16_t outqueue_high;											/*!< High watermark (3/4 of the capacity), congestion starts when outqueue_len reaches it */
+	uint16_t outqueue_low;											/*!< Low watermark (half the capacity by default), congestion ends when outqueue_len drops to this level */
+	uint16_t outqueue_head;											/*!< Index of the oldest message in outqueue */
+	uint16_t outqueue_len;											/*!< Number of messages in outqueue */
+	size_t outqueue_offset;											/*!< Number of bytes of the oldest message which have already been written */
+	time_t outqueue_congested;										/*!< Time the high watermark was reached, 0 when not congested */
+	uint16_t cork;												/*!< Cork nesting level, messages are queued while > 0 (protected by write_lock) */
+	boolean_t write_pending;										/*!< The I/O loop has been asked to drain outqueue */
+	int wakefd;												/*!< Write end of the wakeup pipe of the session thread (-1 when serviced by the event-loop) */
+	uint32_t sent_messages;											/*!< Number of messages written to the socket */
+	uint32_t sent_syscalls;											/*!< Number of write syscalls used to send them */
+	uint32_t superseded_messages;										/*!< Number of queued status messages replaced by a newer one */
+	uint32_t dropped_messages;										/*!< Number of messages dropped because the queue was congested */
+#ifdef SCCP_SESSION_EVENTLOOP
+	struct sccp_session_worker *worker;									/*!< Event-Loop Worker owning this session (NULL when serviced by a session thread) */
+	SCCP_LIST_ENTRY (sccp_session_t) worker_list;								/*!< Linked List Entry for the Event-Loop Worker */
+	unsigned char *recv_buffer;										/*!< Receive Ring Buffer (event-loop only, session threads keep it on their stack) */
+	size_t recv_head;											/*!< Offset of the first pending byte in recv_buffer */
+	size_t recv_len;											/*!< Number of bytes pending in recv_buffer */
+	sccp_msg_t *recv_msg;											/*!< Message handed to sccp_handle_message when it can not be parsed in place (event-loop only) */
+	volatile boolean_t offloaded;										/*!< Input is being handled by the general threadpool, socket is not watched by the worker */
+#endif
 };														/*!< SCCP Session Structure */
 
 boolean_t sccp_session_getOurIP(constSessionPtr session, struct sockaddr_storage * const sockAddrStorage, int family)
@@ -191,6 +234,12 @@ static void __sccp_session_stopthread(sessionPtr session, uint8_t newRegistratio
 	if (session->device) {
 		sccp_device_setRegistrationState(session->device, newRegistrationState);
 	}
+#ifdef SCCP_SESSION_EVENTLOOP
+	if (session->worker) {
+		shutdown(session->fds[0].fd, SHUT_RD);								// wakes up the owning event-loop worker, which will cleanup the session
+		return;
+	}
+#endif
 	if (AST_PTHREADT_NULL != session->session_thread) {
 		shutdown(session->fds[0].fd, SHUT_RD);								// this will also wake up poll
 		// which is waiting for a read event and close down the thread nicely
@@ -261,10 +310,53 @@ static int session_dissect_header(sccp_session_t * s, sccp_header_t * header)
 	return result;
 }
 
-static gcc_inline int session_buffer2msg(sccp_session_t * s, unsigned char *buffer, int lenAccordingToPacketHeader, sccp_msg_t *msg) 
+/*!
+ * \brief Copy len bytes starting at head out of the receive ring buffer
+ */
+static gcc_inline void session_ringcopy(void *dst, const unsigned char *ring, size_t head, size_t len)
+{
+	size_t first = SESSION_RECV_BUFFER_SIZE - head;
+
+	if (len <= first) {
+		memcpy(dst, ring + head, len);
+	} else {												// message wraps around the end of the ring
+		memcpy(dst, ring + head, first);
+		memcpy((unsigned char *) dst + first, ring, len - first);
+	}
+}
+
+/*!
+ * \brief Receive as much data as fits into the free part of the receive ring buffer
+ * \return result of recvmsg
+ */
+static gcc_inline int session_recv(sccp_session_t * s, unsigned char *ring, size_t head, size_t len, int flags)
+{
+	struct iovec iov[2];
+	struct msghdr mh = { 0 };
+	size_t tail = (head + len) % SESSION_RECV_BUFFER_SIZE;
+	size_t space = SESSION_RECV_BUFFER_SIZE - len;
+
+	iov[0].iov_base = ring + tail;
+	if (tail + space <= SESSION_RECV_BUFFER_SIZE) {
+		iov[0].iov_len = space;
+		mh.msg_iovlen = 1;
+	} else {												// free space wraps around the end of the ring
+		iov[0].iov_len = SESSION_RECV_BUFFER_SIZE - tail;
+		iov[1].iov_base = ring;
+		iov[1].iov_len = space - iov[0].iov_len;
+		mh.msg_iovlen = 2;
+	}
+	mh.msg_iov = iov;
+	return recvmsg(s->fds[0].fd, &mh, flags);
+}
+
+static gcc_inline int session_buffer2msg(sccp_session_t * s, unsigned char *ring, size_t head, int lenAccordingToPacketHeader, sccp_msg_t *scratch) 
 {
 	sccp_header_t msg_header = {0};
-	memcpy(&msg_header, buffer, SCCP_PACKET_HEADER);
+	sccp_msg_t *msg = NULL;
+	boolean_t contiguous = (head + lenAccordingToPacketHeader <= SESSION_RECV_BUFFER_SIZE);
+
+	session_ringcopy(&msg_header, ring, head, SCCP_PACKET_HEADER);
 	int lenAccordingToOurProtocolSpec = session_dissect_header(s, &msg_header);
 	if (dont_expect(lenAccordingToOurProtocolSpec < 0)) {
 		if (lenAccordingToOurProtocolSpec == -2) {
@@ -274,42 +366,96 @@ static gcc_inline int session_buffer2msg(sccp_session_t * s, unsigned char *buff
 	}
 	if (dont_expect(lenAccordingToPacketHeader > lenAccordingToOurProtocolSpec)) {					// show out discarded bytes
 		pbx_log(LOG_WARNING, "%s: (session_dissect_msg) Incoming message is bigger than known size. Packet looks like!\n", DEV_ID_LOG(s->device));
-		sccp_dump_packet(buffer, lenAccordingToPacketHeader);
+		if (contiguous) {
+			sccp_dump_packet(ring + head, lenAccordingToPacketHeader);
+		} else {
+			session_ringcopy(scratch, ring, head, lenAccordingToPacketHeader);
+			sccp_dump_packet((unsigned char *) scratch, lenAccordingToPacketHeader);
+		}
 	}
 
-	memset(msg, 0, SCCP_MAX_PACKET);
-	memcpy(msg, buffer, lenAccordingToOurProtocolSpec);
+	if (do_expect(contiguous && lenAccordingToPacketHeader >= lenAccordingToOurProtocolSpec && lenAccordingToOurProtocolSpec >= SCCP_PACKET_HEADER && !((uintptr_t) (ring + head) % sizeof(uint32_t)))) {
+		msg = (sccp_msg_t *) (ring + head);								// complete and aligned, parse in place
+	} else {												// wrapped, unaligned or shorter than the protocol says
+		int copyLen = lenAccordingToPacketHeader < lenAccordingToOurProtocolSpec ? lenAccordingToPacketHeader : lenAccordingToOurProtocolSpec;
+		int padLen = lenAccordingToOurProtocolSpec > SCCP_PACKET_HEADER ? lenAccordingToOurProtocolSpec : SCCP_PACKET_HEADER;
+		session_ringcopy(scratch, ring, head, copyLen);
+		memset((unsigned char *) scratch + copyLen, 0, padLen - copyLen);				// only zero-pad up to the size the handler expects
+		msg = scratch;
+	}
 	msg->header.length = lenAccordingToOurProtocolSpec;								// patch up msg->header.length to new size
 	return sccp_handle_message(msg, s);
 }
 
-static gcc_inline int process_buffer(sccp_session_t * s, sccp_msg_t *msg, unsigned char *buffer, size_t *len)
+#ifdef SCCP_SESSION_EVENTLOOP
+/*!
+ * \brief Messages whose handlers never block and only touch the device itself (keepalive, statistics, time/date)
+ * \note an event-loop worker hands all other messages (call control, registration, AstDB access, ...) to the general threadpool,
+ *       so that it does not stall the other sessions it services
+ */
+static gcc_inline boolean_t __sccp_session_isInlineMessage(uint32_t msgid)
+{
+	switch (msgid) {
+		case KeepAliveMessage:
+		case TimeDateReqMessage:
+		case ConnectionStatisticsRes:
+			return TRUE;
+		default:
+			return FALSE;
+	}
+}
+#endif
+
+/*!
+ * \brief Handle all complete messages in the receive ring
+ * \return 0 when all complete messages have been handled, -1 on error, 1 when an event-loop worker has to offload the next message
+ */
+static gcc_inline int process_buffer(sccp_session_t * s, sccp_msg_t *msg, unsigned char *ring, size_t *head, size_t *len)
 {
 	int res = 0;
+#ifdef SCCP_SESSION_EVENTLOOP
+	boolean_t cancelable = !s->worker;									// never toggle the cancel state of a shared event-loop worker
+#else
+	boolean_t cancelable = TRUE;
+#endif
 	while (*len >= SCCP_PACKET_HEADER) {										// We have at least SCCP_PACKET_HEADER, so we have the payload length
-		uint32_t hdr_len = buffer[0] | (buffer[1] << 8) | (buffer[2] << 16) | (buffer[3] << 24);
+		uint32_t hdr_len = ring[*head] | (ring[(*head + 1) % SESSION_RECV_BUFFER_SIZE] << 8) | (ring[(*head + 2) % SESSION_RECV_BUFFER_SIZE] << 16) | (ring[(*head + 3) % SESSION_RECV_BUFFER_SIZE] << 24);
 		uint32_t payload_len = letohl(hdr_len) + (SCCP_PACKET_HEADER - 4);
 		if (*len < payload_len) {
 			break;												// Too short - haven't received whole payload yet, go poll for more
 		}
+#ifdef SCCP_SESSION_EVENTLOOP
+		if (s->worker && !s->offloaded && payload_len >= SCCP_PACKET_HEADER) {
+			uint32_t hdr_mid = ring[(*head + 8) % SESSION_RECV_BUFFER_SIZE] | (ring[(*head + 9) % SESSION_RECV_BUFFER_SIZE] << 8) | (ring[(*head + 10) % SESSION_RECV_BUFFER_SIZE] << 16) | (ring[(*head + 11) % SESSION_RECV_BUFFER_SIZE] << 24);
+			if (!__sccp_session_isInlineMessage(letohl(hdr_mid))) {
+				res = 1;										// leave it in the ring, the threadpool will handle it
+				break;
+			}
+		}
+#endif
 
-		pthread_setcancelstate(PTHREAD_CANCEL_ENABLE, NULL);							// allow thread to be killed while handling the message
+		if (cancelable) {
+			pthread_setcancelstate(PTHREAD_CANCEL_ENABLE, NULL);						// allow thread to be killed while handling the message
+		}
 		if (dont_expect(payload_len < SCCP_PACKET_HEADER || payload_len > SCCP_MAX_PACKET)) {
 			pbx_log(LOG_ERROR, "%s: (process_buffer) Size of the data payload in the packet is bigger than max packet, close connection !\n", DEV_ID_LOG(s->device));
 			res = -1;
 			break;
 		}
-		if (dont_expect(session_buffer2msg(s, buffer, payload_len, msg) != 0)) {
+		if (dont_expect(session_buffer2msg(s, ring, *head, payload_len, msg) != 0)) {
 			res = -1;
 			break;
 		}
-		pthread_testcancel();
-		pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, NULL);
+		if (cancelable) {
+			pthread_testcancel();
+			pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, NULL);
+		}
 
+		*head = (*head + payload_len) % SESSION_RECV_BUFFER_SIZE;					// consume the message, no need to shuffle the remaining data
 		*len -= payload_len;
-		if (*len > 0) {												// Now shuffle the remaining data in the buffer back to the start
-			memmove(buffer + 0, buffer + payload_len, *len);
-		}
+	}
+	if (*len == 0) {
+		*head = 0;											// restart at the (aligned) beginning of the ring
 	}
 	return res;
 }
@@ -354,6 +500,7 @@ static boolean_t sccp_session_addToGlobals(sccp_session_t * s)
 		if (!sccp_session_findBySession(s)) {;
 			SCCP_RWLIST_WRLOCK(&GLOB(sessions));
 			SCCP_LIST_INSERT_HEAD(&GLOB(sessions), s, list);
+			sccp_hashtable_insert(GLOB(session_index), &s->sin, s);
 			res = TRUE;
 			SCCP_RWLIST_UNLOCK(&GLOB(sessions));
 		}
@@ -379,6 +526,7 @@ static boolean_t sccp_session_removeFromGlobals(sccp_session_t * s)
 		SCCP_RWLIST_TRAVERSE_SAFE_BEGIN(&GLOB(sessions), session, list) {
 			if (session == s) {
 				SCCP_LIST_REMOVE_CURRENT(list);
+				sccp_hashtable_remove(GLOB(session_index), &s->sin, s);
 				res = TRUE;
 				break;
 			}
@@ -406,6 +554,9 @@ void sccp_session_terminateAll()
 		sccp_session_stopthread(s, SKINNY_DEVICE_RS_NONE);
 	}
 	SCCP_RWLIST_TRAVERSE_SAFE_END;
+#ifdef SCCP_SESSION_EVENTLOOP
+	sccp_session_engine_stop();
+#endif
 
 	if (SCCP_LIST_EMPTY(&GLOB(sessions))) {
 		SCCP_RWLIST_HEAD_DESTROY(&GLOB(sessions));
@@ -572,8 +723,38 @@ void destroy_session(sccp_session_t * s, uint8_t cleanupTime)
 		}
 		sccp_session_unlock(s);
 
+		if (s->fds[1].fd > -1) {
+			close(s->fds[1].fd);
+			s->fds[1].fd = -1;
+		}
+		if (s->wakefd > -1) {
+			close(s->wakefd);
+			s->wakefd = -1;
+		}
+
+		/* discard messages which are still queued */
+		sccp_mutex_lock(&s->write_lock);
+		if (s->outqueue) {
+			while (s->outqueue_len > 0) {
+				sccp_free_packet(s->outqueue[s->outqueue_head]);
+				s->outqueue_head = (s->outqueue_head + 1) % s->outqueue_size;
+				s->outqueue_len--;
+			}
+			sccp_free(s->outqueue);
+		}
+		sccp_mutex_unlock(&s->write_lock);
+
 		/* destroying mutex and cleaning the session */
 		sccp_mutex_destroy(&s->lock);
+		sccp_mutex_destroy(&s->write_lock);
+#ifdef SCCP_SESSION_EVENTLOOP
+		if (s->recv_buffer) {
+			sccp_free(s->recv_buffer);
+		}
+		if (s->recv_msg) {
+			sccp_free(s->recv_msg);
+		}
+#endif
 		sccp_free(s);
 		s = NULL;
 	}
@@ -600,6 +781,32 @@ void sccp_netsock_device_thread_exit(void *session)
 	destroy_session(s, SESSION_DEVICE_CLEANUP_TIME);
 }
 
+/*!
+ * \brief Check if the device attached to this session needs some extra keepalive time (wireless/slower devices)
+ */
+static gcc_inline boolean_t __sccp_session_hasSlowDevice(constSessionPtr s)
+{
+	if (s->device && (s->device->skinny_type == SKINNY_DEVICETYPE_CISCO7920 || s->device->skinny_type == SKINNY_DEVICETYPE_CISCO7921 || s->device->skinny_type == SKINNY_DEVICETYPE_CISCO7925 || s->device->skinny_type == SKINNY_DEVICETYPE_CISCO7926 || s->device->skinny_type == SKINNY_DEVICETYPE_CISCO7975 || s->device->skinny_type == SKINNY_DEVICETYPE_CISCO7970 || s->device->skinny_type == SKINNY_DEVICETYPE_CISCO6911)) {
+		return TRUE;
+	}
+	return FALSE;
+}
+
+/*!
+ * \brief Run pending device updates (reload), unless a reload is still in progress
+ */
+static gcc_inline void __sccp_session_checkPendingUpdate(constSessionPtr s)
+{
+	if (s->device && (s->device->pendingUpdate != FALSE || s->device->pendingDelete != FALSE)) {
+		pbx_rwlock_rdlock(&GLOB(lock));
+		boolean_t reload_in_progress = GLOB(reload_in_progress);
+		pbx_rwlock_unlock(&GLOB(lock));
+		if (reload_in_progress == FALSE) {
+			sccp_device_check_update(s->device);
+		}
+	}
+}
+
 /*!
  * \brief Socket Device Thread
  * \param session SCCP Session
@@ -620,7 +827,8 @@ void *sccp_netsock_device_thread(void *session)
 	int pollTimeout;
 	
 	int result = 0;
-	unsigned char recv_buffer[SCCP_MAX_PACKET * 2] = "";
+	unsigned char recv_buffer[SESSION_RECV_BUFFER_SIZE] = "";
+	size_t recv_head = 0;
 	size_t recv_len = 0;
 	sccp_msg_t msg = { {0,} };
 
@@ -631,27 +839,25 @@ void *sccp_netsock_device_thread(void *session)
 	pthread_setcanceltype(PTHREAD_CANCEL_ASYNCHRONOUS, NULL);
 
 	/* we increase additionalTime for wireless/slower devices */
-	if (s->device && (s->device->skinny_type == SKINNY_DEVICETYPE_CISCO7920 || s->device->skinny_type == SKINNY_DEVICETYPE_CISCO7921 || s->device->skinny_type == SKINNY_DEVICETYPE_CISCO7925 || s->device->skinny_type == SKINNY_DEVICETYPE_CISCO7926 || s->device->skinny_type == SKINNY_DEVICETYPE_CISCO7975 || s->device->skinny_type == SKINNY_DEVICETYPE_CISCO7970 || s->device->skinny_type == SKINNY_DEVICETYPE_CISCO6911)) {
+	if (__sccp_session_hasSlowDevice(s)) {
 		keepaliveAdditionalTimePercent += KEEPALIVE_ADDITIONAL_PERCENT;
 	}
 
 	while (s->fds[0].fd > 0 && !s->session_stop) {
-		if (s->device && (s->device->pendingUpdate != FALSE || s->device->pendingDelete != FALSE)) {
-			pbx_rwlock_rdlock(&GLOB(lock));
-			boolean_t reload_in_progress = GLOB(reload_in_progress);
-			pbx_rwlock_unlock(&GLOB(lock));
-			if (reload_in_progress == FALSE) {
-				sccp_device_check_update(s->device);
-			}
-		}
+		__sccp_session_checkPendingUpdate(s);
 		/* calculate poll timout using keepalive interval */
 		maxWaitTime = (s->device) ? s->device->keepalive : GLOB(keepalive);
 		maxWaitTime += (maxWaitTime / 100) * keepaliveAdditionalTimePercent;
 		pollTimeout = maxWaitTime * 1000;
+		s->fds[0].events = POLLIN | POLLPRI;
+		if (s->write_pending) {										/* wait for the socket to become writable as well */
+			s->fds[0].events |= POLLOUT;
+			pollTimeout = SESSION_OUTQUEUE_POLL;
+		}
 
 		sccp_log_and((DEBUGCAT_SOCKET + DEBUGCAT_HIGH)) (VERBOSE_PREFIX_4 "%s: set poll timeout %d for session %d\n", DEV_ID_LOG(s->device), (int) maxWaitTime, s->fds[0].fd);
 
-		res = sccp_netsock_poll(s->fds, 1, pollTimeout);
+		res = sccp_netsock_poll(s->fds, 2, pollTimeout);
 		if (-1 == res) {										/* poll data processing */
 			if (errno > 0 && (errno != EAGAIN) && (errno != EINTR)) {
 				sccp_copy_string(addrStr, sccp_netsock_stringify_addr(&s->sin), sizeof(addrStr));
@@ -660,6 +866,9 @@ void *sccp_netsock_device_thread(void *session)
 				break;
 			}
 		} else if (0 == res) {										/* poll timeout */
+			if (s->write_pending && !__sccp_session_drain(s)) {
+				break;
+			}
 			if (((int) time(0) >= ((int) s->lastKeepAlive + maxWaitTime))) {
 				sccp_copy_string(addrStr, sccp_netsock_stringify_addr(&s->sin), sizeof(addrStr));
 				pbx_log(LOG_NOTICE, "%s: Closing session because connection timed out after %d seconds (ip-address: %s).\n", DEV_ID_LOG(s->device), maxWaitTime, addrStr);
@@ -667,10 +876,20 @@ void *sccp_netsock_device_thread(void *session)
 				break;
 			}
 		} else if (res > 0) {										/* poll data processing */
+			if (s->fds[1].revents & POLLIN) {							/* woken up, output is pending */
+				char wakeup[16];
+				while (read(s->fds[1].fd, wakeup, sizeof(wakeup)) > 0);
+			}
+			if (s->fds[0].revents & POLLOUT && !__sccp_session_drain(s)) {				/* POLLOUT */
+				break;
+			}
+			if (!(s->fds[0].revents & ~POLLOUT)) {
+				continue;
+			}
 			if (s->fds[0].revents & POLLIN || s->fds[0].revents & POLLPRI) {			/* POLLIN | POLLPRI */
 				//sccp_log_and((DEBUGCAT_SOCKET + DEBUGCAT_HIGH)) (VERBOSE_PREFIX_2 "%s: Session New Data Arriving at buffer position:%lu\n", DEV_ID_LOG(s->device), recv_len);
-				result = recv(s->fds[0].fd, recv_buffer + recv_len, (SCCP_MAX_PACKET * 2) - recv_len, 0);
-				if (!(result > 0 && (recv_len += result) && ((SCCP_MAX_PACKET * 2) - recv_len) && process_buffer(s, &msg, recv_buffer, &recv_len) == 0)) {
+				result = session_recv(s, recv_buffer, recv_head, recv_len, 0);
+				if (!(result > 0 && (recv_len += result) && process_buffer(s, &msg, recv_buffer, &recv_head, &recv_len) == 0)) {
 					//socket_get_error(s, __FILE__, __LINE__, __PRETTY_FUNCTION__, errno);
 					if (s->device) {
 						sccp_device_sendReset(s->device, SKINNY_DEVICE_RESTART);
@@ -695,6 +914,430 @@ void *sccp_netsock_device_thread(void *session)
 	return NULL;
 }
 
+#ifdef SCCP_SESSION_EVENTLOOP
+/* -------------------------------------------------------------------------------------------------------EVENT LOOP- */
+/*!
+ * \brief SCCP Session Event-Loop Worker
+ * \note Each worker owns a subset of the session sockets, which it multiplexes using a single epoll descriptor.
+ *       Incoming data is fed to the same process_buffer()/sccp_handle_message() path the session threads use.
+ * \warning Everything running on a worker holds up all the other sessions it services, so it must not block. Only the
+ *       messages listed in __sccp_session_isInlineMessage are handled on the worker, any other message is handed to the
+ *       general threadpool together with the rest of the input of that session, and the socket is only watched again once
+ *       it has been handled. Pending device updates (reload) and session cleanup (sccp_dev_clean / destroy_session) run on
+ *       the general threadpool as well. Only add handlers to __sccp_session_isInlineMessage that never sleep, lock
+ *       channels or access the AstDB.
+ */
+struct sccp_session_worker {
+	int epfd;												/*!< epoll Descriptor */
+	int wakefd;												/*!< eventfd used to interrupt epoll_wait */
+	uint8_t id;												/*!< Worker Number */
+	pthread_t thread;											/*!< Worker Thread */
+	SCCP_LIST_HEAD (, sccp_session_t) sessions;								/*!< Sessions owned by this Worker */
+	uint16_t offloaded;											/*!< Number of sessions currently handed to the threadpool (protected by the sessions lock) */
+	pbx_cond_t offloaded_cond;										/*!< Signalled when offloaded drops to zero (used with the sessions lock) */
+};
+
+AST_MUTEX_DEFINE_STATIC(session_engine_lock);
+static struct sccp_session_worker *session_workers = NULL;
+static uint8_t session_num_workers = 0;
+static volatile boolean_t session_engine_running = FALSE;
+
+/*!
+ * \brief Threadpool job running the session cleanup of a session released by its event-loop worker
+ */
+static void *__sccp_session_worker_cleanup(void *data)
+{
+	sccp_netsock_device_thread_exit(data);
+	return NULL;
+}
+
+/*!
+ * \brief Remove a session from its event-loop worker and run the session cleanup
+ * \note only called by whoever currently handles the session (its worker, or the threadpool job it was offloaded to), the
+ *       cleanup itself is handed to the general threadpool while the engine is running
+ */
+static void __sccp_session_worker_release(struct sccp_session_worker *worker, sccp_session_t * s)
+{
+	SCCP_LIST_LOCK(&worker->sessions);
+	SCCP_LIST_REMOVE(&worker->sessions, s, worker_list);
+	SCCP_LIST_UNLOCK(&worker->sessions);
+	if (s->fds[0].fd > 0) {
+		epoll_ctl(worker->epfd, EPOLL_CTL_DEL, s->fds[0].fd, NULL);
+	}
+	s->worker = NULL;
+
+	sccp_log((DEBUGCAT_SOCKET)) (VERBOSE_PREFIX_3 "%s: Exiting sccp_socket event-loop session (worker:%d)\n", DEV_ID_LOG(s->device), worker->id);
+	if (!session_engine_running || !sccp_threadpool_add_work(GLOB(general_threadpool), __sccp_session_worker_cleanup, s)) {
+		sccp_netsock_device_thread_exit(s);							/* engine stopping, the worker is exiting anyway */
+	}
+}
+
+/*!
+ * \brief Threadpool job handling the input and the pending device updates of an offloaded session
+ * \note the session socket is not watched by its worker while this runs, so this is the only one touching the receive ring and
+ *       running __sccp_session_checkPendingUpdate for this session
+ */
+static void *__sccp_session_worker_offloaded(void *data)
+{
+	sccp_session_t *s = (sccp_session_t *) data;
+	struct sccp_session_worker *worker = s->worker;
+	struct epoll_event ev = { 0 };
+	boolean_t release = FALSE;
+
+	if (!s->session_stop && process_buffer(s, s->recv_msg, s->recv_buffer, &s->recv_head, &s->recv_len) != 0) {
+		if (s->device) {
+			sccp_device_sendReset(s->device, SKINNY_DEVICE_RESTART);
+		}
+		__sccp_session_stopthread(s, SKINNY_DEVICE_RS_FAILED);
+	}
+	__sccp_session_checkPendingUpdate(s);
+
+	/* hand the socket back to the worker, or release the session here when it cannot be watched anymore */
+	sccp_mutex_lock(&s->write_lock);
+	s->offloaded = FALSE;
+	if (s->session_stop || s->fds[0].fd <= 0) {
+		release = TRUE;
+	} else {
+		ev.events = EPOLLIN | EPOLLPRI | (s->write_pending ? EPOLLOUT : 0);
+		ev.data.ptr = s;
+		if (epoll_ctl(worker->epfd, EPOLL_CTL_ADD, s->fds[0].fd, &ev) < 0) {
+			pbx_log(LOG_ERROR, "%s: Failed to return session to event-loop worker:%d, error: %s\n", DEV_ID_LOG(s->device), worker->id, strerror(errno));
+			__sccp_session_stopthread(s, SKINNY_DEVICE_RS_FAILED);
+			release = TRUE;
+		}
+	}
+	sccp_mutex_unlock(&s->write_lock);
+	if (release) {												/* housekeeping skips stopped sessions, nobody else would clean it up */
+		__sccp_session_worker_release(worker, s);
+	}
+
+	SCCP_LIST_LOCK(&worker->sessions);
+	if (--worker->offloaded == 0) {
+		pbx_cond_signal(&worker->offloaded_cond);
+	}
+	SCCP_LIST_UNLOCK(&worker->sessions);
+	return NULL;
+}
+
+/*!
+ * \brief Stop watching the session socket and hand its input to the general threadpool
+ */
+static void __sccp_session_worker_offload(sccp_session_t * s)
+{
+	struct sccp_session_worker *worker = s->worker;
+
+	sccp_mutex_lock(&s->write_lock);
+	s->offloaded = TRUE;											/* stops __sccp_session_setWritePending from touching the registration */
+	epoll_ctl(worker->epfd, EPOLL_CTL_DEL, s->fds[0].fd, NULL);
+	sccp_mutex_unlock(&s->write_lock);
+
+	SCCP_LIST_LOCK(&worker->sessions);
+	worker->offloaded++;
+	SCCP_LIST_UNLOCK(&worker->sessions);
+
+	if (!sccp_threadpool_add_work(GLOB(general_threadpool), __sccp_session_worker_offloaded, s)) {
+		__sccp_session_worker_offloaded(s);								/* threadpool shutting down, handle it here */
+	}
+}
+
+/*!
+ * \brief Handle a socket event for an event-loop session
+ * \return -1 when the session has to be cleaned up, 1 when it has been handed to the threadpool (the worker must not touch it
+ *         anymore), 0 otherwise
+ */
+static int __sccp_session_worker_read(sccp_session_t * s, uint32_t events)
+{
+	int result = 0;
+	int res = 0;
+
+	if (events & EPOLLOUT && !__sccp_session_drain(s)) {
+		return -1;
+	}
+	if (events & (EPOLLIN | EPOLLPRI)) {
+		result = session_recv(s, s->recv_buffer, s->recv_head, s->recv_len, MSG_DONTWAIT);
+		if (result < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)) {
+			result = 0;
+		} else if (!(result > 0 && (s->recv_len += result) && (res = process_buffer(s, s->recv_msg, s->recv_buffer, &s->recv_head, &s->recv_len)) >= 0)) {
+			if (s->device) {
+				sccp_device_sendReset(s->device, SKINNY_DEVICE_RESTART);
+			}
+			__sccp_session_stopthread(s, SKINNY_DEVICE_RS_FAILED);
+			return -1;
+		} else {
+			s->lastKeepAlive = time(0);
+		}
+	} else if (events & ~EPOLLOUT) {
+		/* EPOLLHUP / EPOLLERR */
+		pbx_log(LOG_NOTICE, "%s: Closing session because we received POLLHUP/POLLERR\n", DEV_ID_LOG(s->device));
+		__sccp_session_stopthread(s, SKINNY_DEVICE_RS_FAILED);
+		return -1;
+	}
+	if (s->session_stop) {
+		return -1;
+	}
+	if (res > 0 || (s->device && (s->device->pendingUpdate != FALSE || s->device->pendingDelete != FALSE))) {
+		__sccp_session_worker_offload(s);							/* message or device update that may block, the threadpool takes over */
+		return 1;
+	}
+	return 0;
+}
+
+/*!
+ * \brief Stop sessions that did not send anything within their keepalive interval
+ * \note sessions are only marked down here, the resulting socket event makes the worker clean them up
+ */
+static void __sccp_session_worker_housekeeping(struct sccp_session_worker *worker)
+{
+	sccp_session_t *s = NULL;
+	int maxWaitTime;
+	time_t now = time(0);
+
+	SCCP_LIST_LOCK(&worker->sessions);
+	SCCP_LIST_TRAVERSE(&worker->sessions, s, worker_list) {
+		if (s->session_stop) {
+			continue;
+		}
+		if (s->write_pending && !__sccp_session_drain(s)) {						/* output queue stayed full for too long */
+			continue;
+		}
+		maxWaitTime = (s->device) ? s->device->keepalive : GLOB(keepalive);
+		maxWaitTime += (maxWaitTime / 100) * (KEEPALIVE_ADDITIONAL_PERCENT * (__sccp_session_hasSlowDevice(s) ? 2 : 1));
+		if ((int) now >= ((int) s->lastKeepAlive + maxWaitTime)) {
+			pbx_log(LOG_NOTICE, "%s: Closing session because connection timed out after %d seconds (ip-address: %s).\n", DEV_ID_LOG(s->device), maxWaitTime, sccp_netsock_stringify_addr(&s->sin));
+			__sccp_session_stopthread(s, SKINNY_DEVICE_RS_TIMEOUT);
+		}
+	}
+	SCCP_LIST_UNLOCK(&worker->sessions);
+}
+
+/*!
+ * \brief Session Event-Loop Worker Thread
+ * \param data SCCP Session Worker
+ */
+static void *sccp_session_worker_thread(void *data)
+{
+	struct sccp_session_worker *worker = (struct sccp_session_worker *) data;
+	struct epoll_event events[SESSION_EVENTLOOP_MAX_EVENTS];
+	sccp_session_t *s = NULL;
+	time_t lastHousekeeping = time(0);
+	uint64_t wakeup = 0;
+	int res = 0;
+	int i = 0;
+
+	sccp_log((DEBUGCAT_SOCKET)) (VERBOSE_PREFIX_3 "SCCP: Starting session event-loop worker:%d\n", worker->id);
+	while (session_engine_running) {
+		res = epoll_wait(worker->epfd, events, SESSION_EVENTLOOP_MAX_EVENTS, SESSION_EVENTLOOP_TICK);
+		if (res < 0) {
+			if (errno != EINTR) {
+				pbx_log(LOG_ERROR, "SCCP: (worker:%d) epoll_wait() returned %d. errno: %s\n", worker->id, errno, strerror(errno));
+				break;
+			}
+			continue;
+		}
+		for (i = 0; i < res; i++) {
+			s = (sccp_session_t *) events[i].data.ptr;
+			if (!s) {										/* woken up by sccp_session_engine_stop */
+				if (read(worker->wakefd, &wakeup, sizeof(wakeup)) < 0 && errno != EAGAIN) {
+					pbx_log(LOG_ERROR, "SCCP: (worker:%d) could not read wakeup event. errno: %s\n", worker->id, strerror(errno));
+				}
+				continue;
+			}
+			if (s->session_stop || s->fds[0].fd <= 0 || __sccp_session_worker_read(s, events[i].events) < 0) {
+				__sccp_session_worker_release(worker, s);
+			}
+		}
+		if (time(0) - lastHousekeeping >= SESSION_EVENTLOOP_TICK / 1000) {
+			__sccp_session_worker_housekeeping(worker);
+			lastHousekeeping = time(0);
+		}
+	}
+
+	/* engine is stopping, wait for the threadpool to hand back the sessions it is handling, then cleanup the sessions we still own */
+	SCCP_LIST_LOCK(&worker->sessions);
+	while (worker->offloaded) {
+		pbx_cond_wait(&worker->offloaded_cond, &worker->sessions.lock);
+	}
+	while ((s = SCCP_LIST_FIRST(&worker->sessions))) {
+		SCCP_LIST_UNLOCK(&worker->sessions);
+		__sccp_session_worker_release(worker, s);
+		SCCP_LIST_LOCK(&worker->sessions);
+	}
+	SCCP_LIST_UNLOCK(&worker->sessions);
+
+	sccp_log((DEBUGCAT_SOCKET)) (VERBOSE_PREFIX_3 "SCCP: Exiting session event-loop worker:%d\n", worker->id);
+	return NULL;
+}
+
+/*!
+ * \brief Start the Session Event-Loop Workers
+ * \note number of workers is taken from GLOB(session_workers), 0 meaning one per online cpu
+ */
+static boolean_t sccp_session_engine_start(void)
+{
+	struct epoll_event ev = { 0 };
+	struct sccp_session_worker *worker = NULL;
+	uint8_t num_workers = 0;
+	long cpus = 0;
+	int w = 0;
+
+	pbx_mutex_lock(&session_engine_lock);
+	if (session_engine_running) {
+		pbx_mutex_unlock(&session_engine_lock);
+		return TRUE;
+	}
+	num_workers = GLOB(session_workers);
+	if (!num_workers) {
+		cpus = sysconf(_SC_NPROCESSORS_ONLN);
+		num_workers = (cpus > 0) ? (cpus < SESSION_EVENTLOOP_MAX_WORKERS ? cpus : SESSION_EVENTLOOP_MAX_WORKERS) : 1;
+	} else if (num_workers > SESSION_EVENTLOOP_MAX_WORKERS) {
+		num_workers = SESSION_EVENTLOOP_MAX_WORKERS;
+	}
+	if (!(session_workers = sccp_calloc(num_workers, sizeof(struct sccp_session_worker)))) {
+		pbx_log(LOG_ERROR, SS_Memory_Allocation_Error, "SCCP");
+		pbx_mutex_unlock(&session_engine_lock);
+		return FALSE;
+	}
+	for (w = 0; w < num_workers; w++) {
+		worker = &session_workers[w];
+		worker->id = w;
+		worker->epfd = -1;
+		worker->wakefd = -1;
+		worker->thread = AST_PTHREADT_NULL;
+		SCCP_LIST_HEAD_INIT(&worker->sessions);
+		pbx_cond_init(&worker->offloaded_cond, NULL);
+	}
+	for (w = 0; w < num_workers; w++) {
+		worker = &session_workers[w];
+		if ((worker->epfd = epoll_create1(EPOLL_CLOEXEC)) < 0 || (worker->wakefd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)) < 0) {
+			pbx_log(LOG_ERROR, "SCCP: Failed to create session event-loop worker:%d, error: %s\n", w, strerror(errno));
+			break;
+		}
+		ev.events = EPOLLIN;
+		ev.data.ptr = NULL;										/* NULL marks the wakeup descriptor */
+		if (epoll_ctl(worker->epfd, EPOLL_CTL_ADD, worker->wakefd, &ev) < 0) {
+			pbx_log(LOG_ERROR, "SCCP: Failed to setup session event-loop worker:%d, error: %s\n", w, strerror(errno));
+			break;
+		}
+	}
+	if (w == num_workers) {
+		session_engine_running = TRUE;
+		for (w = 0; w < num_workers; w++) {
+			if (pbx_pthread_create(&session_workers[w].thread, NULL, sccp_session_worker_thread, &session_workers[w])) {
+				pbx_log(LOG_ERROR, "SCCP: Failed to start session event-loop worker:%d\n", w);
+				session_workers[w].thread = AST_PTHREADT_NULL;
+				break;
+			}
+		}
+	} else {
+		w = 0;
+	}
+	session_num_workers = w;										/* number of workers actually running */
+	for (w = session_num_workers; w < num_workers; w++) {							/* cleanup the ones that did not make it */
+		worker = &session_workers[w];
+		if (worker->epfd > -1) {
+			close(worker->epfd);
+		}
+		if (worker->wakefd > -1) {
+			close(worker->wakefd);
+		}
+		SCCP_LIST_HEAD_DESTROY(&worker->sessions);
+		pbx_cond_destroy(&worker->offloaded_cond);
+	}
+	if (!session_num_workers) {
+		session_engine_running = FALSE;
+		sccp_free(session_workers);
+	} else {
+		sccp_log((DEBUGCAT_CORE + DEBUGCAT_SOCKET)) (VERBOSE_PREFIX_3 "SCCP: Started session event-loop using %d workers\n", session_num_workers);
+	}
+	pbx_mutex_unlock(&session_engine_lock);
+	return session_num_workers > 0;
+}
+
+/*!
+ * \brief Stop the Session Event-Loop Workers, cleaning up all sessions they still own
+ */
+static void sccp_session_engine_stop(void)
+{
+	struct sccp_session_worker *worker = NULL;
+	uint64_t wakeup = 1;
+	int w = 0;
+
+	pbx_mutex_lock(&session_engine_lock);
+	if (session_workers) {
+		session_engine_running = FALSE;
+		for (w = 0; w < session_num_workers; w++) {
+			if (write(session_workers[w].wakefd, &wakeup, sizeof(wakeup)) < 0) {
+				pbx_log(LOG_ERROR, "SCCP: Failed to wakeup session event-loop worker:%d, error: %s\n", w, strerror(errno));
+			}
+		}
+		for (w = 0; w < session_num_workers; w++) {
+			worker = &session_workers[w];
+			if (worker->thread != AST_PTHREADT_NULL) {
+				pthread_join(worker->thread, NULL);
+			}
+			close(worker->epfd);
+			close(worker->wakefd);
+			SCCP_LIST_HEAD_DESTROY(&worker->sessions);
+			pbx_cond_destroy(&worker->offloaded_cond);
+		}
+		session_num_workers = 0;
+		sccp_free(session_workers);
+	}
+	pbx_mutex_unlock(&session_engine_lock);
+}
+
+/*!
+ * \brief Hand a newly accepted session over to the least loaded event-loop worker
+ * \return FALSE if the session could not be attached (caller falls back to a session thread)
+ */
+static boolean_t sccp_session_engine_attach(sccp_session_t * s)
+{
+	struct epoll_event ev = { 0 };
+	struct sccp_session_worker *worker = NULL;
+	int w = 0;
+
+	if (!session_engine_running && !sccp_session_engine_start()) {
+		return FALSE;
+	}
+	if (!s->recv_buffer && !(s->recv_buffer = sccp_calloc(SESSION_RECV_BUFFER_SIZE, 1))) {
+		pbx_log(LOG_ERROR, SS_Memory_Allocation_Error, "SCCP");
+		return FALSE;
+	}
+	if (!s->recv_msg && !(s->recv_msg = sccp_calloc(1, SCCP_MAX_PACKET))) {
+		pbx_log(LOG_ERROR, SS_Memory_Allocation_Error, "SCCP");
+		return FALSE;
+	}
+	s->recv_head = 0;
+	s->recv_len = 0;
+	s->session_thread = AST_PTHREADT_NULL;
+
+	worker = &session_workers[0];
+	for (w = 1; w < session_num_workers; w++) {
+		if (SCCP_LIST_GETSIZE(&session_workers[w].sessions) < SCCP_LIST_GETSIZE(&worker->sessions)) {
+			worker = &session_workers[w];
+		}
+	}
+
+	s->worker = worker;
+	SCCP_LIST_LOCK(&worker->sessions);
+	SCCP_LIST_INSERT_TAIL(&worker->sessions, s, worker_list);
+	SCCP_LIST_UNLOCK(&worker->sessions);
+
+	ev.events = EPOLLIN | EPOLLPRI;
+	ev.data.ptr = s;
+	if (epoll_ctl(worker->epfd, EPOLL_CTL_ADD, s->fds[0].fd, &ev) < 0) {
+		pbx_log(LOG_ERROR, "%s: Failed to add session to event-loop worker:%d, error: %s\n", s->designator, worker->id, strerror(errno));
+		SCCP_LIST_LOCK(&worker->sessions);
+		SCCP_LIST_REMOVE(&worker->sessions, s, worker_list);
+		SCCP_LIST_UNLOCK(&worker->sessions);
+		s->worker = NULL;
+		return FALSE;
+	}
+	sccp_log((DEBUGCAT_SOCKET)) (VERBOSE_PREFIX_3 "%s: Session handed over to event-loop worker:%d\n", s->designator, worker->id);
+	return TRUE;
+}
+#endif
+
 #define SCCP_SETSOCKETOPTION(_SOCKET, _LEVEL,_OPTIONNAME, _OPTIONVAL, _OPTIONLEN) 							\
 	if (setsockopt(_SOCKET, _LEVEL, _OPTIONNAME, (void*)(_OPTIONVAL), _OPTIONLEN) == -1) {						\
 		if (errno != ENOTSUP) {													\
@@ -780,10 +1423,22 @@ static void sccp_accept_connection(void)
 	
 	memcpy(&s->sin, &incoming, sizeof(s->sin));
 	sccp_mutex_init(&s->lock);
+	sccp_mutex_init(&s->write_lock);
 
 	s->fds[0].events = POLLIN | POLLPRI;
 	s->fds[0].revents = 0;
 	s->fds[0].fd = new_socket;
+	s->fds[1].fd = -1;
+	s->wakefd = -1;
+
+	s->outqueue_size = GLOB(session_outqueue_high) > SESSION_OUTQUEUE_MIN ? GLOB(session_outqueue_high) : SESSION_OUTQUEUE_MIN;
+	s->outqueue_high = s->outqueue_size * 3 / 4;								/* leave room for non-status messages while congested */
+	s->outqueue_low = GLOB(session_outqueue_low) < s->outqueue_high ? GLOB(session_outqueue_low) : s->outqueue_size / 2;
+	if (!(s->outqueue = sccp_calloc(s->outqueue_size, sizeof(sccp_msg_t *)))) {
+		pbx_log(LOG_ERROR, SS_Memory_Allocation_Error, "SCCP");
+		destroy_session(s, 0);
+		return;
+	}
 
 	if (!GLOB(ha)) {
 		pbx_log(LOG_NOTICE, "No global ha list\n");
@@ -836,8 +1491,28 @@ static void sccp_accept_connection(void)
 
 	sccp_log((DEBUGCAT_CORE)) (VERBOSE_PREFIX_3 "SCCP: Connected on server via %s\n", s->designator);
 
+#ifdef SCCP_SESSION_EVENTLOOP
+	if (GLOB(session_eventloop)) {
+		if (sccp_session_engine_attach(s)) {
+			return;
+		}
+		pbx_log(LOG_WARNING, "%s: Could not hand session over to the event-loop, falling back to a session thread\n", s->designator);
+	}
+#endif
 	size_t stacksize = 0;
 	pthread_attr_t attr;
+	int wakeup[2];
+
+	if (pipe(wakeup) == 0) {										/* allows other threads to wakeup the session thread when there is output pending */
+		fcntl(wakeup[0], F_SETFL, fcntl(wakeup[0], F_GETFL) | O_NONBLOCK);
+		fcntl(wakeup[1], F_SETFL, fcntl(wakeup[1], F_GETFL) | O_NONBLOCK);
+		s->fds[1].fd = wakeup[0];
+		s->fds[1].events = POLLIN;
+		s->fds[1].revents = 0;
+		s->wakefd = wakeup[1];
+	} else {
+		pbx_log(LOG_WARNING, "%s: Could not create wakeup pipe for session thread, error: %s\n", s->designator, strerror(errno));
+	}
 
 	pthread_attr_init(&attr);
 	pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
@@ -858,6 +1533,11 @@ static void sccp_netsock_cleanup_timed_out(void)
 	pbx_rwlock_unlock(&GLOB(lock));
 	if (module_running && !reload_in_progress) {
 		SCCP_LIST_TRAVERSE_SAFE_BEGIN(&GLOB(sessions), session, list) {
+#ifdef SCCP_SESSION_EVENTLOOP
+			if (session->worker) {									/* event-loop workers handle their own timeouts */
+				continue;
+			}
+#endif
 			if (session->lastKeepAlive == 0) {
 				// final resort
 				SCCP_LIST_REMOVE_CURRENT(list);
@@ -976,14 +1656,284 @@ int sccp_session_send(constDevicePtr device, const sccp_msg_t * msg_in)
 	if (s && !s->session_stop) {
 		return sccp_session_send2(s, msg);
 	} 
+	sccp_free_packet(msg);
 	return -1;
 }
 
+/*!
+ * \brief Ask the I/O loop servicing this session to (stop) watch(ing) the socket for writability
+ * \param s SCCP Session
+ * \param pending TRUE when there is queued output the I/O loop should drain
+ *
+ * \lock
+ *      - session->write_lock (needs to be held by the caller)
+ */
+static void __sccp_session_setWritePending(sccp_session_t * s, boolean_t pending)
+{
+	if (s->write_pending == pending) {
+		return;
+	}
+	s->write_pending = pending;
+#ifdef SCCP_SESSION_EVENTLOOP
+	if (s->worker) {
+		struct epoll_event ev = { 0 };
+		if (s->offloaded) {										/* registration is restored with the current write_pending when the session is handed back */
+			return;
+		}
+		ev.events = EPOLLIN | EPOLLPRI | (pending ? EPOLLOUT : 0);
+		ev.data.ptr = s;
+		if (epoll_ctl(s->worker->epfd, EPOLL_CTL_MOD, s->fds[0].fd, &ev) < 0 && errno != ENOENT) {
+			pbx_log(LOG_ERROR, "%s: Failed to update event-loop registration, error: %s\n", DEV_ID_LOG(s->device), strerror(errno));
+		}
+		return;
+	}
+#endif
+	if (pending && s->wakefd > -1) {
+		char wakeup = 1;
+		if (write(s->wakefd, &wakeup, sizeof(wakeup)) < 0 && errno != EAGAIN) {
+			pbx_log(LOG_ERROR, "%s: Failed to wakeup session thread, error: %s\n", DEV_ID_LOG(s->device), strerror(errno));
+		}
+	}
+}
+
+/*!
+ * \brief Write as many queued messages to the socket as it will take without blocking
+ * \param s SCCP Session
+ * \return Number of bytes written or -1 on failure (the caller should stop the session)
+ *
+ * \note whatever could not be written stays queued and is picked up by the I/O loop once the socket becomes writable
+ *
+ * \lock
+ *      - session->write_lock (needs to be held by the caller)
+ */
+static int __sccp_session_flush(sccp_session_t * s)
+{
+	struct iovec iov[SESSION_OUTQUEUE_IOV];
+	struct msghdr mh = { 0 };
+	int bytesSent = 0;
+
+	while (s->outqueue_len > 0 && !s->session_stop && s->fds[0].fd > 0) {
+		int iovcnt = 0;
+		uint16_t idx;
+		for (idx = 0; idx < s->outqueue_len && iovcnt < SESSION_OUTQUEUE_IOV; idx++, iovcnt++) {
+			sccp_msg_t *msg = s->outqueue[(s->outqueue_head + idx) % s->outqueue_size];
+			size_t skip = (idx == 0) ? s->outqueue_offset : 0;
+			iov[iovcnt].iov_base = (uint8_t *) msg + skip;
+			iov[iovcnt].iov_len = letohl(msg->header.length) + 8 - skip;
+		}
+		mh.msg_iov = iov;
+		mh.msg_iovlen = iovcnt;
+		ssize_t res = sendmsg(s->fds[0].fd, &mh, MSG_DONTWAIT);
+		if (res < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			if (errno == EAGAIN || errno == EWOULDBLOCK) {
+				break;										/* socket buffer is full, the I/O loop will continue */
+			}
+			socket_get_error(s, __FILE__, __LINE__, __PRETTY_FUNCTION__, errno);
+			bytesSent = -1;
+			break;
+		}
+		s->sent_syscalls++;
+		bytesSent += res;
+
+		/* retire the messages which have been written completely */
+		while (res > 0 && s->outqueue_len > 0) {
+			sccp_msg_t *msg = s->outqueue[s->outqueue_head];
+			size_t remaining = letohl(msg->header.length) + 8 - s->outqueue_offset;
+			if ((size_t) res < remaining) {
+				s->outqueue_offset += res;
+				break;
+			}
+			res -= remaining;
+			s->outqueue_offset = 0;
+			s->outqueue[s->outqueue_head] = NULL;
+			s->outqueue_head = (s->outqueue_head + 1) % s->outqueue_size;
+			s->outqueue_len--;
+			s->sent_messages++;
+			sccp_free_packet(msg);
+		}
+	}
+
+	if (s->outqueue_congested && s->outqueue_len <= s->outqueue_low) {
+		sccp_log((DEBUGCAT_SOCKET)) (VERBOSE_PREFIX_3 "%s: Output queue drained below low watermark (%d), accepting messages again\n", DEV_ID_LOG(s->device), s->outqueue_low);
+		s->outqueue_congested = 0;
+	}
+	__sccp_session_setWritePending(s, bytesSent >= 0 && s->outqueue_len > 0 && !s->session_stop);
+	return bytesSent;
+}
+
+/*!
+ * \brief Check if the output queue has been congested for too long
+ * \return TRUE when the session should be torn down
+ *
+ * \lock
+ *      - session->write_lock (needs to be held by the caller)
+ */
+static gcc_inline boolean_t __sccp_session_outqueueStalled(constSessionPtr s)
+{
+	return s->outqueue_congested && time(0) - s->outqueue_congested >= GLOB(session_outqueue_timeout);
+}
+
+/*!
+ * \brief Status messages which only carry the latest state of something, a newer one makes the queued one obsolete
+ */
+static gcc_inline boolean_t __sccp_session_isStatusMessage(uint32_t msgid)
+{
+	return msgid == FeatureStatMessage || msgid == FeatureStatDynamicMessage;
+}
+
+/*!
+ * \brief Feature index a status message applies to
+ */
+static gcc_inline uint32_t __sccp_session_statusIndex(const sccp_msg_t * msg)
+{
+	if (letohl(msg->header.lel_messageId) == FeatureStatDynamicMessage) {
+		return msg->data.FeatureStatDynamicMessage.lel_featureIndex;
+	}
+	return msg->data.FeatureStatMessage.lel_featureIndex;
+}
+
+/*!
+ * \brief Replace a queued status message which is made obsolete by msg (i.e. a FeatureStat for the same button)
+ * \return TRUE when msg took the place of an older message
+ *
+ * \lock
+ *      - session->write_lock (needs to be held by the caller)
+ */
+static boolean_t __sccp_session_supersede(sccp_session_t * s, sccp_msg_t * msg)
+{
+	uint32_t msgid = letohl(msg->header.lel_messageId);
+	uint16_t idx;
+
+	if (!__sccp_session_isStatusMessage(msgid)) {
+		return FALSE;
+	}
+	for (idx = (s->outqueue_offset > 0) ? 1 : 0; idx < s->outqueue_len; idx++) {				/* a partially written message can not be replaced */
+		uint16_t pos = (s->outqueue_head + idx) % s->outqueue_size;
+		sccp_msg_t *queued = s->outqueue[pos];
+		if (queued->header.lel_messageId == msg->header.lel_messageId && __sccp_session_statusIndex(queued) == __sccp_session_statusIndex(msg)) {
+			s->outqueue[pos] = msg;
+			s->superseded_messages++;
+			sccp_free_packet(queued);
+			return TRUE;
+		}
+	}
+	return FALSE;
+}
+
+/*!
+ * \brief Called by the I/O loop when the socket of a session with pending output became writable
+ * \return FALSE when the session has to be stopped
+ */
+static boolean_t __sccp_session_drain(sccp_session_t * s)
+{
+	int res = 0;
+	boolean_t stalled = FALSE;
+
+	pbx_mutex_lock(&s->write_lock);
+	if (!s->cork || s->outqueue_congested) {								/* a full queue is written even when corked */
+		res = __sccp_session_flush(s);
+	}
+	stalled = __sccp_session_outqueueStalled(s);
+	pbx_mutex_unlock(&s->write_lock);
+
+	if (stalled) {
+		pbx_log(LOG_WARNING, "%s: Closing session because the output queue stayed full for more than %d seconds\n", DEV_ID_LOG(s->device), GLOB(session_outqueue_timeout));
+	}
+	if (res < 0 || stalled) {
+		__sccp_session_stopthread(s, SKINNY_DEVICE_RS_FAILED);
+		return FALSE;
+	}
+	return TRUE;
+}
+
+/*!
+ * \brief Cork Session, messages sent to this session are queued until the matching sccp_session_uncork
+ * \param session SCCP Session (can be null)
+ *
+ * \note calls can be nested, used to combine the burst of messages produced by an indicate transition into a single writev.
+ *       Callers which only hold a device should use sccp_session_corkDevice, instead of keeping device->session around.
+ */
+void sccp_session_cork(constSessionPtr session)
+{
+	sccp_session_t * const s = (sessionPtr) session;								/* discard const */
+
+	if (s) {
+		pbx_mutex_lock(&s->write_lock);
+		s->cork++;
+		pbx_mutex_unlock(&s->write_lock);
+	}
+}
+
+/*!
+ * \brief Uncork Session, the queued messages are written when the outermost cork is removed
+ * \param session SCCP Session (can be null)
+ */
+void sccp_session_uncork(constSessionPtr session)
+{
+	sccp_session_t * const s = (sessionPtr) session;								/* discard const */
+	int res = 0;
+
+	if (s) {
+		pbx_mutex_lock(&s->write_lock);
+		if (s->cork > 0 && --s->cork == 0 && s->outqueue_len > 0) {
+			res = __sccp_session_flush(s);
+		}
+		pbx_mutex_unlock(&s->write_lock);
+		if (res < 0) {
+			__sccp_session_stopthread(s, SKINNY_DEVICE_RS_FAILED);
+		}
+	}
+}
+
+/*!
+ * \brief Cork the current session of a device
+ * \param device SCCP Device (can be null)
+ *
+ * \note the session is looked up on every call and never kept by the caller, a session which gets replaced or destroyed in
+ *       between the cork and the uncork is not touched (the uncork will not underflow the cork of the new session)
+ *
+ * \lock
+ *      - sessions
+ */
+void sccp_session_corkDevice(constDevicePtr device)
+{
+	if (device) {
+		SCCP_RWLIST_RDLOCK(&GLOB(sessions));
+		sccp_session_cork(device->session);
+		SCCP_RWLIST_UNLOCK(&GLOB(sessions));
+	}
+}
+
+/*!
+ * \brief Uncork the current session of a device
+ * \param device SCCP Device (can be null)
+ *
+ * \lock
+ *      - sessions
+ */
+void sccp_session_uncorkDevice(constDevicePtr device)
+{
+	if (device) {
+		SCCP_RWLIST_RDLOCK(&GLOB(sessions));
+		sccp_session_uncork(device->session);
+		SCCP_RWLIST_UNLOCK(&GLOB(sessions));
+	}
+}
+
 /*!
  * \brief Socket Send Message
  * \param s Session SCCP Session (can't be null)
  * \param msg Message Data Structure (sccp_msg_t) (Will be freed automatically at the end)
- * \return Result as Int
+ * \return Number of bytes written, 0 when the message was queued, -1 on failure or when the message was dropped
+ *
+ * \note never blocks, messages the socket does not accept right away are queued and written by the I/O loop.
+ *       Once the queue reaches session_outqueue_high it is written out even when the session is corked, and new status
+ *       messages (FeatureStat) are dropped until it has drained below session_outqueue_low. Any other message which does
+ *       not fit anymore stops the session instead of being lost, as does a queue which does not drain within
+ *       session_outqueue_timeout seconds.
  *
  * \lock
  *      - session
@@ -991,13 +1941,13 @@ int sccp_session_send(constDevicePtr device, const sccp_msg_t * msg_in)
 int sccp_session_send2(constSessionPtr session, sccp_msg_t * msg)
 {
 	sccp_session_t * const s = (sessionPtr) session;								/* discard const */
-	ssize_t res = 0;
+	int res = 0;
+	boolean_t stalled = FALSE;
+	boolean_t failed = FALSE;
 	uint32_t msgid = letohl(msg->header.lel_messageId);
-	ssize_t bytesSent;
-	ssize_t bufLen;
-	uint8_t *bufAddr;
 
 	if (s && s->session_stop) {
+		sccp_free_packet(msg);
 		return -1;
 	}
 
@@ -1006,11 +1956,9 @@ int sccp_session_send2(constSessionPtr session, sccp_msg_t * msg)
 		if (s) {
 			__sccp_session_stopthread(s, SKINNY_DEVICE_RS_FAILED);
 		}
-		sccp_free(msg);
-		msg = NULL;
+		sccp_free_packet(msg);
 		return -1;
 	}
-	int mysocket = s->fds[0].fd;
 
 	if (msgid == KeepAliveAckMessage || msgid == RegisterAckMessage || msgid == UnregisterAckMessage) {
 		msg->header.lel_protocolVer = 0;
@@ -1027,36 +1975,44 @@ int sccp_session_send2(constSessionPtr session, sccp_msg_t * msg)
 		sccp_dump_msg(msg);
 	}
 
-	uint backoff = WRITE_BACKOFF;
-	bytesSent = 0;
-	bufAddr = ((uint8_t *) msg);
-	bufLen = (ssize_t) (letohl(msg->header.length) + 8);
-	do {
-		pbx_mutex_lock(&s->write_lock);									/* prevent two threads writing at the same time. That should happen in a synchronized way */
-		res = send(mysocket, bufAddr + bytesSent, bufLen - bytesSent, 0);
-		pbx_mutex_unlock(&s->write_lock);
-		if (res <= 0) {
-			if (errno == EINTR) {
-				usleep(backoff);								/* back off to give network/other threads some time */
-				backoff *= 2;
-				continue;
-			}
-			socket_get_error(s, __FILE__, __LINE__, __PRETTY_FUNCTION__, errno);
-			if (s) {
-				__sccp_session_stopthread(s, SKINNY_DEVICE_RS_FAILED);
-			}
-			res = -1;
-			break;
+	pbx_mutex_lock(&s->write_lock);										/* prevent two threads writing at the same time. That should happen in a synchronized way */
+	if (__sccp_session_supersede(s, msg)) {
+		msg = NULL;
+	} else if (s->outqueue_len >= s->outqueue_size && __sccp_session_flush(s) < 0) {				/* try to make room, even when corked */
+		sccp_free_packet(msg);
+		failed = TRUE;
+		res = -1;
+	} else if (s->outqueue_congested && __sccp_session_isStatusMessage(msgid)) {
+		sccp_log((DEBUGCAT_SOCKET)) (VERBOSE_PREFIX_3 "%s: Output queue congested (%d messages), dropping %s\n", DEV_ID_LOG(s->device), s->outqueue_len, msgtype2str(msgid));
+		s->dropped_messages++;
+		sccp_free_packet(msg);
+		stalled = __sccp_session_outqueueStalled(s);
+		res = -1;
+	} else if (s->outqueue_len >= s->outqueue_size) {
+		pbx_log(LOG_WARNING, "%s: Output queue full (%d messages), closing session instead of dropping %s\n", DEV_ID_LOG(s->device), s->outqueue_len, msgtype2str(msgid));
+		s->dropped_messages++;
+		sccp_free_packet(msg);
+		failed = TRUE;
+		res = -1;
+	} else {
+		s->outqueue[(s->outqueue_head + s->outqueue_len++) % s->outqueue_size] = msg;
+		if (s->outqueue_len >= s->outqueue_high && !s->outqueue_congested) {
+			pbx_log(LOG_NOTICE, "%s: Output queue reached high watermark (%d), dropping status messages until it drains\n", DEV_ID_LOG(s->device), s->outqueue_high);
+			s->outqueue_congested = time(0);
 		}
-		bytesSent += res;
-	} while (bytesSent < bufLen && s && !s->session_stop && mysocket > 0);
-
-	sccp_free(msg);
+		if ((!s->cork || s->outqueue_congested) && (res = __sccp_session_flush(s)) < 0) {
+			failed = TRUE;
+		}
+		stalled = __sccp_session_outqueueStalled(s);
+	}
+	pbx_mutex_unlock(&s->write_lock);
 	msg = NULL;
 
-	if (bytesSent < bufLen) {
-		pbx_log(LOG_ERROR, "%s: Could only send %d of %d bytes!\n", DEV_ID_LOG(s->device), (int) bytesSent, (int) bufLen);
-		res = -1;
+	if (stalled) {
+		pbx_log(LOG_WARNING, "%s: Closing session because the output queue stayed full for more than %d seconds\n", DEV_ID_LOG(s->device), GLOB(session_outqueue_timeout));
+	}
+	if (stalled || failed) {
+		__sccp_session_stopthread(s, SKINNY_DEVICE_RS_FAILED);
 	}
 
 	return res;
@@ -1091,6 +2047,12 @@ void sccp_session_destroySessionsByDeviceName(const char *name)
 			sccp_device_setRegistrationState(d, SKINNY_DEVICE_RS_NONE);
 			d->needcheckringback = 0;
 			sccp_dev_clean(d, (d->realtime) ? TRUE : FALSE, 0);
+#ifdef SCCP_SESSION_EVENTLOOP
+			if (session->worker) {								/* session is owned by an event-loop worker, let it do the cleanup */
+				__sccp_session_stopthread(session, SKINNY_DEVICE_RS_NONE);
+				continue;
+			}
+#endif
 			destroy_session(session, 1);
 		}
 	}
@@ -1101,11 +2063,8 @@ sccp_session_t *sccp_session_findByIP(const struct sockaddr_storage *sin)
 {
 	sccp_session_t *session = NULL;
 	SCCP_RWLIST_RDLOCK(&GLOB(sessions));
-	SCCP_RWLIST_TRAVERSE(&GLOB(sessions), session, list) {
-		if (sccp_netsock_cmp_addr(&session->sin, sin) == 0) {
-			sccp_log((DEBUGCAT_SOCKET)) (VERBOSE_PREFIX_3 "%s: (sccp_session_findByIP) Found session:%p\n", DEV_ID_LOG(session->device), session);
-			break;
-		}
+	if ((session = sccp_hashtable_find(GLOB(session_index), sin))) {
+		sccp_log((DEBUGCAT_SOCKET)) (VERBOSE_PREFIX_3 "%s: (sccp_session_findByIP) Found session:%p\n", DEV_ID_LOG(session->device), session);
 	}
 	SCCP_RWLIST_UNLOCK(&GLOB(sessions));
 	return session;
@@ -1390,7 +2349,12 @@ int sccp_cli_show_sessions(int fd, sccp_cli_totals_t *totals, struct mansession
 		CLI_AMI_TABLE_FIELD(State,		"-14.14",	s,	14,	(d) ? sccp_devicestate2str(sccp_device_getDeviceState(d)) : "--")		\
 		CLI_AMI_TABLE_FIELD(Type,		"-15.15",	s,	15,	(d) ? skinny_devicetype2str(d->skinny_type) : "--")	\
 		CLI_AMI_TABLE_FIELD(RegState,		"-10.10",	s,	10,	(d) ? skinny_registrationstate2str(sccp_device_getRegistrationState(d)) : "--")	\
-		CLI_AMI_TABLE_FIELD(Token,		"-10.10",	s,	10,	d ? sccp_tokenstate2str(d->status.token) : "--")
+		CLI_AMI_TABLE_FIELD(Token,		"-10.10",	s,	10,	d ? sccp_tokenstate2str(d->status.token) : "--")		\
+		CLI_AMI_TABLE_FIELD(Sent,		"-8",		u,	8,	session->sent_messages)					\
+		CLI_AMI_TABLE_FIELD(MsgPerWr,		"-8.2",		f,	8,	session->sent_syscalls ? (double) session->sent_messages / session->sent_syscalls : 0.0)	\
+		CLI_AMI_TABLE_FIELD(OutQ,		"-5",		d,	5,	session->outqueue_len)					\
+		CLI_AMI_TABLE_FIELD(Supers,		"-6",		u,	6,	session->superseded_messages)				\
+		CLI_AMI_TABLE_FIELD(Drops,		"-6",		u,	6,	session->dropped_messages)
 #include "sccp_cli_table.h"
 
 	if (s) {
@@ -18,6 +18,10 @@ SCCP_API const char *const SCCP_CALL sccp_session_getDesignator(constSessionPtr
 SCCP_API void SCCP_CALL sccp_session_sendmsg(constDevicePtr device, sccp_mid_t t);
 SCCP_API int SCCP_CALL sccp_session_send(constDevicePtr device, const sccp_msg_t * msg_in);
 SCCP_API int SCCP_CALL sccp_session_send2(constSessionPtr session, sccp_msg_t * msg);
+SCCP_API void SCCP_CALL sccp_session_cork(constSessionPtr session);
+SCCP_API void SCCP_CALL sccp_session_uncork(constSessionPtr session);
+SCCP_API void SCCP_CALL sccp_session_corkDevice(constDevicePtr device);
+SCCP_API void SCCP_CALL sccp_session_uncorkDevice(constDevicePtr device);
 SCCP_API int SCCP_CALL sccp_session_retainDevice(constSessionPtr session, constDevicePtr device);
 SCCP_API void SCCP_CALL sccp_session_releaseDevice(constSessionPtr volatile session);
 SCCP_API sccp_session_t * SCCP_CALL sccp_session_reject(constSessionPtr session, char *message);
@@ -22,6 +22,8 @@ SCCP_FILE_VERSION(__FILE__, "");
 #endif
 #define SEMAPHORE_LOCKED	(0)
 #define SEMAPHORE_UNLOCKED	(1)
+#define THREADPOOL_QUEUES THREADPOOL_MAX_SIZE									/* number of job queues (threads beyond this number share a queue) */
+#define THREADPOOL_JOBPOOL_SIZE 256										/* number of released job nodes kept for reuse */
 void sccp_threadpool_grow(sccp_threadpool_t * tp_p, int amount);
 void sccp_threadpool_shrink(sccp_threadpool_t * tp_p, int amount);
 
@@ -32,14 +34,33 @@ struct sccp_threadpool_thread {
 	sccp_threadpool_t *tp_p;
 	SCCP_LIST_ENTRY (sccp_threadpool_thread_t) list;
 	boolean_t die;
+	int queue;												/*!< Index of the queue owned by this thread */
+};
+
+/* Job queue (one per thread) */
+struct sccp_threadpool_queue {
+	SCCP_LIST_HEAD (, sccp_threadpool_job_t) jobs;
+	uint32_t busy_keys[THREADPOOL_MAX_SIZE];								/*!< Keys of the keyed jobs taken from this queue which are still running */
+	int num_busy;												/*!< Number of entries in busy_keys */
+	int high_water_mark;											/*!< Highest number of jobs queued */
+	uint64_t executed;											/*!< Number of jobs taken from this queue */
+	uint64_t stolen;											/*!< Number of jobs taken by a thread not owning this queue */
+	uint64_t wait_total;											/*!< Accumulated time jobs spend waiting in this queue (usec) */
+	uint64_t wait_max;											/*!< Longest time a job had to wait in this queue (usec) */
 };
 
 /* The threadpool */
 struct sccp_threadpool {
-	SCCP_LIST_HEAD (, sccp_threadpool_job_t) jobs;
+	struct sccp_threadpool_queue queues[THREADPOOL_QUEUES];
 	SCCP_LIST_HEAD (, sccp_threadpool_thread_t) threads;
+	SCCP_LIST_HEAD (, sccp_threadpool_job_t) freejobs;							/*!< Released job nodes, reused by sccp_threadpool_add_work */
+	sccp_mutex_t lock;											/*!< Protects generation, used together with the work condition */
 	pbx_cond_t work;
 	pbx_cond_t exit;
+	volatile int num_jobs;											/*!< Number of jobs queued over all queues */
+	unsigned int generation;										/*!< Incremented whenever new work becomes available */
+	unsigned int next_queue;										/*!< Round robin queue selection for jobs without a key */
+	int next_thread_queue;											/*!< Queue assigned to the next thread created */
 	time_t last_size_check;											/*!< Time since last size check */
 	time_t last_resize;											/*!< Time since last resize */
 	int job_high_water_mark;										/*!< Highest number of jobs outstanding since last resize check */
@@ -62,6 +83,7 @@ sccp_threadpool_t *sccp_threadpool_init(int threadsN)
 {
 	sccp_log((DEBUGCAT_CORE)) (VERBOSE_PREFIX_2 "Starting Threadpool\n");
 	sccp_threadpool_t *tp_p;
+	int q;
 
 #if defined(__GNUC__) && __GNUC__ > 3 && defined(HAVE_SYS_INFO_H)
 	threadsN = get_nprocs_conf();										// get current number of active processors
@@ -81,8 +103,12 @@ sccp_threadpool_t *sccp_threadpool_init(int threadsN)
 	/* initialize the thread pool */
 	SCCP_LIST_HEAD_INIT(&tp_p->threads);
 
-	/* Initialise the job queue */
-	SCCP_LIST_HEAD_INIT(&tp_p->jobs);
+	/* Initialise the job queues */
+	for (q = 0; q < THREADPOOL_QUEUES; q++) {
+		SCCP_LIST_HEAD_INIT(&tp_p->queues[q].jobs);
+	}
+	SCCP_LIST_HEAD_INIT(&tp_p->freejobs);
+	sccp_mutex_init(&tp_p->lock);
 	tp_p->last_size_check = time(0);
 	tp_p->job_high_water_mark = 0;
 	tp_p->last_resize = time(0);
@@ -101,6 +127,19 @@ sccp_threadpool_t *sccp_threadpool_init(int threadsN)
 	return tp_p;
 }
 
+/* wake up one (or all) threads waiting for work */
+static void sccp_threadpool_wakeup(sccp_threadpool_t * tp_p, boolean_t all)
+{
+	sccp_mutex_lock(&tp_p->lock);
+	tp_p->generation++;
+	if (all) {
+		pbx_cond_broadcast(&(tp_p->work));
+	} else {
+		pbx_cond_signal(&(tp_p->work));
+	}
+	sccp_mutex_unlock(&tp_p->lock);
+}
+
 // sccp_threadpool_grow needs to be called with locked &(tp_p->threads)->lock
 void sccp_threadpool_grow(sccp_threadpool_t * tp_p, int amount)
 {
@@ -116,6 +155,7 @@ void sccp_threadpool_grow(sccp_threadpool_t * tp_p, int amount)
 			}
 			tp_thread->die = FALSE;
 			tp_thread->tp_p = tp_p;
+			tp_thread->queue = tp_p->next_thread_queue++ % THREADPOOL_QUEUES;
 
 			pthread_attr_init(&attr);
 			pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
@@ -125,8 +165,8 @@ void sccp_threadpool_grow(sccp_threadpool_t * tp_p, int amount)
 			SCCP_LIST_INSERT_HEAD(&(tp_p->threads), tp_thread, list);
 			SCCP_LIST_UNLOCK(&(tp_p->threads));
 			pbx_pthread_create(&(tp_thread->thread), &attr, (void *) sccp_threadpool_thread_do, (void *) tp_thread);
-			sccp_log((DEBUGCAT_CORE)) (VERBOSE_PREFIX_3 "Created thread %d(%p) in pool \n", t, (void *) tp_thread->thread);
-			pbx_cond_broadcast(&(tp_p->work));
+			sccp_log((DEBUGCAT_CORE)) (VERBOSE_PREFIX_3 "Created thread %d(%p) in pool, owning queue %d\n", t, (void *) tp_thread->thread, tp_thread->queue);
+			sccp_threadpool_wakeup(tp_p, TRUE);
 		}
 	}
 }
@@ -151,7 +191,7 @@ void sccp_threadpool_shrink(sccp_threadpool_t * tp_p, int amount)
 			if (tp_thread) {
 				// wake up all threads
 				sccp_log((DEBUGCAT_CORE)) (VERBOSE_PREFIX_3 "Sending die signal to thread %p in pool \n", (void *) tp_thread->thread);
-				pbx_cond_broadcast(&(tp_p->work));
+				sccp_threadpool_wakeup(tp_p, TRUE);
 			}
 		}
 	}
@@ -164,19 +204,19 @@ static void sccp_threadpool_check_size(sccp_threadpool_t * tp_p)
 		sccp_log((DEBUGCAT_THPOOL)) (VERBOSE_PREFIX_3 "(sccp_threadpool_check_resize) in thread: %p\n", (void *) pthread_self());
 		SCCP_LIST_LOCK(&(tp_p->threads));
 		{
-			if (SCCP_LIST_GETSIZE(&tp_p->jobs) > (SCCP_LIST_GETSIZE(&tp_p->threads) * 2) && SCCP_LIST_GETSIZE(&tp_p->threads) < THREADPOOL_MAX_SIZE) {	// increase
+			if (tp_p->num_jobs > (SCCP_LIST_GETSIZE(&tp_p->threads) * 2) && SCCP_LIST_GETSIZE(&tp_p->threads) < THREADPOOL_MAX_SIZE) {	// increase
 				sccp_log((DEBUGCAT_CORE)) (VERBOSE_PREFIX_3 "Add new thread to threadpool %p\n", tp_p);
 				sccp_threadpool_grow(tp_p, 1);
 				tp_p->last_resize = time(0);
 			} else if (((time(0) - tp_p->last_resize) > THREADPOOL_RESIZE_INTERVAL * 3) &&		// wait a little longer to decrease
-				   (SCCP_LIST_GETSIZE(&tp_p->threads) > THREADPOOL_MIN_SIZE && SCCP_LIST_GETSIZE(&tp_p->jobs) < (SCCP_LIST_GETSIZE(&tp_p->threads) / 2))) {	// decrease
+				   (SCCP_LIST_GETSIZE(&tp_p->threads) > THREADPOOL_MIN_SIZE && tp_p->num_jobs < (SCCP_LIST_GETSIZE(&tp_p->threads) / 2))) {	// decrease
 				sccp_log((DEBUGCAT_CORE)) (VERBOSE_PREFIX_3 "Remove thread %d from threadpool %p\n", SCCP_LIST_GETSIZE(&tp_p->threads) - 1, tp_p);
 				// kill last thread only if it is not executed by itself
 				sccp_threadpool_shrink(tp_p, 1);
 				tp_p->last_resize = time(0);
 			}
 			tp_p->last_size_check = time(0);
-			tp_p->job_high_water_mark = SCCP_LIST_GETSIZE(&tp_p->jobs);
+			tp_p->job_high_water_mark = tp_p->num_jobs;
 			sccp_log((DEBUGCAT_THPOOL)) (VERBOSE_PREFIX_3 "(sccp_threadpool_check_resize) Number of threads: %d, job_high_water_mark: %d\n", SCCP_LIST_GETSIZE(&tp_p->threads), tp_p->job_high_water_mark);
 		}
 		SCCP_LIST_UNLOCK(&(tp_p->threads));
@@ -199,12 +239,91 @@ static void sccp_threadpool_thread_end(void *p)
 	}
 }
 
+/* Is a job with this key taken from the queue still running (called with the queue lock held) */
+static gcc_inline boolean_t sccp_threadpool_key_busy(struct sccp_threadpool_queue *q, uint32_t key)
+{
+	int k;
+
+	if (q->num_busy >= THREADPOOL_MAX_SIZE) {								/* no room to track another key, wait for one to finish */
+		return TRUE;
+	}
+	for (k = 0; k < q->num_busy; k++) {
+		if (q->busy_keys[k] == key) {
+			return TRUE;
+		}
+	}
+	return FALSE;
+}
+
+/* 
+ * Take the next runnable job, starting at the queue owned by this thread and stealing from the others when it is empty
+ * A keyed job is only taken while no other job with the same key is running, which keeps the jobs of one key in order
+ * without holding up the other keys sharing the queue.
+ */
+static sccp_threadpool_job_t *sccp_threadpool_take_job(sccp_threadpool_t * tp_p, int ownqueue, struct sccp_threadpool_queue **queue)
+{
+	sccp_threadpool_job_t *job = NULL;
+	struct sccp_threadpool_queue *q = NULL;
+	struct timeval now = pbx_tvnow();
+	int i;
+
+	for (i = 0; i < THREADPOOL_QUEUES && !job; i++) {
+		q = &tp_p->queues[(ownqueue + i) % THREADPOOL_QUEUES];
+		if (SCCP_LIST_GETSIZE(&q->jobs) == 0) {								/* unlocked peek, skip empty queues cheaply */
+			continue;
+		}
+		SCCP_LIST_LOCK(&q->jobs);
+		SCCP_LIST_TRAVERSE_SAFE_BEGIN(&q->jobs, job, list) {
+			if (!job->key || !sccp_threadpool_key_busy(q, job->key)) {
+				SCCP_LIST_REMOVE_CURRENT(list);
+				break;
+			}
+		}
+		SCCP_LIST_TRAVERSE_SAFE_END;
+		if (job) {
+			uint64_t wait = ast_tvdiff_us(now, job->queued);
+			if (job->key) {
+				q->busy_keys[q->num_busy++] = job->key;
+			}
+			q->executed++;
+			if (i > 0) {
+				q->stolen++;
+			}
+			q->wait_total += wait;
+			if (wait > q->wait_max) {
+				q->wait_max = wait;
+			}
+			*queue = q;
+		}
+		SCCP_LIST_UNLOCK(&q->jobs);
+	}
+	if (job) {
+		ATOMIC_DECR(&tp_p->num_jobs, 1, &tp_p->lock);
+	}
+	return job;
+}
+
+/* Return a job node to the pool, or free it when the pool is full */
+static void sccp_threadpool_release_job(sccp_threadpool_t * tp_p, sccp_threadpool_job_t * job)
+{
+	SCCP_LIST_LOCK(&tp_p->freejobs);
+	if (SCCP_LIST_GETSIZE(&tp_p->freejobs) < THREADPOOL_JOBPOOL_SIZE) {
+		SCCP_LIST_INSERT_HEAD(&tp_p->freejobs, job, list);
+		job = NULL;
+	}
+	SCCP_LIST_UNLOCK(&tp_p->freejobs);
+	if (job) {
+		sccp_free(job);											/* DEALLOC job */
+	}
+}
+
 /* What each individual thread is doing */
 void sccp_threadpool_thread_do(void *p)
 {
 	sccp_threadpool_thread_t *tp_thread = (sccp_threadpool_thread_t *) p;
 	sccp_threadpool_t *tp_p = tp_thread->tp_p;
 	void *thread = (void *) pthread_self();
+	unsigned int generation = 0;
 
 	pthread_cleanup_push(sccp_threadpool_thread_end, tp_thread);
 
@@ -213,44 +332,56 @@ void sccp_threadpool_thread_do(void *p)
 	sccp_log((DEBUGCAT_CORE)) (VERBOSE_PREFIX_3 "Starting Threadpool JobQueue:%p\n", thread);
 	while (1) {
 		pthread_testcancel();
-		jobs = SCCP_LIST_GETSIZE(&tp_p->jobs);
+		jobs = tp_p->num_jobs;
 		threads = SCCP_LIST_GETSIZE(&tp_p->threads);
 
 		sccp_log((DEBUGCAT_THPOOL)) (VERBOSE_PREFIX_3 "(sccp_threadpool_thread_do) num_jobs: %d, thread: %p, num_threads: %d\n", jobs, thread, threads);
 
 		pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, NULL);
-		SCCP_LIST_LOCK(&(tp_p->jobs));									/* LOCK */
-		while (SCCP_LIST_GETSIZE(&tp_p->jobs) == 0 && !tp_thread->die) {
-			sccp_log((DEBUGCAT_THPOOL)) (VERBOSE_PREFIX_3 "(sccp_threadpool_thread_do) Thread %p Waiting for New Work Condition\n", thread);
-			pbx_cond_wait(&(tp_p->work), &(tp_p->jobs.lock));
-		}
-		if (tp_thread->die && SCCP_LIST_GETSIZE(&tp_p->jobs) == 0) {
-			sccp_log((DEBUGCAT_CORE)) (VERBOSE_PREFIX_3 "JobQueue Die. Exiting thread %p...\n", thread);
-			SCCP_LIST_UNLOCK(&(tp_p->jobs));
-			break;
-		}
-		sccp_log((DEBUGCAT_THPOOL)) (VERBOSE_PREFIX_3 "(sccp_threadpool_thread_do) Let's work. num_jobs: %d, thread: %p, num_threads: %d\n", jobs, thread, threads);
-		{
-			/* Read job from queue and execute it */
-			void *(*func_buff) (void *arg) = NULL;
-			void *arg_buff = NULL;
-			sccp_threadpool_job_t *job;
-
-			if ((job = SCCP_LIST_REMOVE_HEAD(&(tp_p->jobs), list))) {
-				func_buff = job->function;
-				arg_buff = job->arg;
+		sccp_mutex_lock(&tp_p->lock);
+		generation = tp_p->generation;
+		sccp_mutex_unlock(&tp_p->lock);
+
+		/* Read job from queue and execute it */
+		struct sccp_threadpool_queue *queue = NULL;
+		sccp_threadpool_job_t *job = sccp_threadpool_take_job(tp_p, tp_thread->queue, &queue);
+
+		if (!job) {
+			if (tp_thread->die) {
+				sccp_log((DEBUGCAT_CORE)) (VERBOSE_PREFIX_3 "JobQueue Die. Exiting thread %p...\n", thread);
+				break;
 			}
-			SCCP_LIST_UNLOCK(&(tp_p->jobs));
-
-			sccp_log((DEBUGCAT_THPOOL)) (VERBOSE_PREFIX_3 "(sccp_threadpool_thread_do) executing %p in thread: %p\n", job, thread);
-			if (job) {
-				func_buff(arg_buff);								/* run function */
-				sccp_free(job);									/* DEALLOC job */
+			sccp_mutex_lock(&tp_p->lock);								/* LOCK */
+			while (tp_p->generation == generation && !tp_thread->die) {
+				sccp_log((DEBUGCAT_THPOOL)) (VERBOSE_PREFIX_3 "(sccp_threadpool_thread_do) Thread %p Waiting for New Work Condition\n", thread);
+				pbx_cond_wait(&(tp_p->work), &(tp_p->lock));
 			}
-			// check number of threads in threadpool
-			if ((time(0) - tp_p->last_size_check) > THREADPOOL_RESIZE_INTERVAL) {
-				sccp_threadpool_check_size(tp_p);						/* Check Resizing */
+			sccp_mutex_unlock(&tp_p->lock);
+			pthread_setcancelstate(PTHREAD_CANCEL_ENABLE, NULL);
+			continue;
+		}
+		sccp_log((DEBUGCAT_THPOOL)) (VERBOSE_PREFIX_3 "(sccp_threadpool_thread_do) executing %p in thread: %p\n", job, thread);
+		job->function(job->arg);									/* run function */
+		if (job->key) {											/* next job with this key may run now */
+			int k;
+			SCCP_LIST_LOCK(&queue->jobs);
+			for (k = 0; k < queue->num_busy; k++) {
+				if (queue->busy_keys[k] == job->key) {
+					queue->busy_keys[k] = queue->busy_keys[--queue->num_busy];
+					break;
+				}
 			}
+			int remaining = SCCP_LIST_GETSIZE(&queue->jobs);
+			SCCP_LIST_UNLOCK(&queue->jobs);
+			if (remaining) {
+				sccp_threadpool_wakeup(tp_p, FALSE);
+			}
+		}
+		sccp_threadpool_release_job(tp_p, job);
+
+		// check number of threads in threadpool
+		if ((time(0) - tp_p->last_size_check) > THREADPOOL_RESIZE_INTERVAL) {
+			sccp_threadpool_check_size(tp_p);							/* Check Resizing */
 		}
 		pthread_setcancelstate(PTHREAD_CANCEL_ENABLE, NULL);
 	}
@@ -261,12 +392,21 @@ void sccp_threadpool_thread_do(void *p)
 
 /* Add work to the thread pool */
 int sccp_threadpool_add_work(sccp_threadpool_t * tp_p, void *(*function_p) (void *), void *arg_p)
+{
+	return sccp_threadpool_add_work_keyed(tp_p, 0, function_p, arg_p);
+}
+
+/* Add work with an affinity key to the thread pool */
+int sccp_threadpool_add_work_keyed(sccp_threadpool_t * tp_p, uint32_t key, void *(*function_p) (void *), void *arg_p)
 {
 	// prevent new work while shutting down
 	if (!tp_p->sccp_threadpool_shuttingdown) {
 		sccp_threadpool_job_t *newJob;
 
-		if (!(newJob = sccp_calloc(sizeof *newJob, 1))) {
+		SCCP_LIST_LOCK(&tp_p->freejobs);
+		newJob = SCCP_LIST_REMOVE_HEAD(&tp_p->freejobs, list);
+		SCCP_LIST_UNLOCK(&tp_p->freejobs);
+		if (!newJob && !(newJob = sccp_calloc(sizeof *newJob, 1))) {
         		pbx_log(LOG_ERROR, SS_Memory_Allocation_Error, "SCCP");
 			exit(1);
 		}
@@ -274,6 +414,7 @@ int sccp_threadpool_add_work(sccp_threadpool_t * tp_p, void *(*function_p) (void
 		/* add function and argument */
 		newJob->function = function_p;
 		newJob->arg = arg_p;
+		newJob->key = key;
 
 		/* add job to queue */
 		sccp_threadpool_jobqueue_add(tp_p, newJob);
@@ -290,24 +431,25 @@ boolean_t sccp_threadpool_destroy(sccp_threadpool_t * tp_p)
 		return FALSE;
 	}
 	sccp_threadpool_thread_t *tp_thread = NULL;
+	sccp_threadpool_job_t *job = NULL;
+	int q;
 
-	sccp_log((DEBUGCAT_CORE)) (VERBOSE_PREFIX_2 "Destroying Threadpool %p with %d jobs\n", tp_p, SCCP_LIST_GETSIZE(&tp_p->jobs));
+	sccp_log((DEBUGCAT_CORE)) (VERBOSE_PREFIX_2 "Destroying Threadpool %p with %d jobs\n", tp_p, tp_p->num_jobs);
 
 	// After this point, no new jobs can be added
-	SCCP_LIST_LOCK(&(tp_p->jobs));
+	sccp_mutex_lock(&tp_p->lock);
 	tp_p->sccp_threadpool_shuttingdown = 1;
-	SCCP_LIST_UNLOCK(&(tp_p->jobs));
+	sccp_mutex_unlock(&tp_p->lock);
 
 	// shutdown is a kind of work too
 	SCCP_LIST_LOCK(&(tp_p->threads));
 	SCCP_LIST_TRAVERSE(&(tp_p->threads), tp_thread, list) {
 		tp_thread->die = TRUE;
-		pbx_cond_broadcast(&(tp_p->work));
 	}
 	SCCP_LIST_UNLOCK(&(tp_p->threads));
 
 	// wake up jobs untill jobqueue is empty, before shutting down, to make sure all jobs have been processed
-	pbx_cond_broadcast(&(tp_p->work));
+	sccp_threadpool_wakeup(tp_p, TRUE);
 
 	// wait for all threads to exit
 	if (SCCP_LIST_GETSIZE(&tp_p->threads) != 0) {
@@ -322,7 +464,7 @@ boolean_t sccp_threadpool_destroy(sccp_threadpool_t * tp_p)
 			ts.tv_sec = tp.tv_sec;
 			ts.tv_nsec = tp.tv_usec * 1000;
 			ts.tv_sec += 1;										// wait max 2 second
-			pbx_cond_broadcast(&(tp_p->work));
+			sccp_threadpool_wakeup(tp_p, TRUE);
 			pbx_cond_timedwait(&tp_p->exit, &(tp_p->threads.lock), &ts);
 		}
 
@@ -339,10 +481,24 @@ boolean_t sccp_threadpool_destroy(sccp_threadpool_t * tp_p)
 	}
 
 	/* Dealloc */
+	for (q = 0; q < THREADPOOL_QUEUES; q++) {
+		SCCP_LIST_LOCK(&tp_p->queues[q].jobs);
+		while ((job = SCCP_LIST_REMOVE_HEAD(&tp_p->queues[q].jobs, list))) {			/* only when threads had to be forced down */
+			sccp_free(job);
+		}
+		SCCP_LIST_UNLOCK(&tp_p->queues[q].jobs);
+		SCCP_LIST_HEAD_DESTROY(&tp_p->queues[q].jobs);
+	}
+	SCCP_LIST_LOCK(&tp_p->freejobs);
+	while ((job = SCCP_LIST_REMOVE_HEAD(&tp_p->freejobs, list))) {
+		sccp_free(job);
+	}
+	SCCP_LIST_UNLOCK(&tp_p->freejobs);
 	pbx_cond_destroy(&(tp_p->work));									/* Remove Condition */
 	pbx_cond_destroy(&(tp_p->exit));									/* Remove Condition */
-	SCCP_LIST_HEAD_DESTROY(&(tp_p->jobs));
+	SCCP_LIST_HEAD_DESTROY(&tp_p->freejobs);
 	SCCP_LIST_HEAD_DESTROY(&(tp_p->threads));
+	sccp_mutex_destroy(&tp_p->lock);
 	sccp_free(tp_p);
 	tp_p = NULL;												/* DEALLOC thread pool */
 	sccp_log((DEBUGCAT_CORE)) (VERBOSE_PREFIX_3 "Threadpool Ended\n");
@@ -359,33 +515,102 @@ int sccp_threadpool_thread_count(sccp_threadpool_t * tp_p)
 /* Add job to queue */
 void sccp_threadpool_jobqueue_add(sccp_threadpool_t * tp_p, sccp_threadpool_job_t * newjob_p)
 {
+	struct sccp_threadpool_queue *q = NULL;
+	int num_jobs = 0;
+
 	if (!tp_p || !newjob_p) {
 		pbx_log(LOG_ERROR, "(sccp_threadpool_jobqueue_add) no tp_p or no work pointer\n");
 		sccp_free(newjob_p);
 		return;
 	}
 
-	sccp_log((DEBUGCAT_THPOOL)) (VERBOSE_PREFIX_3 "(sccp_threadpool_jobqueue_add) tp_p: %p, jobCount: %d\n", tp_p, SCCP_LIST_GETSIZE(&tp_p->jobs));
-	SCCP_LIST_LOCK(&(tp_p->jobs));
+	sccp_log((DEBUGCAT_THPOOL)) (VERBOSE_PREFIX_3 "(sccp_threadpool_jobqueue_add) tp_p: %p, jobCount: %d\n", tp_p, tp_p->num_jobs);
+	if (newjob_p->key) {
+		q = &tp_p->queues[(newjob_p->key * 2654435761U) % THREADPOOL_QUEUES];			/* keyed jobs always go to the same queue */
+	} else {
+		q = &tp_p->queues[ATOMIC_INCR(&tp_p->next_queue, 1, &tp_p->lock) % THREADPOOL_QUEUES];	/* spread the others round robin */
+	}
+	newjob_p->queued = pbx_tvnow();
+
+	SCCP_LIST_LOCK(&q->jobs);
 	if (tp_p->sccp_threadpool_shuttingdown) {
 		pbx_log(LOG_ERROR, "(sccp_threadpool_jobqueue_add) shutting down. skipping work\n");
-		SCCP_LIST_UNLOCK(&(tp_p->jobs));
+		SCCP_LIST_UNLOCK(&q->jobs);
 		sccp_free(newjob_p);
 		return;
 	}
-	SCCP_LIST_INSERT_TAIL(&(tp_p->jobs), newjob_p, list);
-	SCCP_LIST_UNLOCK(&(tp_p->jobs));
+	SCCP_LIST_INSERT_TAIL(&q->jobs, newjob_p, list);
+	if ((int) SCCP_LIST_GETSIZE(&q->jobs) > q->high_water_mark) {
+		q->high_water_mark = SCCP_LIST_GETSIZE(&q->jobs);
+	}
+	SCCP_LIST_UNLOCK(&q->jobs);
 
-	if ((int)SCCP_LIST_GETSIZE(&tp_p->jobs) > tp_p->job_high_water_mark) {
-		tp_p->job_high_water_mark = SCCP_LIST_GETSIZE(&tp_p->jobs);
+	num_jobs = ATOMIC_INCR(&tp_p->num_jobs, 1, &tp_p->lock) + 1;
+	if (num_jobs > tp_p->job_high_water_mark) {
+		tp_p->job_high_water_mark = num_jobs;
 	}
-	pbx_cond_signal(&(tp_p->work));
+	sccp_threadpool_wakeup(tp_p, FALSE);
 }
 
 int sccp_threadpool_jobqueue_count(sccp_threadpool_t * tp_p)
 {
-	sccp_log((DEBUGCAT_THPOOL)) (VERBOSE_PREFIX_3 "(sccp_threadpool_jobqueue_count) tp_p: %p, jobCount: %d\n", tp_p, SCCP_LIST_GETSIZE(&tp_p->jobs));
-	return SCCP_LIST_GETSIZE(&tp_p->jobs);
+	sccp_log((DEBUGCAT_THPOOL)) (VERBOSE_PREFIX_3 "(sccp_threadpool_jobqueue_count) tp_p: %p, jobCount: %d\n", tp_p, tp_p->num_jobs);
+	return tp_p->num_jobs;
+}
+
+int sccp_show_threadpool(int fd, sccp_cli_totals_t *totals, struct mansession *s, const struct message *m, int argc, char *argv[])
+{
+	sccp_threadpool_t *tp_p = GLOB(general_threadpool);
+	struct sccp_threadpool_queue *q = NULL;
+	int local_line_total = 0;
+	int idx = 0;
+	int once = 0;
+	int pooled = 0;
+
+	if (!tp_p) {
+		return RESULT_FAILURE;
+	}
+	pooled = SCCP_LIST_GETSIZE(&tp_p->freejobs);
+
+#define CLI_AMI_TABLE_NAME Threadpool
+#define CLI_AMI_TABLE_PER_ENTRY_NAME Pool
+#define CLI_AMI_TABLE_ITERATOR for(once = 0; once < 1; once++)
+#define CLI_AMI_TABLE_FIELDS 												\
+	CLI_AMI_TABLE_FIELD(Threads,		"-8.8",		d,	8,	sccp_threadpool_thread_count(tp_p))	\
+	CLI_AMI_TABLE_FIELD(Jobs,		"-8.8",		d,	8,	tp_p->num_jobs)				\
+	CLI_AMI_TABLE_FIELD(HighWater,		"-9.9",		d,	9,	tp_p->job_high_water_mark)		\
+	CLI_AMI_TABLE_FIELD(PooledJobs,		"-10.10",	d,	10,	pooled)
+#include "sccp_cli_table.h"
+	local_line_total++;
+
+#define CLI_AMI_TABLE_NAME Queues
+#define CLI_AMI_TABLE_PER_ENTRY_NAME Queue
+#define CLI_AMI_TABLE_ITERATOR for(idx = 0; idx < THREADPOOL_QUEUES; idx++)
+#define CLI_AMI_TABLE_BEFORE_ITERATION											\
+		q = &tp_p->queues[idx];										\
+		SCCP_LIST_LOCK(&q->jobs);
+#define CLI_AMI_TABLE_AFTER_ITERATION											\
+		SCCP_LIST_UNLOCK(&q->jobs);
+#define CLI_AMI_TABLE_FIELDS 												\
+	CLI_AMI_TABLE_FIELD(Queue,		"-5",		d,	5,	idx)					\
+	CLI_AMI_TABLE_FIELD(Depth,		"-6",		d,	6,	SCCP_LIST_GETSIZE(&q->jobs))		\
+	CLI_AMI_TABLE_FIELD(HighWater,		"-9",		d,	9,	q->high_water_mark)			\
+	CLI_AMI_TABLE_FIELD(Busy,		"-4",		d,	4,	q->num_busy)				\
+	CLI_AMI_TABLE_FIELD(Executed,		"-10",		lu,	10,	(unsigned long) q->executed)		\
+	CLI_AMI_TABLE_FIELD(Stolen,		"-10",		lu,	10,	(unsigned long) q->stolen)		\
+	CLI_AMI_TABLE_FIELD(AvgWait,		"-10",		lu,	10,	(unsigned long) (q->executed ? q->wait_total / q->executed : 0))	\
+	CLI_AMI_TABLE_FIELD(MaxWait,		"-10",		lu,	10,	(unsigned long) q->wait_max)
+#include "sccp_cli_table.h"
+	local_line_total++;
+
+	if (!s) {
+		pbx_cli(fd, "(wait times in usec)\n");
+	}
+	if (s) {
+		totals->lines = local_line_total;
+		totals->tables = 2;
+	}
+	return RESULT_SUCCESS;
 }
 
 
@@ -485,16 +710,100 @@ AST_TEST_DEFINE(sccp_threadpool_work)
 	return AST_TEST_PASS;
 }
 
+struct sccp_threadpool_keyed_test {
+	int last;
+	int out_of_order;
+	volatile int running;
+	int overlap;
+};
+struct sccp_threadpool_keyed_test_job {
+	struct sccp_threadpool_keyed_test *state;
+	int seq;
+};
+static struct sccp_threadpool_keyed_test keyed_test_state[2];
+static struct sccp_threadpool_keyed_test_job keyed_test_jobs[2][NUM_WORK];
+static sccp_mutex_t keyed_test_lock;
+
+static void *sccp_cli_threadpool_keyed_test_thread(void *data)
+{
+	struct sccp_threadpool_keyed_test_job *job = (struct sccp_threadpool_keyed_test_job *) data;
+	struct sccp_threadpool_keyed_test *state = job->state;
+
+	if (ATOMIC_INCR(&state->running, 1, &keyed_test_lock) != 0) {
+		state->overlap++;
+	}
+	if (job->seq != state->last + 1) {
+		state->out_of_order++;
+	}
+	state->last = job->seq;
+	usleep(rand() % 1000);
+	ATOMIC_DECR(&state->running, 1, &keyed_test_lock);
+	return 0;
+}
+
+AST_TEST_DEFINE(sccp_threadpool_keyed_work)
+{
+	switch(cmd) {
+		case TEST_INIT:
+			info->name = "keyedwork";
+			info->category = test_category;
+			info->summary = "chan-sccp-b threadpool keyed work";
+			info->description = "chan-sccp-b threadpool jobs sharing a key run one at a time and in order";
+			return AST_TEST_NOT_RUN;
+	        case TEST_EXECUTE:
+	        	break;
+	}
+	sccp_threadpool_t *test_threadpool = NULL;
+	int work, key, loopcount = 0;
+
+	memset(keyed_test_state, 0, sizeof keyed_test_state);
+	keyed_test_state[0].last = keyed_test_state[1].last = -1;
+	sccp_mutex_init(&keyed_test_lock);
+
+	pbx_test_status_update(test, "Create Test threadpool\n");
+	test_threadpool = sccp_threadpool_init(THREADPOOL_MIN_SIZE);
+	pbx_test_validate(test, NULL != test_threadpool);
+	sccp_threadpool_grow(test_threadpool, 3);
+
+	if (test_threadpool) {
+		pbx_test_status_update(test, "Adding keyed work to Test threadpool\n");
+		for (work = 0; work < NUM_WORK; work++) {
+			for (key = 0; key < 2; key++) {
+				keyed_test_jobs[key][work].state = &keyed_test_state[key];
+				keyed_test_jobs[key][work].seq = work;
+				pbx_test_validate(test, sccp_threadpool_add_work_keyed(test_threadpool, key + 1, (void *) sccp_cli_threadpool_keyed_test_thread, &keyed_test_jobs[key][work]) > 0);
+			}
+		}
+		while (sccp_threadpool_jobqueue_count(test_threadpool) > 0 && loopcount++ < 20) {
+			sleep(1);
+		}
+		usleep(10000);
+		pbx_test_validate(test, sccp_threadpool_jobqueue_count(test_threadpool) == 0);
+		for (key = 0; key < 2; key++) {
+			pbx_test_status_update(test, "Key %d: last: %d, out of order: %d, overlapping: %d\n", key + 1, keyed_test_state[key].last, keyed_test_state[key].out_of_order, keyed_test_state[key].overlap);
+			pbx_test_validate(test, keyed_test_state[key].last == NUM_WORK - 1);
+			pbx_test_validate(test, keyed_test_state[key].out_of_order == 0);
+			pbx_test_validate(test, keyed_test_state[key].overlap == 0);
+		}
+		pbx_test_status_update(test, "Destroy Test threadpool\n");
+		sccp_threadpool_destroy(test_threadpool);
+	}
+	sccp_mutex_destroy(&keyed_test_lock);
+	return AST_TEST_PASS;
+}
+
 static void __attribute__((constructor)) sccp_register_tests(void)
 {
         AST_TEST_REGISTER(sccp_threadpool_create_destroy);
         AST_TEST_REGISTER(sccp_threadpool_work);
+        AST_TEST_REGISTER(sccp_threadpool_keyed_work);
 }
 
 static void __attribute__((destructor)) sccp_unregister_tests(void)
 {
         AST_TEST_UNREGISTER(sccp_threadpool_create_destroy);
         AST_TEST_UNREGISTER(sccp_threadpool_work);
+        AST_TEST_UNREGISTER(sccp_threadpool_keyed_work);
 }
 #endif
 
@@ -11,6 +11,11 @@
 #pragma once
 //#include "config.h"
 //#include "common.h"
+#include "sccp_cli.h"
+
+/* forward declarations */
+struct mansession;
+struct message;
 
 __BEGIN_C_EXTERN__
 /* Description:         Library providing a threading pool where you can add work on the fly. The number
@@ -34,16 +39,19 @@ __BEGIN_C_EXTERN__
 
 /*                       _______________________________________________________        
  *                      /                                                       \
- *                      |   JOB QUEUE        | job1 | job2 | job3 | job4 | ..   |
+ *                      |   QUEUE 0          | job1 | job4 | ..                 |
+ *                      |   QUEUE 1          | job2 | ..                        |
+ *                      |   QUEUE n          | job3 | job5 | job6 | ..          |
  *                      |                                                       |
  *                      |   threadpool      | thread1 | thread2 | ..            |
  *                      \_______________________________________________________/
  *      
- * Description:         Jobs are added to the job queue. Once a thread in the pool
- *                      is idle, it is assigned with the first job from the queue(and
- *                      erased from the queue). It's each thread's job to read from 
- *                      the queue serially(using lock) and executing each job
- *                      until the queue is empty.
+ * Description:         Jobs are added to one of the job queues. Each thread owns one queue,
+ *                      which it services first. When its own queue is empty, it steals work
+ *                      from the other queues before going to sleep.
+ *                      Jobs added with an affinity key always end up on the same queue, and
+ *                      a queue never runs more than one keyed job at a time, so related work
+ *                      (i.e. keyed by device) is executed in order.
  * 
  */
 /* ================================= STRUCTURES ================================================ */
@@ -54,6 +62,8 @@ typedef struct sccp_threadpool_job sccp_threadpool_job_t;
 struct sccp_threadpool_job {
 	void *(*function) (void *arg);										/*!< function pointer         */
 	void *arg;												/*!< function's argument      */
+	uint32_t key;												/*!< affinity key (0 = none)  */
+	struct timeval queued;											/*!< time the job was queued  */
 	SCCP_LIST_ENTRY (sccp_threadpool_job_t) list;
 };
 
@@ -102,6 +112,19 @@ SCCP_API void SCCP_CALL sccp_threadpool_thread_do(void *p);
  */
 SCCP_API int sccp_threadpool_add_work(sccp_threadpool_t * SCCP_CALL  tp_p, void *(*function_p) (void *), void *arg_p);
 
+/*!
+ * \brief Add work with an affinity key to the job queue
+ * 
+ * Jobs sharing the same key are always executed one after the other, in the order they where added.
+ * 
+ * \param tp_p threadpool to which the work will be added to
+ * \param key affinity key (i.e. derived from the device or line), 0 behaves like sccp_threadpool_add_work
+ * \param function_p callback function to add as work
+ * \param arg_p argument to the above function
+ * \return int
+ */
+SCCP_API int sccp_threadpool_add_work_keyed(sccp_threadpool_t * SCCP_CALL tp_p, uint32_t key, void *(*function_p) (void *), void *arg_p);
+
 /*!
  * \brief Destroy the threadpool
  * 
@@ -146,5 +169,10 @@ SCCP_API void SCCP_CALL sccp_threadpool_jobqueue_add(sccp_threadpool_t * tp_p, s
  * \param tp_p pointer to threadpool
  */
 SCCP_API int SCCP_CALL sccp_threadpool_jobqueue_count(sccp_threadpool_t * tp_p);
+
+/*!
+ * \brief Show queue depth, stealing and wait-time statistics of the general threadpool
+ */
+SCCP_API int SCCP_CALL sccp_show_threadpool(int fd, sccp_cli_totals_t *totals, struct mansession *s, const struct message *m, int argc, char *argv[]);
 __END_C_EXTERN__
 // kate: indent-width 8; replace-tabs off; indent-mode cstyle; auto-insert-doxygen on; line-numbers on; tab-indents on; keep-extra-spaces off; auto-brackets off;
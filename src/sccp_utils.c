@@ -35,10 +35,6 @@ SCCP_FILE_VERSION(__FILE__, "");
 #  include <asterisk/acl.h>
 #endif
 
-#if HAVE_ICONV
-#include <iconv.h>
-#endif
-
 /*!
  * \brief Print out a messagebuffer
  * \param messagebuffer Pointer to Message Buffer as char
@@ -1659,6 +1655,58 @@ AST_TEST_DEFINE(chan_sccp_combine_codec_sets)
 	}
 	return AST_TEST_PASS;
 }
+
+AST_TEST_DEFINE(chan_sccp_convUtf8toLatin1)
+{
+	switch (cmd) {
+	case TEST_INIT:
+		info->name = "convUtf8toLatin1";
+		info->category = "/channels/chan_sccp/utils/";
+		info->summary = "convUtf8toLatin1 unit test and microbenchmark";
+		info->description = "convUtf8toLatin1";
+		return AST_TEST_NOT_RUN;
+	case TEST_EXECUTE:
+		break;
+	}
+
+	char buf[StationMaxDisplayTextSize];
+
+	pbx_test_status_update(test, "Executing convUtf8toLatin1 on ascii, latin1 and non-latin1 strings...\n");
+	sccp_utils_convUtf8toLatin1("Hello World", buf, sizeof(buf));
+	pbx_test_validate(test, sccp_strequals(buf, "Hello World"));
+	sccp_utils_convUtf8toLatin1("Gr\xc3\xbc\xc3\x9f Gott \xc2\xa9", buf, sizeof(buf));
+	pbx_test_validate(test, sccp_strequals(buf, "Gr\xfc\xdf Gott \xa9"));
+	sccp_utils_convUtf8toLatin1("\xe2\x82\xac" "5 \xf0\x9f\x98\x80", buf, sizeof(buf));
+	pbx_test_validate(test, sccp_strequals(buf, "?5 ?"));
+
+	pbx_test_status_update(test, "Executing convUtf8toLatin1 on invalid sequences...\n");
+	sccp_utils_convUtf8toLatin1("a\xc3", buf, sizeof(buf));
+	pbx_test_validate(test, sccp_strequals(buf, "a?"));
+	sccp_utils_convUtf8toLatin1("\xbf\xc0\xafz", buf, sizeof(buf));
+	pbx_test_validate(test, sccp_strequals(buf, "???z"));
+	sccp_utils_convUtf8toLatin1("\xe2\x82z", buf, sizeof(buf));
+	pbx_test_validate(test, sccp_strequals(buf, "??z"));
+
+	pbx_test_status_update(test, "Executing convUtf8toLatin1 with a too small buffer...\n");
+	sccp_utils_convUtf8toLatin1("\xc3\xa4\xc3\xb6\xc3\xbc", buf, 3);
+	pbx_test_validate(test, sccp_strequals(buf, "\xe4\xf6"));
+
+	pbx_test_status_update(test, "Benchmarking convUtf8toLatin1...\n");
+	{
+		int loop = 0;
+		int loops = 100000;
+		struct timeval start = pbx_tvnow();
+		int64_t elapsed = 0;
+
+		for (loop = 0; loop < loops; loop++) {
+			sccp_utils_convUtf8toLatin1("J\xc3\xbcrgen M\xc3\xbcller <1234>", buf, sizeof(buf));
+		}
+		elapsed = ast_tvdiff_us(pbx_tvnow(), start);
+		pbx_test_status_update(test, "%d conversions took %" PRId64 " usec (%" PRId64 " nsec per conversion)\n", loops, elapsed, elapsed * 1000 / loops);
+		pbx_test_validate(test, sccp_strequals(buf, "J\xfcrgen M\xfcller <1234>"));
+	}
+	return AST_TEST_PASS;
+}
 #endif
 
 /*!
@@ -1907,54 +1955,53 @@ long int sccp_random(void)
 	return pbx_random();
 }
 
-#if HAVE_ICONV
-static iconv_t __sccp_iconv = (iconv_t) -1;
-static sccp_mutex_t __iconv_lock;
-
-static void __attribute__((constructor)) __start_iconv(void)
-{
-	__sccp_iconv = iconv_open("ISO8859-1", "UTF-8");
-	if (__sccp_iconv == (iconv_t) -1) {
-		pbx_log(LOG_ERROR, "SCCP:conversion from 'UTF-8' to 'ISO8859-1' not available.\n");
-	}
-	pbx_mutex_init_notracking(&__iconv_lock);
-}
-
-static void __attribute__((destructor)) __stop_iconv(void)
-{
-	if (__sccp_iconv) {
-		pbx_mutex_destroy(&__iconv_lock);
-		iconv_close(__sccp_iconv);
-	}
-}
+/*!
+ * \brief Length of the utf-8 sequence started by a lead byte, 0 for continuation bytes and bytes that can never start a valid sequence
+ */
+static const uint8_t __sccp_utf8_seqlen[256] = {
+	[0x01 ... 0x7F] = 1,
+	[0xC2 ... 0xDF] = 2,
+	[0xE0 ... 0xEF] = 3,
+	[0xF0 ... 0xF4] = 4,
+};
 
-gcc_inline boolean_t sccp_utils_convUtf8toLatin1(ICONV_CONST char *utf8str, char *buf, size_t len) 
+/*!
+ * \brief Convert utf-8 string to iso8859-1 (latin1)
+ * \note Table driven, without shared state, so it never blocks and is safe to call from any thread concurrently.
+ * Characters outside of latin1 and invalid sequences are replaced by '?'. The result is truncated to fit into buf and always terminated.
+ */
+gcc_inline boolean_t sccp_utils_convUtf8toLatin1(const char *utf8str, char *buf, size_t len)
 {
-	if (__sccp_iconv == (iconv_t) -1) {
-		// fallback to plain string copy
-		sccp_copy_string(buf, utf8str, len);
-		return TRUE;
-	}
-	size_t incount, outcount = len;
-	incount = sccp_strlen(utf8str);
-	if (incount) {
-		pbx_mutex_lock(&__iconv_lock);
-		if (iconv(__sccp_iconv, &utf8str, &incount, &buf, &outcount) == (size_t) -1) {
-			if (errno == E2BIG) {
-				pbx_log(LOG_WARNING, "SCCP: Iconv: output buffer too small.\n");
-			} else if (errno == EILSEQ) {
-				pbx_log(LOG_WARNING,  "SCCP: Iconv: illegal character.\n");
-			} else if (errno == EINVAL) {
-				pbx_log(LOG_WARNING,  "SCCP: Iconv: incomplete character sequence.\n");
-			} else {
-				pbx_log(LOG_WARNING,  "SCCP: Iconv: error %d: %s.\n", errno, strerror(errno));
-}
+	const unsigned char *in = (const unsigned char *) utf8str;
+	size_t pos = 0;
+	uint8_t seqlen = 0;
+	uint8_t idx = 0;
+
+	if (!utf8str || !buf || !len) {
+		return FALSE;
+	}
+	while (*in && pos < len - 1) {
+		seqlen = __sccp_utf8_seqlen[*in];
+		if (seqlen == 1) {										/* plain ascii */
+			buf[pos++] = *in++;
+			continue;
+		}
+		for (idx = 1; idx < seqlen && (in[idx] & 0xC0) == 0x80; idx++);				/* stops at the terminating NUL as well */
+		if (seqlen == 0 || idx < seqlen) {								/* invalid lead byte or incomplete sequence */
+			buf[pos++] = '?';
+			in++;
+			continue;
 		}
-		pbx_mutex_unlock(&__iconv_lock);
+		if (seqlen == 2 && *in <= 0xC3) {								/* U+0080 - U+00FF */
+			buf[pos++] = (char) (((in[0] & 0x1F) << 6) | (in[1] & 0x3F));
+		} else {											/* not representable in latin1 */
+			buf[pos++] = '?';
+		}
+		in += seqlen;
 	}
+	buf[pos] = '\0';
 	return TRUE;
 }
-#endif
 
 gcc_inline boolean_t sccp_always_false(void)
 {
@@ -1974,6 +2021,7 @@ static void __attribute__((constructor)) sccp_register_tests(void)
 	AST_TEST_REGISTER(chan_sccp_acl_invalid_tests);
 	AST_TEST_REGISTER(chan_sccp_reduce_codec_set);
 	AST_TEST_REGISTER(chan_sccp_combine_codec_sets);
+	AST_TEST_REGISTER(chan_sccp_convUtf8toLatin1);
 }
 
 static void __attribute__((destructor)) sccp_unregister_tests(void)
@@ -1982,6 +2030,7 @@ static void __attribute__((destructor)) sccp_unregister_tests(void)
 	AST_TEST_UNREGISTER(chan_sccp_acl_invalid_tests);
 	AST_TEST_UNREGISTER(chan_sccp_reduce_codec_set);
 	AST_TEST_UNREGISTER(chan_sccp_combine_codec_sets);
+	AST_TEST_UNREGISTER(chan_sccp_convUtf8toLatin1);
 }
 #endif
 
@@ -135,7 +135,7 @@ SCCP_API char * SCCP_CALL sccp_dec2binstr(char *buf, size_t size, int value);
 SCCP_INLINE void SCCP_CALL sccp_copy_string(char *dst, const char *src, size_t size);
 SCCP_API char * SCCP_CALL sccp_trimwhitespace(char *str);
 SCCP_INLINE int SCCP_CALL sccp_atoi(const char * const buf, size_t buflen);
-SCCP_INLINE boolean_t SCCP_CALL sccp_utils_convUtf8toLatin1(ICONV_CONST char *utf8str, char *buf, size_t len);
+SCCP_INLINE boolean_t SCCP_CALL sccp_utils_convUtf8toLatin1(const char *utf8str, char *buf, size_t len);
 SCCP_API long SCCP_CALL int sccp_random(void);
 SCCP_INLINE boolean_t SCCP_CALL sccp_always_false(void);
 SCCP_INLINE boolean_t SCCP_CALL sccp_always_true(void);